@@ -0,0 +1,244 @@
+#include "include/batch_script.hpp"
+#include "include/station_io.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+static std::string_view Trim(std::string_view text)
+{
+    auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+std::string_view BatchScript::NextToken(std::string_view& text)
+{
+    text = Trim(text);
+    if (text.empty())
+    {
+        return {};
+    }
+
+    std::string_view token;
+    if (text.front() == '"')
+    {
+        auto closing = text.find('"', 1);
+        if (closing == std::string_view::npos)
+        {
+            throw std::runtime_error("unterminated quote");
+        }
+        token = text.substr(1, closing - 1);
+        text.remove_prefix(closing + 1);
+    }
+    else
+    {
+        auto end = text.find_first_of(" \t");
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+        token = text.substr(0, end);
+        text.remove_prefix(end);
+    }
+
+    text = Trim(text);
+    return token;
+}
+
+BatchScript::BatchScript(StationList& stations) : m_stations(stations)
+{
+    BuildIdMap();
+}
+
+void BatchScript::BuildIdMap()
+{
+    const auto& list = m_stations.GetStations();
+    m_id_to_index.clear();
+    m_id_to_index.reserve(list.size());
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        // First station wins if the file has duplicate IDs
+        m_id_to_index.emplace(list.at(i)->GetStationID(), i);
+    }
+    m_deleted.assign(list.size(), false);
+}
+
+std::size_t BatchScript::Run(std::istream& in)
+{
+    string line;
+    std::size_t line_number {};
+    std::size_t errors {};
+
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        try {
+            this->Apply(line);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << fmt::format("Line {}: {}\n", line_number, e.what());
+            ++errors;
+        }
+    }
+
+    this->Flush();
+    return errors;
+}
+
+bool BatchScript::Apply(std::string_view line)
+{
+    std::string_view text = Trim(line);
+    if (text.empty() || text.front() == '#')
+    {
+        return false;
+    }
+
+    std::string_view command = NextToken(text);
+    ApplyCommand(command, text);
+    ++m_applied;
+    return true;
+}
+
+void BatchScript::Flush()
+{
+    if (m_pending_deletes.empty())
+    {
+        return;
+    }
+
+    m_stations.DeleteStations(m_pending_deletes);
+    m_pending_deletes.clear();
+
+    // Indexes after the deleted stations have moved down
+    BuildIdMap();
+}
+
+bool BatchScript::LookupStation(const string& id, std::size_t& index) const
+{
+    auto found = m_id_to_index.find(id);
+    if (found == m_id_to_index.end() || m_deleted.at(found->second))
+    {
+        return false;
+    }
+    index = found->second;
+    return true;
+}
+
+std::size_t BatchScript::GetCommandsApplied() const noexcept
+{
+    return m_applied;
+}
+
+// Consumes the station ID at the start of arguments and returns the index
+// of the station.
+std::size_t BatchScript::FindStation(std::string_view& arguments)
+{
+    std::string_view id = NextToken(arguments);
+    if (id.empty())
+    {
+        throw std::runtime_error("missing station ID");
+    }
+
+    auto found = m_id_to_index.find(string(id));
+    if (found == m_id_to_index.end() || m_deleted.at(found->second))
+    {
+        throw std::runtime_error(fmt::format("station '{}' not found", id));
+    }
+    return found->second;
+}
+
+void BatchScript::ApplyCommand(std::string_view command, std::string_view arguments)
+{
+    if (command == "add-station")
+    {
+        auto station = StationIO::ParseLine(arguments, StationFormat::CSV);
+        if (station->GetNumberKerbalsAboard() > station->GetCapacity())
+        {
+            throw std::runtime_error("more kerbals than the station's capacity");
+        }
+        auto id = station->GetStationID();
+        if (m_id_to_index.count(id) && !m_deleted.at(m_id_to_index.at(id)))
+        {
+            throw std::runtime_error(fmt::format("station '{}' already exists", id));
+        }
+
+        m_stations.AddStation(station);
+        m_id_to_index[id] = m_stations.GetSize() - 1;
+        m_deleted.push_back(false);
+        return;
+    }
+
+    if (command == "add-kerbal")
+    {
+        std::size_t index = FindStation(arguments);
+        auto& station = m_stations.GetStations().at(index);
+        if (arguments.empty())
+        {
+            throw std::runtime_error("missing kerbal name");
+        }
+        if (station->GetNumberKerbalsAboard() >= station->GetCapacity())
+        {
+            throw std::runtime_error(fmt::format("station '{}' is at capacity", station->GetStationID()));
+        }
+
+        m_stations.AddKerbal(index, string(arguments));
+        return;
+    }
+
+    if (command == "remove-kerbal")
+    {
+        std::size_t index = FindStation(arguments);
+        auto& station = m_stations.GetStations().at(index);
+        const auto& kerbals = station->GetKerbals();
+        auto found = std::find(kerbals.begin(), kerbals.end(), arguments);
+        if (found == kerbals.end())
+        {
+            throw std::runtime_error(fmt::format("'{}' is not aboard station '{}'", arguments, station->GetStationID()));
+        }
+
+        m_stations.RemoveKerbal(index, found - kerbals.begin());
+        return;
+    }
+
+    if (command == "set-capacity")
+    {
+        std::size_t index = FindStation(arguments);
+        auto& station = m_stations.GetStations().at(index);
+        std::size_t capacity {};
+        auto [end, ec] = std::from_chars(arguments.data(), arguments.data() + arguments.size(), capacity);
+        if (arguments.empty() || ec != std::errc() || end != arguments.data() + arguments.size())
+        {
+            throw std::runtime_error(fmt::format("invalid capacity '{}'", arguments));
+        }
+        // Same check ChangeCapcity makes, but reported instead of ignored
+        if (capacity < station->GetNumberKerbalsAboard())
+        {
+            throw std::runtime_error("capacity can't be less than the number of kerbals aboard");
+        }
+
+        m_stations.ChangeCapacity(index, capacity);
+        return;
+    }
+
+    if (command == "delete")
+    {
+        std::size_t index = FindStation(arguments);
+        if (!NextToken(arguments).empty())
+        {
+            throw std::runtime_error("wrong number of arguments");
+        }
+        m_deleted.at(index) = true;
+        m_pending_deletes.push_back(index);
+        return;
+    }
+
+    throw std::runtime_error(fmt::format("unknown command '{}'", command));
+}
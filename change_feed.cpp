@@ -0,0 +1,158 @@
+#include "include/change_feed.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static void CopyText(char (&dest)[StationChange::max_text + 1], std::string_view text) noexcept
+{
+    auto length = std::min(text.size(), StationChange::max_text);
+    std::memcpy(dest, text.data(), length);
+    dest[length] = '\0';
+}
+
+std::string_view StationChange::GetStationID() const noexcept
+{
+    return std::string_view(station_id);
+}
+
+std::string_view StationChange::GetKerbal() const noexcept
+{
+    return std::string_view(kerbal);
+}
+
+ChangeFeed::ChangeFeed(std::size_t capacity)
+{
+    std::size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    m_slots = std::make_unique<Slot[]>(size);
+    m_mask = size - 1;
+}
+
+std::size_t ChangeFeed::GetCapacity() const noexcept
+{
+    return m_mask + 1;
+}
+
+std::uint64_t ChangeFeed::GetHead() const noexcept
+{
+    return m_head.load(std::memory_order_acquire);
+}
+
+void ChangeFeed::Publish(StationChangeKind kind, std::size_t index, std::uint64_t value,
+                         std::string_view station_id, std::string_view kerbal) noexcept
+{
+    const std::uint64_t sequence = m_head.load(std::memory_order_relaxed);
+
+    StationChange event {};
+    event.sequence = sequence;
+    event.kind = kind;
+    event.index = static_cast<std::uint32_t>(index);
+    event.value = value;
+    CopyText(event.station_id, station_id);
+    CopyText(event.kerbal, kerbal);
+
+    std::uint64_t words[words_per_event];
+    std::memcpy(words, &event, sizeof(event));
+
+    Slot& slot = m_slots[sequence & m_mask];
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < words_per_event; ++i)
+    {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.stamp.store(sequence + 1, std::memory_order_release);
+    m_head.store(sequence + 1, std::memory_order_release);
+}
+
+ChangeFeed::Subscription ChangeFeed::Subscribe() const
+{
+    return Subscription(shared_from_this(), GetHead());
+}
+
+ChangeFeed::ReadResult ChangeFeed::Read(std::uint64_t sequence, StationChange& event) const noexcept
+{
+    const Slot& slot = m_slots[sequence & m_mask];
+    std::uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+    if (stamp != sequence + 1)
+    {
+        // 0 means a newer event is being written into the slot
+        return (stamp == 0 || stamp > sequence + 1) ? ReadResult::OVERWRITTEN : ReadResult::NOT_READY;
+    }
+
+    std::uint64_t words[words_per_event];
+    for (std::size_t i = 0; i < words_per_event; ++i)
+    {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.stamp.load(std::memory_order_relaxed) != stamp)
+    {
+        return ReadResult::OVERWRITTEN;
+    }
+
+    std::memcpy(&event, words, sizeof(event));
+    return ReadResult::OK;
+}
+
+ChangeFeed::Subscription::Subscription(std::shared_ptr<const ChangeFeed> feed, std::uint64_t cursor)
+    : m_feed(std::move(feed)), m_cursor(cursor)
+{
+}
+
+std::size_t ChangeFeed::Subscription::Poll(vector<StationChange>& out, std::size_t max_events)
+{
+    out.clear();
+    const std::uint64_t capacity = m_feed->GetCapacity();
+    std::uint64_t head = m_feed->GetHead();
+
+    // Skip to the oldest event still in the buffer. The slot of the oldest
+    // may already be in the middle of being reused, so allow one less.
+    auto skip_ahead = [&]() {
+        if (head - m_cursor >= capacity)
+        {
+            std::uint64_t oldest = head - capacity + 1;
+            m_dropped += oldest - m_cursor;
+            m_cursor = oldest;
+        }
+    };
+
+    skip_ahead();
+    out.reserve(std::min<std::uint64_t>(max_events, head - m_cursor));
+    StationChange event;
+    while (out.size() < max_events && m_cursor < head)
+    {
+        switch (m_feed->Read(m_cursor, event))
+        {
+          case ReadResult::OK:
+            out.push_back(event);
+            ++m_cursor;
+            break;
+          case ReadResult::OVERWRITTEN:
+            head = m_feed->GetHead();
+            skip_ahead();
+            break;
+          case ReadResult::NOT_READY:
+            return out.size();
+        }
+    }
+    return out.size();
+}
+
+std::uint64_t ChangeFeed::Subscription::GetDropped() const noexcept
+{
+    return m_dropped;
+}
+
+std::uint64_t ChangeFeed::Subscription::GetCursor() const noexcept
+{
+    return m_cursor;
+}
+
+std::uint64_t ChangeFeed::Subscription::GetLag() const noexcept
+{
+    return m_feed->GetHead() - m_cursor;
+}
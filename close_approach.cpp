@@ -0,0 +1,257 @@
+#include "include/close_approach.hpp"
+#include "include/kepler_propagator.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/spatial_grid.hpp"
+#include "include/utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+namespace
+{
+    struct Shell
+    {
+        double inner; // periapsis radius
+        double outer; // apoapsis radius
+    };
+
+    // One pass of a pair through the threshold, as seen at the time steps.
+    struct Encounter
+    {
+        std::size_t last_step;
+        double best_time;
+        double best_distance;
+    };
+}
+
+static double Distance(const std::array<double, 3>& a, const std::array<double, 3>& b)
+{
+    return std::hypot(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+// Closest approach of two stations within [low, high], by golden section
+// search. A pass is short next to an orbit, so the distance has a single
+// minimum within a couple of steps of the sampled one.
+static std::pair<double, double> Refine(const KeplerPropagator& propagator, std::size_t a, std::size_t b,
+                                        double low, double high)
+{
+    constexpr double ratio = 0.6180339887498949;
+    constexpr int iterations = 60;
+
+    auto distance_at = [&](double time) {
+        return Distance(propagator.PositionAt(a, time), propagator.PositionAt(b, time));
+    };
+
+    double left = high - ratio * (high - low);
+    double right = low + ratio * (high - low);
+    double left_distance = distance_at(left);
+    double right_distance = distance_at(right);
+    for (int i = 0; i < iterations && high - low > 1e-3; ++i)
+    {
+        if (left_distance < right_distance)
+        {
+            high = right;
+            right = left;
+            right_distance = left_distance;
+            left = high - ratio * (high - low);
+            left_distance = distance_at(left);
+        }
+        else
+        {
+            low = left;
+            left = right;
+            left_distance = right_distance;
+            right = low + ratio * (high - low);
+            right_distance = distance_at(right);
+        }
+    }
+
+    double time = 0.5 * (low + high);
+    return {time, distance_at(time)};
+}
+
+// Screens one body's stations. group holds indexes into stations.
+static void FindAroundBody(const vector<std::unique_ptr<SpaceStation>>& stations, vector<std::size_t> group,
+                           CelestialBody body, double start, double step, std::size_t count, double threshold,
+                           std::size_t threads, vector<CloseApproach>& approaches)
+{
+    // Radial shells, and the fastest speed anywhere in the group
+    vector<Shell> shells(group.size());
+    double top_speed = 0.0;
+    for (std::size_t i = 0; i < group.size(); ++i)
+    {
+        auto elements = OrbitalElementsEngine::Compute(*stations.at(group.at(i)));
+        shells.at(i) = Shell {elements.semi_major_axis * (1.0 - elements.eccentricity),
+                              elements.semi_major_axis * (1.0 + elements.eccentricity)};
+        top_speed = std::max(top_speed, elements.periapsis_speed);
+    }
+
+    // Drop stations whose shell, widened by the threshold, overlaps nobody
+    // else's. In order of periapsis, a shell overlaps an earlier one if it
+    // starts below the highest apoapsis so far, and a later one if the next
+    // shell starts below its apoapsis.
+    vector<std::size_t> by_inner(group.size());
+    std::iota(by_inner.begin(), by_inner.end(), 0);
+    std::sort(by_inner.begin(), by_inner.end(), [&shells](std::size_t a, std::size_t b) {
+        return shells[a].inner < shells[b].inner;
+    });
+    vector<bool> overlaps(group.size(), false);
+    double highest_outer = -std::numeric_limits<double>::infinity();
+    for (std::size_t k = 0; k < by_inner.size(); ++k)
+    {
+        const auto& shell = shells[by_inner[k]];
+        bool below = shell.inner - threshold <= highest_outer;
+        bool above = k + 1 < by_inner.size() && shells[by_inner[k + 1]].inner - threshold <= shell.outer;
+        overlaps[by_inner[k]] = below || above;
+        highest_outer = std::max(highest_outer, shell.outer);
+    }
+
+    vector<std::size_t> kept;
+    vector<Shell> kept_shells;
+    for (std::size_t i = 0; i < group.size(); ++i)
+    {
+        if (overlaps[i])
+        {
+            kept.push_back(group[i]);
+            kept_shells.push_back(shells[i]);
+        }
+    }
+    if (kept.size() < 2)
+    {
+        return;
+    }
+
+    // Two stations close on each other at no more than twice the top speed,
+    // and the closest point is within half a step of a sample
+    double margin = count > 1 ? top_speed * step : 0.0;
+    double reach = threshold + margin;
+    KeplerPropagator propagator(stations, kept);
+    SpatialGrid grid;
+    std::unordered_map<std::uint64_t, Encounter> active;
+    double end_time = start + step * static_cast<double>(count - 1);
+
+    auto finish = [&](std::uint64_t pair, const Encounter& encounter) {
+        std::size_t a = pair >> 32;
+        std::size_t b = pair & 0xffffffffULL;
+        double low = std::max(start, encounter.best_time - step);
+        double high = std::min(end_time, encounter.best_time + step);
+        auto [time, distance] = count > 1 ? Refine(propagator, a, b, low, high)
+                                          : std::pair<double, double>(encounter.best_time, encounter.best_distance);
+        if (encounter.best_distance < distance)
+        {
+            time = encounter.best_time;
+            distance = encounter.best_distance;
+        }
+        if (distance <= threshold)
+        {
+            approaches.push_back(CloseApproach {time, distance, body, stations.at(kept.at(a))->GetStationID(),
+                                                stations.at(kept.at(b))->GetStationID()});
+        }
+    };
+
+    propagator.PropagateRange(start, step, count, threads, [&](std::size_t s, double time, const PositionColumns& pos) {
+        grid.Build(pos, reach);
+        for (std::size_t i = 0; i < pos.Size(); ++i)
+        {
+            grid.ForEachNear(pos.x[i], pos.y[i], pos.z[i], [&](std::size_t j) {
+                if (j <= i || kept_shells[i].outer + threshold < kept_shells[j].inner ||
+                    kept_shells[j].outer + threshold < kept_shells[i].inner)
+                {
+                    return;
+                }
+                double distance = std::hypot(pos.x[i] - pos.x[j], pos.y[i] - pos.y[j], pos.z[i] - pos.z[j]);
+                if (!(distance <= reach))
+                {
+                    return;
+                }
+
+                std::uint64_t pair = (static_cast<std::uint64_t>(i) << 32) | j;
+                auto [it, inserted] = active.try_emplace(pair, Encounter {s, time, distance});
+                if (!inserted)
+                {
+                    it->second.last_step = s;
+                    if (distance < it->second.best_distance)
+                    {
+                        it->second.best_time = time;
+                        it->second.best_distance = distance;
+                    }
+                }
+            });
+        }
+
+        // Pairs not seen this step have moved apart again
+        for (auto it = active.begin(); it != active.end();)
+        {
+            if (it->second.last_step != s)
+            {
+                finish(it->first, it->second);
+                it = active.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    });
+
+    for (const auto& [pair, encounter] : active)
+    {
+        finish(pair, encounter);
+    }
+}
+
+vector<CloseApproach> CloseApproachFinder::Find(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                                const vector<std::size_t>& indexes, double start, double step,
+                                                std::size_t count, double threshold, std::size_t threads)
+{
+    std::array<vector<std::size_t>, NUM_CELESTIAL_BODIES> groups;
+    for (auto index : indexes)
+    {
+        auto body = static_cast<std::size_t>(stations.at(index)->GetOrbitingBody());
+        if (body < NUM_CELESTIAL_BODIES)
+        {
+            groups.at(body).push_back(index);
+        }
+    }
+
+    vector<CloseApproach> approaches;
+    for (std::size_t body = 0; body < NUM_CELESTIAL_BODIES; ++body)
+    {
+        if (groups.at(body).size() >= 2 && count > 0)
+        {
+            FindAroundBody(stations, std::move(groups.at(body)), static_cast<CelestialBody>(body), start, step, count,
+                           threshold, threads, approaches);
+        }
+    }
+
+    std::sort(approaches.begin(), approaches.end(), [](const CloseApproach& a, const CloseApproach& b) {
+        if (a.time != b.time)
+        {
+            return a.time < b.time;
+        }
+        return a.distance < b.distance;
+    });
+    return approaches;
+}
+
+void CloseApproachFinder::Print(std::ostream& out, const vector<CloseApproach>& approaches)
+{
+    fmt::memory_buffer buffer;
+    auto it = std::back_inserter(buffer);
+    for (const auto& approach : approaches)
+    {
+        fmt::format_to(it, "{:>12.1f}s  {:<8} {} - {}: {:.1f} m\n", approach.time, Utility::PlanetToString(approach.body),
+                       approach.first_id, approach.second_id, approach.distance);
+    }
+    out.write(buffer.data(), buffer.size());
+}
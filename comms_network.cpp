@@ -0,0 +1,375 @@
+#include "include/comms_network.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/spatial_grid.hpp"
+#include "include/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <utility>
+
+using namespace KSP_SM;
+
+// Stations searched per task when finding links.
+static constexpr std::size_t chunk_size = 256;
+
+double CommsNetwork::DevicePower(CommunicationDevice dev) noexcept
+{
+    switch (dev)
+    {
+        case CommunicationDevice::COMM_16:
+        case CommunicationDevice::COMM_16S:
+            return 500e3;
+        case CommunicationDevice::COMM_88_88:
+        case CommunicationDevice::RA_100:
+            return 100e9;
+        case CommunicationDevice::COMM_DTS_M1:
+        case CommunicationDevice::RA_2:
+            return 2e9;
+        case CommunicationDevice::COMM_HG_5:
+            return 5e6;
+        case CommunicationDevice::COMM_HG_55:
+        case CommunicationDevice::RA_15:
+            return 15e9;
+    }
+    return 0.0;
+}
+
+bool CommsNetwork::IsRelay(CommunicationDevice dev) noexcept
+{
+    return dev == CommunicationDevice::COMM_HG_5 || dev == CommunicationDevice::RA_2 ||
+           dev == CommunicationDevice::RA_15 || dev == CommunicationDevice::RA_100;
+}
+
+double CommsNetwork::StationPower(const SpaceStation& station)
+{
+    auto counts = station.GetCommsDevQuantities().GetAsArray();
+    double strongest {};
+    double sum {};
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        double power = DevicePower(static_cast<CommunicationDevice>(i));
+        strongest = std::max(strongest, power);
+        sum += power * static_cast<double>(counts[i]);
+    }
+    if (strongest == 0.0)
+    {
+        return 0.0;
+    }
+    return strongest * std::pow(sum / strongest, 0.75);
+}
+
+bool CommsNetwork::IsRelayStation(const SpaceStation& station)
+{
+    const auto& counts = station.GetCommsDevQuantities();
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        auto dev = static_cast<CommunicationDevice>(i);
+        if (IsRelay(dev) && counts.GetCount(dev) > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CommsNetwork::Build(const vector<std::unique_ptr<SpaceStation>>& stations, double time, std::size_t threads,
+                         double dsn_power)
+{
+    m_stations = stations.size();
+
+    // Positions relative to Kerbol, so stations around different bodies
+    // can be compared
+    PositionColumns positions;
+    KeplerPropagator(stations).Propagate(time, positions);
+    std::array<std::array<double, 3>, NUM_CELESTIAL_BODIES> body_positions;
+    for (std::size_t body = 0; body < NUM_CELESTIAL_BODIES; ++body)
+    {
+        body_positions[body] = OrbitalElementsEngine::BodyPosition(static_cast<CelestialBody>(body), time);
+    }
+
+    vector<double> power(m_stations);
+    m_relay.assign(m_stations + 1, false);
+    m_relay[m_stations] = true;
+    for (std::size_t i = 0; i < m_stations; ++i)
+    {
+        auto body = static_cast<std::size_t>(stations[i]->GetOrbitingBody());
+        if (body >= NUM_CELESTIAL_BODIES)
+        {
+            continue;
+        }
+        positions.x[i] += body_positions[body][0];
+        positions.y[i] += body_positions[body][1];
+        positions.z[i] += body_positions[body][2];
+        power[i] = StationPower(*stations[i]);
+        m_relay[i] = IsRelayStation(*stations[i]);
+    }
+
+    vector<Link> links;
+    FindLinks(power, positions, body_positions[static_cast<std::size_t>(CelestialBody::KERBIN)], dsn_power, threads,
+              links);
+
+    // Adjacency lists, each link stored from both ends
+    const std::size_t nodes = m_stations + 1;
+    m_offsets.assign(nodes + 1, 0);
+    for (const auto& link : links)
+    {
+        ++m_offsets[link.a + 1];
+        ++m_offsets[link.b + 1];
+    }
+    for (std::size_t i = 0; i < nodes; ++i)
+    {
+        m_offsets[i + 1] += m_offsets[i];
+    }
+    m_targets.resize(links.size() * 2);
+    m_lengths.resize(links.size() * 2);
+    vector<std::size_t> next(m_offsets.begin(), m_offsets.end() - 1);
+    for (const auto& link : links)
+    {
+        m_targets[next[link.a]] = link.b;
+        m_lengths[next[link.a]++] = link.length;
+        m_targets[next[link.b]] = link.a;
+        m_lengths[next[link.b]++] = link.length;
+    }
+
+    FindConnected(links);
+    FindPaths();
+}
+
+void CommsNetwork::FindLinks(const vector<double>& power, const PositionColumns& positions,
+                             const std::array<double, 3>& dsn, double dsn_power, std::size_t threads,
+                             vector<Link>& links) const
+{
+    // Stations grouped by power, each group spanning a factor of 4. Two
+    // groups are only searched as far as their strongest stations reach,
+    // so weak antennas don't pay for the range of the strong ones.
+    struct Group
+    {
+        vector<std::uint32_t> members;
+        double max_power = 0.0;
+    };
+    std::map<int, Group> by_power;
+    for (std::size_t i = 0; i < m_stations; ++i)
+    {
+        if (power[i] > 0 && std::isfinite(positions.x[i]))
+        {
+            auto& group = by_power[static_cast<int>(std::floor(std::log(power[i]) / std::log(4.0)))];
+            group.members.push_back(static_cast<std::uint32_t>(i));
+            group.max_power = std::max(group.max_power, power[i]);
+        }
+    }
+    vector<Group> groups;
+    for (auto& entry : by_power)
+    {
+        groups.push_back(std::move(entry.second));
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threads != 1 && m_stations > chunk_size)
+    {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+
+    SpatialGrid grid;
+    PositionColumns group_positions;
+    for (std::size_t b = 0; b < groups.size(); ++b)
+    {
+        const auto& targets = groups[b].members;
+        group_positions.Resize(targets.size());
+        for (std::size_t k = 0; k < targets.size(); ++k)
+        {
+            group_positions.x[k] = positions.x[targets[k]];
+            group_positions.y[k] = positions.y[targets[k]];
+            group_positions.z[k] = positions.z[targets[k]];
+        }
+
+        for (std::size_t a = 0; a <= b; ++a)
+        {
+            const auto& sources = groups[a].members;
+            grid.Build(group_positions, std::sqrt(groups[a].max_power * groups[b].max_power));
+
+            vector<vector<Link>> found((sources.size() + chunk_size - 1) / chunk_size);
+            auto search = [&, a, b](std::size_t begin, std::size_t end) {
+                auto& out = found[begin / chunk_size];
+                for (std::size_t k = begin; k < end; ++k)
+                {
+                    auto i = sources[k];
+                    double x = positions.x[i];
+                    double y = positions.y[i];
+                    double z = positions.z[i];
+                    grid.ForEachNear(x, y, z, [&](std::size_t slot) {
+                        auto j = targets[slot];
+                        if (a == b && j <= i)
+                        {
+                            return;
+                        }
+                        double distance = std::hypot(positions.x[j] - x, positions.y[j] - y, positions.z[j] - z);
+                        if (distance <= std::sqrt(power[i] * power[j]))
+                        {
+                            out.push_back(Link {std::min(i, j), std::max(i, j), distance});
+                        }
+                    });
+                }
+            };
+            if (pool)
+            {
+                pool->ParallelFor(sources.size(), chunk_size, search);
+            }
+            else
+            {
+                for (std::size_t begin = 0; begin < sources.size(); begin += chunk_size)
+                {
+                    search(begin, std::min(sources.size(), begin + chunk_size));
+                }
+            }
+            for (const auto& chunk : found)
+            {
+                links.insert(links.end(), chunk.begin(), chunk.end());
+            }
+        }
+    }
+
+    // The ground stations are measured from Kerbin's surface
+    double kerbin_radius = OrbitalElementsEngine::GetBodyConstants(CelestialBody::KERBIN).radius;
+    for (const auto& group : groups)
+    {
+        for (auto i : group.members)
+        {
+            double distance = std::max(
+                0.0, std::hypot(positions.x[i] - dsn[0], positions.y[i] - dsn[1], positions.z[i] - dsn[2]) -
+                         kerbin_radius);
+            if (distance <= std::sqrt(power[i] * dsn_power))
+            {
+                links.push_back(Link {i, static_cast<std::uint32_t>(m_stations), distance});
+            }
+        }
+    }
+
+    // Two grid cells sharing a hash can report the same pair twice
+    std::sort(links.begin(), links.end(),
+              [](const Link& x, const Link& y) { return x.a < y.a || (x.a == y.a && x.b < y.b); });
+    links.erase(std::unique(links.begin(), links.end(),
+                            [](const Link& x, const Link& y) { return x.a == y.a && x.b == y.b; }),
+                links.end());
+}
+
+void CommsNetwork::FindConnected(const vector<Link>& links)
+{
+    // Union-find over the links that can carry traffic onwards: between
+    // relays, or between a relay and the DSN
+    vector<std::uint32_t> parent(m_stations + 1);
+    for (std::uint32_t i = 0; i < parent.size(); ++i)
+    {
+        parent[i] = i;
+    }
+    auto find = [&parent](std::uint32_t node) {
+        while (parent[node] != node)
+        {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    };
+    for (const auto& link : links)
+    {
+        if (m_relay[link.a] && m_relay[link.b])
+        {
+            parent[find(link.a)] = find(link.b);
+        }
+    }
+
+    // A station without a relay antenna only needs one link into the
+    // DSN's component
+    auto dsn = find(static_cast<std::uint32_t>(m_stations));
+    m_connected.assign(m_stations, false);
+    for (std::size_t i = 0; i < m_stations; ++i)
+    {
+        if (m_relay[i])
+        {
+            m_connected[i] = find(static_cast<std::uint32_t>(i)) == dsn;
+            continue;
+        }
+        for (auto link = m_offsets[i]; link < m_offsets[i + 1]; ++link)
+        {
+            auto j = m_targets[link];
+            if (m_relay[j] && find(j) == dsn)
+            {
+                m_connected[i] = true;
+                break;
+            }
+        }
+    }
+}
+
+void CommsNetwork::FindPaths()
+{
+    // Dijkstra from the DSN outwards; only relays pass the signal on
+    const std::size_t nodes = m_stations + 1;
+    const auto dsn = static_cast<std::uint32_t>(m_stations);
+    m_distance.assign(nodes, std::numeric_limits<double>::infinity());
+    m_previous.assign(nodes, dsn);
+    m_distance[dsn] = 0.0;
+
+    using Entry = std::pair<double, std::uint32_t>;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> queue;
+    queue.push(Entry {0.0, dsn});
+    while (!queue.empty())
+    {
+        auto [distance, node] = queue.top();
+        queue.pop();
+        if (distance > m_distance[node] || !m_relay[node])
+        {
+            continue;
+        }
+        for (auto link = m_offsets[node]; link < m_offsets[node + 1]; ++link)
+        {
+            auto j = m_targets[link];
+            if (distance + m_lengths[link] < m_distance[j])
+            {
+                m_distance[j] = distance + m_lengths[link];
+                m_previous[j] = node;
+                queue.push(Entry {m_distance[j], j});
+            }
+        }
+    }
+}
+
+std::size_t CommsNetwork::GetLinkCount() const noexcept
+{
+    return m_targets.size() / 2;
+}
+
+bool CommsNetwork::IsConnected(std::size_t index) const
+{
+    return m_connected.at(index);
+}
+
+vector<std::size_t> CommsNetwork::RelayPath(std::size_t index) const
+{
+    vector<std::size_t> path;
+    if (!std::isfinite(m_distance.at(index)) || index >= m_stations)
+    {
+        return path;
+    }
+    for (auto node = index; node != m_stations; node = m_previous[node])
+    {
+        path.push_back(node);
+    }
+    return path;
+}
+
+double CommsNetwork::PathLength(std::size_t index) const
+{
+    if (index >= m_stations)
+    {
+        throw std::out_of_range("station index out of range");
+    }
+    return m_distance[index];
+}
@@ -0,0 +1,195 @@
+#include "include/concurrent_station_list.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <fmt/format.h>
+
+ConcurrentStationList::Snapshot::Snapshot(Stations stations) : m_stations(std::move(stations))
+{
+}
+
+std::size_t ConcurrentStationList::Snapshot::GetSize() const noexcept
+{
+    return m_stations.Size();
+}
+
+const ConcurrentStationList::SpaceStation& ConcurrentStationList::Snapshot::At(std::size_t index) const
+{
+    return *m_stations.At(index);
+}
+
+const ConcurrentStationList::Stations& ConcurrentStationList::Snapshot::GetStations() const noexcept
+{
+    return m_stations;
+}
+
+void ConcurrentStationList::Snapshot::DumpStations(std::ostream& out) const
+{
+    fmt::memory_buffer buffer;
+    m_stations.ForEach([&](const StationPtr& station) {
+        buffer.clear();
+        station->FormatTo(buffer);
+        out.write(buffer.data(), buffer.size());
+    });
+}
+
+ConcurrentStationList::ConcurrentStationList()
+{
+    Publish(Stations());
+}
+
+ConcurrentStationList::ConcurrentStationList(vector<std::unique_ptr<SpaceStation>> stations)
+{
+    Reset(std::move(stations));
+}
+
+std::shared_ptr<const ConcurrentStationList::Snapshot> ConcurrentStationList::GetSnapshot() const
+{
+    // Start looking for a free slot at a different place on each thread
+    std::size_t slot = std::hash<std::thread::id> {}(std::this_thread::get_id()) % max_readers;
+    while (true)
+    {
+        bool expected = false;
+        if (!m_hazards[slot].claimed.load(std::memory_order_relaxed) &&
+            m_hazards[slot].claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            break;
+        }
+        slot = (slot + 1) % max_readers;
+    }
+    auto& hazard = m_hazards[slot].snapshot;
+
+    // Once the slot holds the version that is still current after the store,
+    // the writer sees the slot before it can drop that version
+    const Snapshot* current = m_current.load();
+    while (true)
+    {
+        hazard.store(current);
+        const Snapshot* check = m_current.load();
+        if (check == current)
+        {
+            break;
+        }
+        current = check;
+    }
+
+    std::shared_ptr<const Snapshot> snapshot = current->shared_from_this();
+    hazard.store(nullptr, std::memory_order_release);
+    m_hazards[slot].claimed.store(false, std::memory_order_release);
+    return snapshot;
+}
+
+void ConcurrentStationList::AddStation(std::unique_ptr<SpaceStation> station)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Publish(CurrentStations().PushBack(StationPtr(std::move(station))));
+}
+
+bool ConcurrentStationList::InsertStation(std::size_t index, std::unique_ptr<SpaceStation> station)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    if (index > CurrentStations().Size())
+    {
+        return false;
+    }
+
+    Publish(CurrentStations().Insert(index, StationPtr(std::move(station))));
+    return true;
+}
+
+bool ConcurrentStationList::DeleteStation(std::size_t index)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    if (index >= CurrentStations().Size())
+    {
+        return false;
+    }
+
+    Publish(CurrentStations().Erase(index));
+    return true;
+}
+
+bool ConcurrentStationList::ModifyStation(std::size_t index, const std::function<void(SpaceStation&)>& modify)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    if (index >= CurrentStations().Size())
+    {
+        return false;
+    }
+
+    auto copy = std::make_shared<SpaceStation>(*CurrentStations().At(index));
+    modify(*copy);
+    Publish(CurrentStations().Set(index, std::move(copy)));
+    return true;
+}
+
+bool ConcurrentStationList::ReplaceStation(std::size_t index, std::unique_ptr<SpaceStation> station)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    if (index >= CurrentStations().Size())
+    {
+        return false;
+    }
+
+    Publish(CurrentStations().Set(index, StationPtr(std::move(station))));
+    return true;
+}
+
+void ConcurrentStationList::Update(const std::function<Stations(const Stations&)>& update)
+{
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Publish(update(CurrentStations()));
+}
+
+void ConcurrentStationList::Reset(vector<std::unique_ptr<SpaceStation>> stations)
+{
+    Stations sequence;
+    for (auto& station : stations)
+    {
+        sequence = sequence.PushBack(StationPtr(std::move(station)));
+    }
+
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Publish(std::move(sequence));
+}
+
+vector<std::unique_ptr<ConcurrentStationList::SpaceStation>> ConcurrentStationList::CopyStations() const
+{
+    auto snapshot = GetSnapshot();
+    vector<std::unique_ptr<SpaceStation>> copies;
+    copies.reserve(snapshot->GetSize());
+    snapshot->GetStations().ForEach([&](const StationPtr& station) {
+        copies.push_back(std::make_unique<SpaceStation>(*station));
+    });
+    return copies;
+}
+
+// Callers must hold m_write_mutex.
+const ConcurrentStationList::Stations& ConcurrentStationList::CurrentStations() const noexcept
+{
+    return m_current_owner->GetStations();
+}
+
+// Callers must hold m_write_mutex, apart from the constructor.
+void ConcurrentStationList::Publish(Stations stations)
+{
+    std::shared_ptr<const Snapshot> next = std::make_shared<Snapshot>(std::move(stations));
+    m_current.store(next.get());
+    if (m_current_owner)
+    {
+        m_retired.push_back(std::move(m_current_owner));
+    }
+    m_current_owner = std::move(next);
+
+    // Readers that got their reference already keep old versions alive on
+    // their own; only versions still announced in a slot have to wait
+    auto in_use = [this](const std::shared_ptr<const Snapshot>& retired) {
+        return std::any_of(m_hazards.begin(), m_hazards.end(), [&](const HazardSlot& slot) {
+            return slot.snapshot.load() == retired.get();
+        });
+    };
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+                                   [&](const auto& retired) { return !in_use(retired); }),
+                    m_retired.end());
+}
@@ -0,0 +1,522 @@
+#include "include/crew_scheduler.hpp"
+#include "include/batch_script.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/station_list.hpp"
+#include "include/station_transaction.hpp"
+#include "include/transfer_costs.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <fmt/core.h>
+
+// Cost given to the flow a demand requires, so the solver takes every such
+// kerbal before weighing up the real costs; far below any sum of those.
+static constexpr std::int64_t required_cost = -(std::int64_t(1) << 50);
+static constexpr std::int64_t infinite_cost = std::numeric_limits<std::int64_t>::max() / 4;
+
+namespace
+{
+    // Residual graph for the min-cost flow. Edges are added in pairs, so
+    // the reverse of edge e is e ^ 1.
+    struct FlowGraph
+    {
+        struct Edge
+        {
+            std::uint32_t to;
+            std::int64_t capacity;
+            std::int64_t cost;
+        };
+
+        vector<Edge> edges;
+        vector<vector<std::uint32_t>> out;
+
+        explicit FlowGraph(std::size_t nodes) : out(nodes) {}
+
+        std::size_t AddEdge(std::uint32_t from, std::uint32_t to, std::int64_t capacity, std::int64_t cost)
+        {
+            out[from].push_back(static_cast<std::uint32_t>(edges.size()));
+            edges.push_back(Edge {to, capacity, cost});
+            out[to].push_back(static_cast<std::uint32_t>(edges.size()));
+            edges.push_back(Edge {from, 0, -cost});
+            return edges.size() - 2;
+        }
+    };
+}
+
+CrewScheduler::CrewScheduler(const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    const std::size_t size = stations.size();
+    m_ids.reserve(size);
+    m_rosters.reserve(size);
+    m_capacity.reserve(size);
+    m_bodies.reserve(size);
+    m_radius.reserve(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const auto& station = *stations[i];
+        m_ids.push_back(station.GetStationID());
+        m_rosters.push_back(station.GetKerbals());
+        m_capacity.push_back(station.GetCapacity());
+        m_bodies.push_back(station.GetOrbitingBody());
+        m_radius.push_back(static_cast<std::size_t>(station.GetOrbitingBody()) < NUM_CELESTIAL_BODIES
+                               ? OrbitalElementsEngine::Compute(station).semi_major_axis
+                               : std::numeric_limits<double>::quiet_NaN());
+
+        // First one wins for duplicate IDs and kerbals
+        m_id_to_index.emplace(m_ids.back(), i);
+        for (const auto& kerbal : m_rosters.back())
+        {
+            m_kerbal_to_index.emplace(kerbal, i);
+        }
+    }
+    m_min_crew.assign(size, 0);
+    m_max_crew = m_capacity;
+}
+
+void CrewScheduler::SetCrew(std::size_t index, std::size_t count)
+{
+    SetMinCrew(index, count);
+    SetMaxCrew(index, count);
+}
+
+void CrewScheduler::SetMinCrew(std::size_t index, std::size_t count)
+{
+    m_min_crew.at(index) = count;
+}
+
+void CrewScheduler::SetMaxCrew(std::size_t index, std::size_t count)
+{
+    m_max_crew.at(index) = std::min(count, m_capacity.at(index));
+}
+
+void CrewScheduler::Assign(const string& kerbal, std::size_t index)
+{
+    FindKerbal(kerbal);
+    if (index >= m_ids.size())
+    {
+        throw std::out_of_range("station index out of range");
+    }
+    m_fixed[kerbal] = index;
+}
+
+void CrewScheduler::Keep(const string& kerbal)
+{
+    m_fixed[kerbal] = FindKerbal(kerbal);
+}
+
+std::size_t CrewScheduler::FindKerbal(const string& kerbal) const
+{
+    auto found = m_kerbal_to_index.find(kerbal);
+    if (found == m_kerbal_to_index.end())
+    {
+        throw std::invalid_argument(fmt::format("{} isn't aboard any station", kerbal));
+    }
+    return found->second;
+}
+
+std::size_t CrewScheduler::FindStation(const string& id) const
+{
+    auto found = m_id_to_index.find(id);
+    if (found == m_id_to_index.end())
+    {
+        throw std::invalid_argument(fmt::format("no station with ID {}", id));
+    }
+    return found->second;
+}
+
+void CrewScheduler::ReadDemands(std::istream& in)
+{
+    auto read_count = [](std::string_view text) {
+        std::size_t count {};
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+        if (error != std::errc() || end != text.data() + text.size() || text.empty())
+        {
+            throw std::invalid_argument(fmt::format("{} isn't a crew count", text));
+        }
+        return count;
+    };
+
+    string line;
+    std::size_t line_number {};
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        try {
+            std::string_view text = line;
+            auto command = BatchScript::NextToken(text);
+            if (command.empty() || command.front() == '#')
+            {
+                continue;
+            }
+
+            auto first = string(BatchScript::NextToken(text));
+            auto second = BatchScript::NextToken(text);
+            if (first.empty() || (command != "keep" && second.empty()) || !BatchScript::NextToken(text).empty())
+            {
+                throw std::invalid_argument("wrong number of arguments");
+            }
+
+            if (command == "crew")
+            {
+                SetCrew(FindStation(first), read_count(second));
+            }
+            else if (command == "min")
+            {
+                SetMinCrew(FindStation(first), read_count(second));
+            }
+            else if (command == "max")
+            {
+                SetMaxCrew(FindStation(first), read_count(second));
+            }
+            else if (command == "assign")
+            {
+                Assign(first, FindStation(string(second)));
+            }
+            else if (command == "keep" && second.empty())
+            {
+                Keep(first);
+            }
+            else
+            {
+                throw std::invalid_argument(fmt::format("unknown demand {}", command));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("line {}: {}", line_number, e.what()));
+        }
+    }
+}
+
+vector<std::int64_t> CrewScheduler::MoveCosts(Cost cost, const vector<std::size_t>& senders,
+                                              const vector<std::size_t>& receivers) const
+{
+    vector<std::int64_t> costs(senders.size() * receivers.size(), 1);
+    if (cost == Cost::MOVES)
+    {
+        return costs;
+    }
+
+    // Moves between bodies aren't priced, so they cost more than any
+    // transfer around one body
+    std::int64_t highest {};
+    vector<bool> priced(costs.size(), false);
+    for (std::size_t s = 0; s < senders.size(); ++s)
+    {
+        auto from = senders[s];
+        for (std::size_t r = 0; r < receivers.size(); ++r)
+        {
+            auto to = receivers[r];
+            if (m_bodies[from] != m_bodies[to] || !std::isfinite(m_radius[from]) || !std::isfinite(m_radius[to]))
+            {
+                continue;
+            }
+            double mu = OrbitalElementsEngine::GetBodyConstants(m_bodies[from]).gravitational_parameter;
+            // One extra per move so equal delta-v goes to the plan with fewer moves
+            auto centimetres = std::llround(TransferCostEngine::HohmannDeltaV(mu, m_radius[from], m_radius[to]) * 100);
+            costs[s * receivers.size() + r] = centimetres + 1;
+            priced[s * receivers.size() + r] = true;
+            highest = std::max<std::int64_t>(highest, centimetres + 1);
+        }
+    }
+    for (std::size_t i = 0; i < costs.size(); ++i)
+    {
+        if (!priced[i])
+        {
+            costs[i] = 2 * highest + 1;
+        }
+    }
+    return costs;
+}
+
+vector<CrewMove> CrewScheduler::Solve(Cost cost) const
+{
+    const std::size_t size = m_ids.size();
+    auto delta_v = [this](std::size_t from, std::size_t to) {
+        if (m_bodies[from] != m_bodies[to] || !std::isfinite(m_radius[from]))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        double mu = OrbitalElementsEngine::GetBodyConstants(m_bodies[from]).gravitational_parameter;
+        return TransferCostEngine::HohmannDeltaV(mu, m_radius[from], m_radius[to]);
+    };
+
+    // The named kerbals go first; whatever they leave is solved for
+    vector<CrewMove> plan;
+    vector<std::size_t> crew(size);
+    vector<std::size_t> fixed(size, 0);
+    vector<vector<string>> movable(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        crew[i] = m_rosters[i].size();
+    }
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (const auto& kerbal : m_rosters[i])
+        {
+            auto demand = m_fixed.find(kerbal);
+            if (demand == m_fixed.end() || m_kerbal_to_index.at(kerbal) != i)
+            {
+                movable[i].push_back(kerbal);
+                continue;
+            }
+            auto to = demand->second;
+            ++fixed[to];
+            if (to != i)
+            {
+                plan.push_back(CrewMove {kerbal, i, to, delta_v(i, to)});
+                --crew[i];
+                ++crew[to];
+            }
+        }
+    }
+
+    // How many kerbals each station has to give up or take on, and how many
+    // more it could
+    vector<std::size_t> senders;
+    vector<std::size_t> receivers;
+    vector<std::int64_t> must_send(size), can_send(size), must_receive(size), can_receive(size);
+    std::int64_t total_must_send {};
+    std::int64_t total_must_receive {};
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        auto low = static_cast<std::int64_t>(m_min_crew[i]);
+        auto high = static_cast<std::int64_t>(m_max_crew[i]);
+        auto current = static_cast<std::int64_t>(crew[i]);
+        auto keep = std::max(low, static_cast<std::int64_t>(fixed[i]));
+        if (low > high)
+        {
+            throw std::runtime_error(
+                fmt::format("{} needs at least {} kerbals but only takes {}", m_ids[i], low, high));
+        }
+        if (keep > high)
+        {
+            throw std::runtime_error(fmt::format("{} kerbals are assigned to {}, which only takes {}", fixed[i],
+                                                 m_ids[i], high));
+        }
+
+        must_send[i] = std::max<std::int64_t>(0, current - high);
+        can_send[i] = std::max<std::int64_t>(0, current - keep);
+        must_receive[i] = std::max<std::int64_t>(0, low - current);
+        can_receive[i] = std::max<std::int64_t>(0, high - current);
+        total_must_send += must_send[i];
+        total_must_receive += must_receive[i];
+        if (can_send[i] > 0)
+        {
+            senders.push_back(i);
+        }
+        if (can_receive[i] > 0)
+        {
+            receivers.push_back(i);
+        }
+    }
+    if (total_must_send == 0 && total_must_receive == 0)
+    {
+        return plan;
+    }
+
+    // Source -> sending stations -> receiving stations -> sink. A station's
+    // required kerbals go over an edge of their own at required_cost, so the
+    // cheapest flow carries all of them if it can.
+    const auto source = static_cast<std::uint32_t>(0);
+    const auto sink = static_cast<std::uint32_t>(senders.size() + receivers.size() + 1);
+    auto sender_node = [](std::size_t s) { return static_cast<std::uint32_t>(1 + s); };
+    auto receiver_node = [&senders](std::size_t r) { return static_cast<std::uint32_t>(1 + senders.size() + r); };
+
+    FlowGraph graph(sink + 1);
+    vector<std::size_t> required_edges;
+    for (std::size_t s = 0; s < senders.size(); ++s)
+    {
+        auto i = senders[s];
+        if (must_send[i] > 0)
+        {
+            required_edges.push_back(graph.AddEdge(source, sender_node(s), must_send[i], required_cost));
+        }
+        if (can_send[i] > must_send[i])
+        {
+            graph.AddEdge(source, sender_node(s), can_send[i] - must_send[i], 0);
+        }
+    }
+    auto move_costs = MoveCosts(cost, senders, receivers);
+    vector<std::size_t> move_edges(senders.size() * receivers.size(), 0);
+    for (std::size_t s = 0; s < senders.size(); ++s)
+    {
+        for (std::size_t r = 0; r < receivers.size(); ++r)
+        {
+            if (senders[s] != receivers[r])
+            {
+                auto capacity = std::min(can_send[senders[s]], can_receive[receivers[r]]);
+                move_edges[s * receivers.size() + r] = graph.AddEdge(sender_node(s), receiver_node(r), capacity,
+                                                                     move_costs[s * receivers.size() + r]);
+            }
+        }
+    }
+    for (std::size_t r = 0; r < receivers.size(); ++r)
+    {
+        auto j = receivers[r];
+        if (must_receive[j] > 0)
+        {
+            required_edges.push_back(graph.AddEdge(receiver_node(r), sink, must_receive[j], required_cost));
+        }
+        if (can_receive[j] > must_receive[j])
+        {
+            graph.AddEdge(receiver_node(r), sink, can_receive[j] - must_receive[j], 0);
+        }
+    }
+
+    // Potentials start as the shortest distances from the source, which the
+    // layered graph gives in one pass despite the negative edges
+    const std::size_t nodes = graph.out.size();
+    vector<std::int64_t> potential(nodes, infinite_cost);
+    potential[source] = 0;
+    for (auto e : graph.out[source])
+    {
+        potential[graph.edges[e].to] = std::min(potential[graph.edges[e].to], graph.edges[e].cost);
+    }
+    for (std::size_t s = 0; s < senders.size(); ++s)
+    {
+        for (auto e : graph.out[sender_node(s)])
+        {
+            const auto& edge = graph.edges[e];
+            if (edge.capacity > 0)
+            {
+                potential[edge.to] = std::min(potential[edge.to], potential[sender_node(s)] + edge.cost);
+            }
+        }
+    }
+    for (std::size_t r = 0; r < receivers.size(); ++r)
+    {
+        for (auto e : graph.out[receiver_node(r)])
+        {
+            const auto& edge = graph.edges[e];
+            if (edge.capacity > 0 && potential[receiver_node(r)] < infinite_cost)
+            {
+                potential[edge.to] = std::min(potential[edge.to], potential[receiver_node(r)] + edge.cost);
+            }
+        }
+    }
+    for (auto& value : potential)
+    {
+        // Nodes the source can't reach never will be
+        if (value == infinite_cost)
+        {
+            value = 0;
+        }
+    }
+
+    // Successive shortest paths, pushing as much as each path takes, until
+    // no path lowers the total cost
+    using Entry = std::pair<std::int64_t, std::uint32_t>;
+    vector<std::int64_t> distance(nodes);
+    vector<std::uint32_t> via(nodes);
+    while (true)
+    {
+        std::fill(distance.begin(), distance.end(), infinite_cost);
+        distance[source] = 0;
+        std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> queue;
+        queue.push(Entry {0, source});
+        while (!queue.empty())
+        {
+            auto [d, node] = queue.top();
+            queue.pop();
+            if (d > distance[node])
+            {
+                continue;
+            }
+            for (auto e : graph.out[node])
+            {
+                const auto& edge = graph.edges[e];
+                if (edge.capacity <= 0)
+                {
+                    continue;
+                }
+                auto reduced = d + edge.cost + potential[node] - potential[edge.to];
+                if (reduced < distance[edge.to])
+                {
+                    distance[edge.to] = reduced;
+                    via[edge.to] = e;
+                    queue.push(Entry {reduced, edge.to});
+                }
+            }
+        }
+        if (distance[sink] == infinite_cost)
+        {
+            break;
+        }
+        for (std::size_t v = 0; v < nodes; ++v)
+        {
+            if (distance[v] < infinite_cost)
+            {
+                potential[v] += distance[v];
+            }
+        }
+        if (potential[sink] - potential[source] >= 0)
+        {
+            break;
+        }
+
+        std::int64_t amount = std::numeric_limits<std::int64_t>::max();
+        for (auto v = sink; v != source; v = graph.edges[via[v] ^ 1].to)
+        {
+            amount = std::min(amount, graph.edges[via[v]].capacity);
+        }
+        for (auto v = sink; v != source; v = graph.edges[via[v] ^ 1].to)
+        {
+            graph.edges[via[v]].capacity -= amount;
+            graph.edges[via[v] ^ 1].capacity += amount;
+        }
+    }
+
+    for (auto e : required_edges)
+    {
+        if (graph.edges[e].capacity > 0)
+        {
+            throw std::runtime_error(total_must_send > total_must_receive
+                                         ? "not enough free berths for the kerbals that have to move"
+                                         : "not enough kerbals free to move to the stations that need them");
+        }
+    }
+
+    // The flow on each move edge is how many kerbals make that move; they
+    // are taken from the end of the sender's roster
+    for (std::size_t s = 0; s < senders.size(); ++s)
+    {
+        auto from = senders[s];
+        for (std::size_t r = 0; r < receivers.size(); ++r)
+        {
+            auto to = receivers[r];
+            if (from == to)
+            {
+                continue;
+            }
+            for (auto moved = graph.edges[move_edges[s * receivers.size() + r] ^ 1].capacity; moved > 0; --moved)
+            {
+                plan.push_back(CrewMove {movable[from].back(), from, to, delta_v(from, to)});
+                movable[from].pop_back();
+            }
+        }
+    }
+    return plan;
+}
+
+void CrewScheduler::Apply(StationList& stations, const vector<CrewMove>& plan, const string& save_filename)
+{
+    StationTransaction transaction(stations);
+    for (const auto& move : plan)
+    {
+        if (!transaction.RemoveKerbal(move.from, move.kerbal))
+        {
+            throw std::runtime_error(fmt::format("{} isn't aboard station {}", move.kerbal,
+                                                 stations.GetStations().at(move.from)->GetStationID()));
+        }
+        transaction.AddKerbal(move.to, move.kerbal);
+    }
+    transaction.Commit(save_filename);
+}
@@ -55,4 +55,50 @@ namespace KSP_SM
         return counts;
     }
 
+    std::size_t DockingPortCount::GetCount(DockingPort port) const
+    {
+        switch (port)
+        {
+        case DockingPort::XSMALL:
+            return xs;
+        case DockingPort::SMALL:
+            return sm;
+        case DockingPort::MEDIUM:
+            return md;
+        case DockingPort::LARGE:
+            return lg;
+        case DockingPort::XLARGE:
+            return xl;
+        }
+
+        return 0;
+    }
+
+    std::size_t CommsDevCount::GetCount(CommunicationDevice dev) const
+    {
+        switch (dev)
+        {
+        case CommunicationDevice::COMM_16:
+            return C16;
+        case CommunicationDevice::COMM_16S:
+            return C16S;
+        case CommunicationDevice::COMM_88_88:
+            return C8888;
+        case CommunicationDevice::COMM_DTS_M1:
+            return CDTS;
+        case CommunicationDevice::COMM_HG_5:
+            return CHG5;
+        case CommunicationDevice::COMM_HG_55:
+            return CHG55;
+        case CommunicationDevice::RA_15:
+            return RA15;
+        case CommunicationDevice::RA_2:
+            return RA2;
+        case CommunicationDevice::RA_100:
+            return RA100;
+        }
+
+        return 0;
+    }
+
 }
\ No newline at end of file
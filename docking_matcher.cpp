@@ -0,0 +1,450 @@
+#include "include/docking_matcher.hpp"
+#include "include/batch_script.hpp"
+#include "include/utils.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+#include <fmt/core.h>
+
+using namespace KSP_SM;
+using nlohmann::json;
+
+static const char* port_names[NUM_DOCKING_PORTS] = {"xs", "sm", "md", "lg", "xl"};
+
+namespace
+{
+    // Dinic's max flow. The graph only has a handful of layers (vessel
+    // groups, port pools, station ports), so the recursion stays shallow.
+    struct MaxFlowGraph
+    {
+        struct Edge
+        {
+            std::uint32_t to;
+            std::size_t capacity;
+        };
+
+        vector<Edge> edges;
+        vector<vector<std::uint32_t>> out;
+        vector<int> level;
+        vector<std::size_t> next;
+
+        explicit MaxFlowGraph(std::size_t nodes) : out(nodes), level(nodes), next(nodes) {}
+
+        std::size_t AddEdge(std::uint32_t from, std::uint32_t to, std::size_t capacity)
+        {
+            out[from].push_back(static_cast<std::uint32_t>(edges.size()));
+            edges.push_back(Edge {to, capacity});
+            out[to].push_back(static_cast<std::uint32_t>(edges.size()));
+            edges.push_back(Edge {from, 0});
+            return edges.size() - 2;
+        }
+
+        // Flow pushed along edge e so far
+        std::size_t Flow(std::size_t e) const
+        {
+            return edges[e ^ 1].capacity;
+        }
+
+        std::size_t Run(std::uint32_t source, std::uint32_t sink)
+        {
+            std::size_t total {};
+            while (Levels(source, sink))
+            {
+                std::fill(next.begin(), next.end(), 0);
+                while (auto pushed = Push(source, sink, std::numeric_limits<std::size_t>::max()))
+                {
+                    total += pushed;
+                }
+            }
+            return total;
+        }
+
+      private:
+        bool Levels(std::uint32_t source, std::uint32_t sink)
+        {
+            std::fill(level.begin(), level.end(), -1);
+            std::queue<std::uint32_t> queue;
+            level[source] = 0;
+            queue.push(source);
+            while (!queue.empty())
+            {
+                auto node = queue.front();
+                queue.pop();
+                for (auto e : out[node])
+                {
+                    if (edges[e].capacity > 0 && level[edges[e].to] < 0)
+                    {
+                        level[edges[e].to] = level[node] + 1;
+                        queue.push(edges[e].to);
+                    }
+                }
+            }
+            return level[sink] >= 0;
+        }
+
+        std::size_t Push(std::uint32_t node, std::uint32_t sink, std::size_t limit)
+        {
+            if (node == sink)
+            {
+                return limit;
+            }
+            for (; next[node] < out[node].size(); ++next[node])
+            {
+                auto e = out[node][next[node]];
+                auto& edge = edges[e];
+                if (edge.capacity == 0 || level[edge.to] != level[node] + 1)
+                {
+                    continue;
+                }
+                if (auto pushed = Push(edge.to, sink, std::min(limit, edge.capacity)))
+                {
+                    edges[e].capacity -= pushed;
+                    edges[e ^ 1].capacity += pushed;
+                    return pushed;
+                }
+            }
+            return 0;
+        }
+    };
+}
+
+DockingMatcher::DockingMatcher(const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    Update(stations);
+}
+
+void DockingMatcher::Update(const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    const std::size_t size = stations.size();
+    m_ids.resize(size);
+    m_bodies.resize(size);
+    m_active.resize(size);
+    m_ports.resize(size);
+    m_id_to_index.clear();
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const auto& station = *stations[i];
+        m_ids[i] = station.GetStationID();
+        m_bodies[i] = station.GetOrbitingBody();
+        m_active[i] = station.isActive();
+        m_ports[i] = station.GetDockingPortQuantities().GetAsArray();
+        // First station wins if the file has duplicate IDs
+        m_id_to_index.emplace(m_ids[i], i);
+    }
+
+    for (auto it = m_docked.begin(); it != m_docked.end();)
+    {
+        it = m_id_to_index.count(it->second.station_id) ? std::next(it) : m_docked.erase(it);
+    }
+    CountOccupied();
+}
+
+void DockingMatcher::CountOccupied()
+{
+    m_occupied.assign(m_ids.size(), {});
+    for (const auto& [vessel, berth] : m_docked)
+    {
+        ++m_occupied[m_id_to_index.at(berth.station_id)][static_cast<std::size_t>(berth.port)];
+    }
+}
+
+vector<IncomingVessel> DockingMatcher::ReadVessels(std::istream& in)
+{
+    vector<IncomingVessel> vessels;
+    string line;
+    std::size_t line_number {};
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        try {
+            std::string_view text = line;
+            auto name = BatchScript::NextToken(text);
+            if (name.empty() || name.front() == '#')
+            {
+                continue;
+            }
+
+            IncomingVessel vessel {string(name), CelestialBody::KERBIN, 0, ""};
+            auto body = string(BatchScript::NextToken(text));
+            auto sizes = BatchScript::NextToken(text);
+            vessel.station = string(BatchScript::NextToken(text));
+            if (sizes.empty() || !BatchScript::NextToken(text).empty())
+            {
+                throw std::invalid_argument("expected a vessel name, body, port sizes and optional station ID");
+            }
+            if (!Utility::StringToPlanet(body, vessel.body))
+            {
+                throw std::invalid_argument(fmt::format("unknown body {}", body));
+            }
+
+            while (!sizes.empty())
+            {
+                auto comma = sizes.find(',');
+                auto size = sizes.substr(0, comma);
+                sizes.remove_prefix(comma == std::string_view::npos ? sizes.size() : comma + 1);
+
+                auto found = std::find(std::begin(port_names), std::end(port_names), size);
+                if (found == std::end(port_names))
+                {
+                    throw std::invalid_argument(fmt::format("unknown port size {}", size));
+                }
+                vessel.ports |= static_cast<std::uint8_t>(1u << (found - std::begin(port_names)));
+            }
+            vessels.push_back(std::move(vessel));
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("line {}: {}", line_number, e.what()));
+        }
+    }
+    return vessels;
+}
+
+vector<Docking> DockingMatcher::Schedule(const vector<IncomingVessel>& vessels)
+{
+    const std::size_t size = m_ids.size();
+    constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+    // Vessels that want the same thing, in the order given
+    struct Group
+    {
+        CelestialBody body;
+        std::uint8_t ports;
+        std::size_t station; // size for any station
+        vector<std::size_t> vessels;
+    };
+    vector<Group> groups;
+    std::unordered_map<std::uint64_t, std::size_t> group_of;
+    std::unordered_set<string> named;
+    for (std::size_t v = 0; v < vessels.size(); ++v)
+    {
+        const auto& vessel = vessels[v];
+        // A name listed twice is one vessel
+        if (m_docked.count(vessel.name) || !named.insert(vessel.name).second)
+        {
+            continue;
+        }
+        std::size_t station = size;
+        if (!vessel.station.empty())
+        {
+            auto found = m_id_to_index.find(vessel.station);
+            if (found == m_id_to_index.end())
+            {
+                throw std::invalid_argument(fmt::format("{}: no station with ID {}", vessel.name, vessel.station));
+            }
+            station = found->second;
+        }
+
+        auto key = (static_cast<std::uint64_t>(station) << 16) | (static_cast<std::uint64_t>(vessel.body) << 8) |
+                   vessel.ports;
+        auto [it, added] = group_of.emplace(key, groups.size());
+        if (added)
+        {
+            groups.push_back(Group {vessel.body, vessel.ports, station, {}});
+        }
+        groups[it->second].vessels.push_back(v);
+    }
+
+    // Nodes: source, groups, a pool per body and port size, a node per
+    // station and port size with a port free, sink
+    const auto source = static_cast<std::uint32_t>(0);
+    const std::size_t first_pool = 1 + groups.size();
+    const std::size_t first_berth = first_pool + NUM_CELESTIAL_BODIES * NUM_DOCKING_PORTS;
+    vector<std::uint32_t> berth_node(size * NUM_DOCKING_PORTS, 0);
+    std::size_t nodes = first_berth;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (std::size_t port = 0; port < NUM_DOCKING_PORTS; ++port)
+        {
+            if (m_active[i] && m_ports[i][port] > m_occupied[i][port] &&
+                static_cast<std::size_t>(m_bodies[i]) < NUM_CELESTIAL_BODIES)
+            {
+                berth_node[i * NUM_DOCKING_PORTS + port] = static_cast<std::uint32_t>(nodes++);
+            }
+        }
+    }
+    const auto sink = static_cast<std::uint32_t>(nodes);
+    auto pool_node = [first_pool](CelestialBody body, std::size_t port) {
+        return static_cast<std::uint32_t>(first_pool + static_cast<std::size_t>(body) * NUM_DOCKING_PORTS + port);
+    };
+
+    MaxFlowGraph graph(nodes + 1);
+    vector<vector<std::size_t>> group_edges(groups.size());
+    for (std::size_t g = 0; g < groups.size(); ++g)
+    {
+        const auto& group = groups[g];
+        auto node = static_cast<std::uint32_t>(1 + g);
+        graph.AddEdge(source, node, group.vessels.size());
+        for (std::size_t port = 0; port < NUM_DOCKING_PORTS; ++port)
+        {
+            if (!(group.ports & (1u << port)) || static_cast<std::size_t>(group.body) >= NUM_CELESTIAL_BODIES)
+            {
+                continue;
+            }
+            if (group.station == size)
+            {
+                group_edges[g].push_back(graph.AddEdge(node, pool_node(group.body, port), unlimited));
+            }
+            else if (m_bodies[group.station] == group.body && berth_node[group.station * NUM_DOCKING_PORTS + port])
+            {
+                group_edges[g].push_back(
+                    graph.AddEdge(node, berth_node[group.station * NUM_DOCKING_PORTS + port], unlimited));
+            }
+        }
+    }
+    vector<std::size_t> pool_edges;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        for (std::size_t port = 0; port < NUM_DOCKING_PORTS; ++port)
+        {
+            auto berth = berth_node[i * NUM_DOCKING_PORTS + port];
+            if (berth)
+            {
+                pool_edges.push_back(graph.AddEdge(pool_node(m_bodies[i], port), berth, unlimited));
+                graph.AddEdge(berth, sink, m_ports[i][port] - m_occupied[i][port]);
+            }
+        }
+    }
+    graph.Run(source, sink);
+
+    // Hand out the ports each pool passed on, station by station
+    vector<vector<std::pair<std::uint32_t, std::size_t>>> pool_out(NUM_CELESTIAL_BODIES * NUM_DOCKING_PORTS);
+    for (auto e : pool_edges)
+    {
+        if (graph.Flow(e) > 0)
+        {
+            auto pool = graph.edges[e ^ 1].to - first_pool;
+            pool_out[pool].emplace_back(graph.edges[e].to, graph.Flow(e));
+        }
+    }
+    vector<std::pair<std::size_t, std::size_t>> berth_of(nodes); // station and port per berth node
+    for (std::size_t i = 0; i < size * NUM_DOCKING_PORTS; ++i)
+    {
+        if (berth_node[i])
+        {
+            berth_of[berth_node[i]] = {i / NUM_DOCKING_PORTS, i % NUM_DOCKING_PORTS};
+        }
+    }
+
+    vector<std::pair<std::size_t, Docking>> placed;
+    auto dock = [this, &placed, &vessels, &berth_of](std::size_t vessel, std::uint32_t berth) {
+        auto [station, port] = berth_of[berth];
+        ++m_occupied[station][port];
+        m_docked[vessels[vessel].name] = Berth {m_ids[station], static_cast<DockingPort>(port)};
+        placed.emplace_back(vessel, Docking {vessels[vessel].name, station, static_cast<DockingPort>(port)});
+    };
+    for (std::size_t g = 0; g < groups.size(); ++g)
+    {
+        auto vessel = groups[g].vessels.begin();
+        for (auto e : group_edges[g])
+        {
+            auto target = graph.edges[e].to;
+            for (auto count = graph.Flow(e); count > 0; --count)
+            {
+                if (target >= first_berth)
+                {
+                    dock(*vessel++, target);
+                    continue;
+                }
+                auto& ports = pool_out[target - first_pool];
+                dock(*vessel++, ports.back().first);
+                if (--ports.back().second == 0)
+                {
+                    ports.pop_back();
+                }
+            }
+        }
+    }
+
+    // Back into the order the vessels were given
+    std::sort(placed.begin(), placed.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    vector<Docking> dockings;
+    dockings.reserve(placed.size());
+    for (auto& entry : placed)
+    {
+        dockings.push_back(std::move(entry.second));
+    }
+    return dockings;
+}
+
+bool DockingMatcher::Undock(const string& vessel)
+{
+    auto found = m_docked.find(vessel);
+    if (found == m_docked.end())
+    {
+        return false;
+    }
+    --m_occupied[m_id_to_index.at(found->second.station_id)][static_cast<std::size_t>(found->second.port)];
+    m_docked.erase(found);
+    return true;
+}
+
+bool DockingMatcher::IsDocked(const string& vessel) const
+{
+    return m_docked.count(vessel) > 0;
+}
+
+std::size_t DockingMatcher::GetFreePorts(std::size_t station, DockingPort port) const
+{
+    auto total = m_ports.at(station).at(static_cast<std::size_t>(port));
+    auto taken = m_occupied.at(station).at(static_cast<std::size_t>(port));
+    return total > taken ? total - taken : 0;
+}
+
+void DockingMatcher::WriteState(std::ostream& out) const
+{
+    json state = json::array();
+    for (const auto& [vessel, berth] : m_docked)
+    {
+        state.push_back({{"vessel", vessel},
+                         {"station", berth.station_id},
+                         {"port", port_names[static_cast<std::size_t>(berth.port)]}});
+    }
+    out << state.dump(4) << '\n';
+}
+
+void DockingMatcher::ReadState(std::istream& in)
+{
+    json state;
+    try {
+        in >> state;
+    }
+    catch (const json::exception& e)
+    {
+        throw std::runtime_error(e.what());
+    }
+    if (!state.is_array())
+    {
+        throw std::runtime_error("expected an array of docked vessels");
+    }
+
+    m_docked.clear();
+    for (const auto& entry : state)
+    {
+        try {
+            auto station = entry.at("station").get<string>();
+            auto port = entry.at("port").get<string>();
+            auto found = std::find(std::begin(port_names), std::end(port_names), port);
+            if (found == std::end(port_names))
+            {
+                throw std::runtime_error(fmt::format("unknown port size {}", port));
+            }
+            if (m_id_to_index.count(station))
+            {
+                m_docked[entry.at("vessel").get<string>()] =
+                    Berth {station, static_cast<DockingPort>(found - std::begin(port_names))};
+            }
+        }
+        catch (const json::exception& e)
+        {
+            throw std::runtime_error(e.what());
+        }
+    }
+    CountOccupied();
+}
@@ -0,0 +1,63 @@
+#ifndef BATCH_SCRIPT_HPP
+#define BATCH_SCRIPT_HPP
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "station_list.hpp"
+
+using std::string;
+using std::vector;
+
+// Applies a script of station commands directly to a StationList without
+// going through the console menus. One command per line, blank lines and
+// lines starting with # are ignored. Stations are referred to by station ID,
+// which may be quoted if it contains spaces.
+//
+//     add-station <station as a CSV row, same columns as --export>
+//     add-kerbal <station id> <kerbal name>
+//     remove-kerbal <station id> <kerbal name>
+//     set-capacity <station id> <capacity>
+//     delete <station id>
+//
+// Each command is checked once as it is applied (station exists, capacity
+// not exceeded, ...). Deletes are collected and applied in one pass at the
+// end so a long script doesn't shift the station list on every delete.
+class BatchScript
+{
+  public:
+    explicit BatchScript(StationList& stations);
+
+    // Runs every command in in, printing an error with the line number for
+    // each command that fails. Returns the number of failed commands.
+    std::size_t Run(std::istream& in);
+    std::size_t GetCommandsApplied() const noexcept;
+
+    // Applies a single command line. Throws std::runtime_error if it fails.
+    // Returns false for blank and comment lines.
+    bool Apply(std::string_view line);
+    // Carries out any deletes still pending.
+    void Flush();
+    // Finds the index of a station by ID. Returns false if there is none.
+    bool LookupStation(const string& id, std::size_t& index) const;
+
+    // Splits the first word (or quoted string) off text and returns it.
+    // Throws std::runtime_error for an unterminated quote.
+    static std::string_view NextToken(std::string_view& text);
+
+  private:
+    StationList& m_stations;
+    std::unordered_map<string, std::size_t> m_id_to_index;
+    vector<bool> m_deleted;
+    vector<std::size_t> m_pending_deletes;
+    std::size_t m_applied {};
+
+    void ApplyCommand(std::string_view command, std::string_view arguments);
+    void BuildIdMap();
+    std::size_t FindStation(std::string_view& arguments);
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef CELESTIAL_BODY
 #define CELESTIAL_BODY
 
+#include <cstddef>
+
 enum class CelestialBody
 {
     KERBOL,
@@ -23,4 +25,6 @@ enum class CelestialBody
 
 };
 
-#endif
\ No newline at end of file
+constexpr std::size_t NUM_CELESTIAL_BODIES = static_cast<std::size_t>(CelestialBody::ELOO) + 1;
+
+#endif
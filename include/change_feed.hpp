@@ -0,0 +1,120 @@
+#ifndef CHANGE_FEED_HPP
+#define CHANGE_FEED_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using std::vector;
+
+enum class StationChangeKind : std::uint32_t
+{
+    STATION_ADDED,
+    STATION_DELETED,
+    STATION_MODIFIED, // changed in a way not covered below
+    KERBAL_BOARDED,
+    KERBAL_LEFT,
+    CAPACITY_CHANGED,
+    RELOADED          // whole list replaced, consumers should start over
+};
+
+// One change to a station list. Text fields are copied into the event so it
+// can be read on another thread after the list has moved on; text longer
+// than max_text is cut short.
+struct StationChange
+{
+    static constexpr std::size_t max_text = 47;
+
+    std::uint64_t sequence;
+    StationChangeKind kind;
+    // Index of the station at the time of the change. For deletes it's the
+    // index the station had before it was removed.
+    std::uint32_t index;
+    // New capacity for CAPACITY_CHANGED and STATION_ADDED, number of kerbals
+    // aboard afterwards for KERBAL_BOARDED and KERBAL_LEFT, size of the list
+    // for RELOADED.
+    std::uint64_t value;
+    char station_id[max_text + 1];
+    char kerbal[max_text + 1];
+
+    std::string_view GetStationID() const noexcept;
+    std::string_view GetKerbal() const noexcept;
+};
+
+// Bounded ring buffer of StationChange events with one writer (the station
+// list) and any number of readers on other threads. Publishing never
+// blocks or allocates: the oldest events are overwritten, and a reader
+// that falls more than GetCapacity() events behind is told how many it
+// missed and skipped ahead.
+//
+// Each slot is a seqlock. The writer zeroes the slot's stamp, writes the
+// event and then stores its sequence number + 1 in the stamp; a reader
+// copies the event and keeps it only if the stamp was the expected value
+// both before and after the copy.
+class ChangeFeed : public std::enable_shared_from_this<ChangeFeed>
+{
+  public:
+    class Subscription
+    {
+      public:
+        // Copies up to max_events new events into out (replacing its
+        // contents) and returns how many.
+        std::size_t Poll(vector<StationChange>& out, std::size_t max_events = 256);
+        // Events overwritten before this subscriber read them. Once this is
+        // non-zero the subscriber has missed changes and should resync.
+        std::uint64_t GetDropped() const noexcept;
+        std::uint64_t GetCursor() const noexcept;
+        // Number of events published but not yet polled.
+        std::uint64_t GetLag() const noexcept;
+
+      private:
+        friend class ChangeFeed;
+        Subscription(std::shared_ptr<const ChangeFeed> feed, std::uint64_t cursor);
+        std::shared_ptr<const ChangeFeed> m_feed;
+        std::uint64_t m_cursor;
+        std::uint64_t m_dropped {};
+    };
+
+    // capacity is rounded up to a power of two.
+    explicit ChangeFeed(std::size_t capacity = 4096);
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+    std::size_t GetCapacity() const noexcept;
+    // Sequence number the next event will get.
+    std::uint64_t GetHead() const noexcept;
+
+    // Only one thread may publish.
+    void Publish(StationChangeKind kind, std::size_t index, std::uint64_t value,
+                 std::string_view station_id, std::string_view kerbal = {}) noexcept;
+    // Starts at the next event published. The feed must be owned by a
+    // shared_ptr.
+    Subscription Subscribe() const;
+
+  private:
+    static constexpr std::size_t words_per_event = sizeof(StationChange) / sizeof(std::uint64_t);
+    static_assert(sizeof(StationChange) % sizeof(std::uint64_t) == 0);
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> stamp {0};
+        std::array<std::atomic<std::uint64_t>, words_per_event> words {};
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+    std::atomic<std::uint64_t> m_head {0};
+
+    enum class ReadResult
+    {
+        OK,
+        NOT_READY,
+        OVERWRITTEN
+    };
+    ReadResult Read(std::uint64_t sequence, StationChange& event) const noexcept;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CLOSE_APPROACH_HPP
+#define CLOSE_APPROACH_HPP
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+struct CloseApproach
+{
+    double time;     // game seconds of closest approach
+    double distance; // m
+    CelestialBody body;
+    string first_id;
+    string second_id;
+};
+
+// Screens stations orbiting the same body for pairs that come within a
+// distance of each other. Stations whose apoapsis/periapsis shells can't
+// come that close to any other station's are dropped first; the rest are
+// propagated over the time window and bucketed into a spatial hash each
+// step, so only stations in neighbouring cells are compared. Each pass a
+// pair makes is refined to its closest point and reported once.
+class CloseApproachFinder
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Checks the stations at indexes at start, start + step, ... for count
+    // steps. Passes between steps are still found: cells are padded by how
+    // far two stations can close in half a step. Results are sorted by time.
+    static vector<CloseApproach> Find(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                      const vector<std::size_t>& indexes, double start, double step,
+                                      std::size_t count, double threshold, std::size_t threads = 0);
+
+    static void Print(std::ostream& out, const vector<CloseApproach>& approaches);
+};
+
+#endif
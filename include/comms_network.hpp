@@ -0,0 +1,75 @@
+#ifndef COMMS_NETWORK_HPP
+#define COMMS_NETWORK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "devices.hpp"
+#include "kepler_propagator.hpp"
+#include "space_station.hpp"
+
+using std::vector;
+
+// The CommNet graph between stations and the Kerbin ground stations (DSN)
+// at one moment. Each station's antennas are combined into one power the
+// way the game does: the strongest antenna times (sum of all / strongest)
+// to the power 0.75. Two nodes are linked when they are within
+// sqrt(power1 * power2) of each other; only stations with a relay antenna
+// pass signals on. Planets and moons don't block signals here.
+class CommsNetwork
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Tracking station level 3.
+    static constexpr double default_dsn_power = 250e9;
+
+    static double DevicePower(KSP_SM::CommunicationDevice dev) noexcept;
+    static bool IsRelay(KSP_SM::CommunicationDevice dev) noexcept;
+    static double StationPower(const SpaceStation& station);
+    static bool IsRelayStation(const SpaceStation& station);
+
+    // Builds the graph for every station at game time seconds. Stations are
+    // grouped by power so each group is only searched as far as it can
+    // reach; the search runs on a thread pool (0 threads = one per core).
+    void Build(const vector<std::unique_ptr<SpaceStation>>& stations, double time, std::size_t threads = 0,
+               double dsn_power = default_dsn_power);
+
+    std::size_t GetLinkCount() const noexcept;
+    // Whether a station can reach Kerbin, directly or through relays.
+    bool IsConnected(std::size_t index) const;
+    // Stations the shortest signal path from index to Kerbin passes
+    // through, starting with index itself. Empty if it isn't connected.
+    vector<std::size_t> RelayPath(std::size_t index) const;
+    // Length in metres of that path, infinite if not connected.
+    double PathLength(std::size_t index) const;
+
+  private:
+    struct Link
+    {
+        std::uint32_t a;
+        std::uint32_t b;
+        double length;
+    };
+
+    std::size_t m_stations {}; // the DSN is node m_stations
+    vector<bool> m_relay;      // per node, true for the DSN
+    // Links as adjacency lists: node i's links are m_targets[m_offsets[i]]
+    // up to m_offsets[i + 1]
+    vector<std::size_t> m_offsets;
+    vector<std::uint32_t> m_targets;
+    vector<double> m_lengths;
+    vector<bool> m_connected;         // per station, from union-find
+    vector<double> m_distance;        // shortest path length to the DSN
+    vector<std::uint32_t> m_previous; // next node towards the DSN
+
+    void FindLinks(const vector<double>& power, const PositionColumns& positions, const std::array<double, 3>& dsn,
+                   double dsn_power, std::size_t threads, vector<Link>& links) const;
+    void FindConnected(const vector<Link>& links);
+    void FindPaths();
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CONCURRENT_STATION_LIST_HPP
+#define CONCURRENT_STATION_LIST_HPP
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "space_station.hpp"
+#include "persistent_sequence.hpp"
+
+using std::vector;
+
+// Station list that can be shared between threads. Readers take an
+// immutable snapshot and can keep using it for as long as they like.
+// Writers are serialized on a mutex; each write builds a new version that
+// shares all unchanged stations and tree nodes with the previous one, then
+// publishes it.
+//
+// The current version is published as a raw pointer and protected with
+// hazard pointers: a reader announces the pointer it is about to use in a
+// slot, checks it is still current and takes a reference through
+// shared_from_this. A writer only drops its own reference to an old version
+// once no slot holds it, so readers never take a lock a writer holds. With
+// more than max_readers threads taking snapshots at the same instant, the
+// extra readers spin until a slot frees up.
+class ConcurrentStationList
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using StationPtr = std::shared_ptr<const SpaceStation>;
+    using Stations = PersistentSequence<StationPtr>;
+
+    static constexpr std::size_t max_readers = 64;
+
+    class Snapshot : public std::enable_shared_from_this<Snapshot>
+    {
+      public:
+        explicit Snapshot(Stations stations);
+        std::size_t GetSize() const noexcept;
+        const SpaceStation& At(std::size_t index) const;
+        const Stations& GetStations() const noexcept;
+        // Writes the text report of every station in the snapshot.
+        void DumpStations(std::ostream& out) const;
+
+      private:
+        Stations m_stations;
+    };
+
+    ConcurrentStationList();
+    explicit ConcurrentStationList(vector<std::unique_ptr<SpaceStation>> stations);
+    ConcurrentStationList(const ConcurrentStationList&) = delete;
+    ConcurrentStationList& operator=(const ConcurrentStationList&) = delete;
+
+    // Never blocks on writers.
+    std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+    void AddStation(std::unique_ptr<SpaceStation> station);
+    bool InsertStation(std::size_t index, std::unique_ptr<SpaceStation> station);
+    bool DeleteStation(std::size_t index);
+    // Applies modify to a copy of the station at index and publishes the
+    // copy. Readers holding older snapshots keep seeing the old station.
+    bool ModifyStation(std::size_t index, const std::function<void(SpaceStation&)>& modify);
+    bool ReplaceStation(std::size_t index, std::unique_ptr<SpaceStation> station);
+    // Publishes whatever update returns as one version, for batches of
+    // changes that readers should see all at once.
+    void Update(const std::function<Stations(const Stations&)>& update);
+    void Reset(vector<std::unique_ptr<SpaceStation>> stations);
+
+    // Deep copy of the current stations, for handing back to a StationList.
+    vector<std::unique_ptr<SpaceStation>> CopyStations() const;
+
+  private:
+    struct alignas(64) HazardSlot
+    {
+        std::atomic<bool> claimed {false};
+        std::atomic<const Snapshot*> snapshot {nullptr};
+    };
+
+    std::atomic<const Snapshot*> m_current {nullptr};
+    mutable std::array<HazardSlot, max_readers> m_hazards;
+    std::mutex m_write_mutex;
+    // Writer side only, under m_write_mutex
+    std::shared_ptr<const Snapshot> m_current_owner;
+    vector<std::shared_ptr<const Snapshot>> m_retired;
+
+    const Stations& CurrentStations() const noexcept;
+    void Publish(Stations stations);
+};
+
+#endif
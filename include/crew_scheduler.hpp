@@ -0,0 +1,110 @@
+#ifndef CREW_SCHEDULER_HPP
+#define CREW_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+class StationList;
+
+// One kerbal changing station as part of a rotation plan.
+struct CrewMove
+{
+    string kerbal;
+    std::size_t from;
+    std::size_t to;
+    double delta_v; // m/s of the Hohmann transfer, NaN between bodies
+};
+
+// Works out which kerbals to move so every station ends up with a crew in
+// the range asked for, never above its capacity. Kerbals on one station are
+// interchangeable unless a demand names them, so the problem is solved as a
+// min-cost flow from stations with kerbals to spare to stations with berths
+// to fill, one unit of flow per kerbal moved.
+//
+//     CrewScheduler scheduler(stations.GetStations());
+//     scheduler.SetCrew(0, 3);
+//     scheduler.Assign("Jebediah Kerman", 2);
+//     auto plan = scheduler.Solve(CrewScheduler::Cost::MOVES);
+//     CrewScheduler::Apply(stations, plan, "stations.json");
+class CrewScheduler
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    enum class Cost
+    {
+        MOVES,   // fewest kerbals moved
+        DELTA_V, // least Hohmann transfer delta-v, then fewest moves
+    };
+
+    // Reads the rosters and capacities; later changes to the list aren't
+    // seen. A kerbal listed on two stations is taken to be on the first.
+    explicit CrewScheduler(const vector<std::unique_ptr<SpaceStation>>& stations);
+
+    // Crew wanted aboard a station. Without a demand a station may end up
+    // with anywhere from no kerbals to its capacity.
+    void SetCrew(std::size_t index, std::size_t count);
+    void SetMinCrew(std::size_t index, std::size_t count);
+    void SetMaxCrew(std::size_t index, std::size_t count);
+    // The kerbal has to end up aboard the station at index.
+    // Throws std::invalid_argument if no station has the kerbal aboard.
+    void Assign(const string& kerbal, std::size_t index);
+    // The kerbal isn't moved. Throws std::invalid_argument like Assign().
+    void Keep(const string& kerbal);
+
+    // Reads demands, one per line; blank lines and lines starting with # are
+    // ignored and IDs and names may be quoted:
+    //
+    //     crew <station id> <count>
+    //     min <station id> <count>
+    //     max <station id> <count>
+    //     assign <kerbal name> <station id>
+    //     keep <kerbal name>
+    //
+    // Throws std::runtime_error with the line number of a bad demand.
+    void ReadDemands(std::istream& in);
+
+    // The cheapest set of moves meeting every demand, the named moves first.
+    // Throws std::runtime_error if no plan can meet them.
+    vector<CrewMove> Solve(Cost cost) const;
+
+    // Applies a plan to the list in one transaction, saving it to
+    // save_filename if given. Throws std::runtime_error, leaving the list as
+    // it was, if a kerbal isn't where the plan expects.
+    static void Apply(StationList& stations, const vector<CrewMove>& plan, const string& save_filename = "");
+
+  private:
+    // Copied from the stations
+    vector<string> m_ids;
+    vector<vector<string>> m_rosters;
+    vector<std::size_t> m_capacity;
+    vector<CelestialBody> m_bodies;
+    vector<double> m_radius; // semi-major axis, for transfer costs
+
+    std::unordered_map<string, std::size_t> m_id_to_index;
+    std::unordered_map<string, std::size_t> m_kerbal_to_index;
+    vector<std::size_t> m_min_crew;
+    vector<std::size_t> m_max_crew;
+    // Kerbals a demand names, and the station each has to end up on
+    std::unordered_map<string, std::size_t> m_fixed;
+
+    std::size_t FindKerbal(const string& kerbal) const;
+    std::size_t FindStation(const string& id) const;
+    // Cost of moving one kerbal from each sender to each receiver, row by
+    // sender; delta-v is in cm/s so the flow works in whole numbers
+    vector<std::int64_t> MoveCosts(Cost cost, const vector<std::size_t>& senders,
+                                   const vector<std::size_t>& receivers) const;
+};
+
+#endif
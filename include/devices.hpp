@@ -9,6 +9,8 @@ constexpr size_t NUM_DOCKING_PORTS = 5;
 
 namespace KSP_SM
 {
+    enum class CommunicationDevice;
+    enum class DockingPort;
 
     struct DockingPortCount
     {
@@ -23,6 +25,8 @@ namespace KSP_SM
         DockingPortCount() = default;
         explicit DockingPortCount(std::array<std::size_t, 5> counts);
         std::array<std::size_t, NUM_DOCKING_PORTS> GetAsArray() const;
+        std::size_t GetCount(DockingPort port) const;
+        bool operator==(const DockingPortCount&) const = default;
     };
 
     struct CommsDevCount
@@ -41,6 +45,8 @@ namespace KSP_SM
         CommsDevCount() = default;
         explicit CommsDevCount(std::array<std::size_t, 9> counts);
         std::array<std::size_t, NUM_COMM_DEVICES> GetAsArray() const;
+        std::size_t GetCount(CommunicationDevice dev) const;
+        bool operator==(const CommsDevCount&) const = default;
     };
 
     enum class CommunicationDevice
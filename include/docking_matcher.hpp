@@ -0,0 +1,108 @@
+#ifndef DOCKING_MATCHER_HPP
+#define DOCKING_MATCHER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "devices.hpp"
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// A vessel waiting to dock. It can use a free port of any size in ports
+// on a station orbiting body; if station is set, only on that station.
+struct IncomingVessel
+{
+    string name;
+    CelestialBody body;
+    std::uint8_t ports; // bit (1 << DockingPort) per usable size
+    string station;     // station ID, empty for any station around body
+};
+
+struct Docking
+{
+    string vessel;
+    std::size_t station;
+    KSP_SM::DockingPort port;
+};
+
+// Assigns incoming vessels to free docking ports. Each round is solved as
+// a bipartite matching between vessels and free ports, so as many vessels
+// dock as the ports allow; greedy first-fit can strand a vessel whose only
+// size was taken by one that could have used another. Vessels that want
+// the same body, sizes and station are interchangeable, and so are the
+// free ports of one size around a body, so the matching runs as a max flow
+// over those groups rather than over every vessel and port.
+//
+// Docked vessels keep their ports until Undock(), so later rounds only
+// match against the ports still free.
+class DockingMatcher
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    explicit DockingMatcher(const vector<std::unique_ptr<SpaceStation>>& stations);
+
+    // Picks up changed port counts, and stations added or removed, after an
+    // edit to the list. Docked vessels stay on their station by ID; those
+    // whose station has gone are undocked. Inactive stations take no
+    // vessels.
+    void Update(const vector<std::unique_ptr<SpaceStation>>& stations);
+
+    // Reads vessels, one per line; blank lines and lines starting with #
+    // are ignored and names may be quoted:
+    //
+    //     <vessel name> <body> <sizes, e.g. sm,md> [station id]
+    //
+    // Sizes are xs, sm, md, lg and xl. Throws std::runtime_error with the
+    // line number of a bad vessel.
+    static vector<IncomingVessel> ReadVessels(std::istream& in);
+
+    // Docks as many of vessels as there are compatible free ports for and
+    // returns where each went; the rest are left waiting. Where not all of
+    // a group of interchangeable vessels fit, the earlier ones in vessels
+    // dock first. Vessels already docked are skipped.
+    vector<Docking> Schedule(const vector<IncomingVessel>& vessels);
+
+    // Frees the port a vessel is using. Returns false if it isn't docked.
+    bool Undock(const string& vessel);
+    bool IsDocked(const string& vessel) const;
+    std::size_t GetFreePorts(std::size_t station, KSP_SM::DockingPort port) const;
+
+    // Docked vessels as a JSON array of {"vessel", "station", "port"}, so
+    // rounds can carry on across runs.
+    void WriteState(std::ostream& out) const;
+    // Replaces the docked vessels with those in a WriteState() file, skipping
+    // any whose station no longer exists. Throws std::runtime_error for a
+    // file that isn't in that format.
+    void ReadState(std::istream& in);
+
+  private:
+    struct Berth
+    {
+        string station_id;
+        KSP_SM::DockingPort port;
+    };
+
+    vector<string> m_ids;
+    vector<CelestialBody> m_bodies;
+    vector<bool> m_active;
+    // Ports per station and size, and how many of them are taken
+    vector<std::array<std::size_t, NUM_DOCKING_PORTS>> m_ports;
+    vector<std::array<std::size_t, NUM_DOCKING_PORTS>> m_occupied;
+    std::unordered_map<string, std::size_t> m_id_to_index;
+    std::unordered_map<string, Berth> m_docked;
+
+    void CountOccupied();
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef KEPLER_PROPAGATOR_HPP
+#define KEPLER_PROPAGATOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// Station positions at one moment, one column per axis. Positions are in
+// metres from the centre of the body each station orbits, with z along the
+// body's rotation axis.
+struct PositionColumns
+{
+    vector<double> x;
+    vector<double> y;
+    vector<double> z;
+
+    std::size_t Size() const noexcept;
+    void Resize(std::size_t size);
+};
+
+// Moves stations along their Kepler orbits. The orbits are copied into
+// columns when the propagator is made, so later edits to the list don't
+// affect it. Kepler's equation is solved for every station of a time step
+// together, with Newton iterations run over the whole column until all of
+// them have converged; time ranges are split across a thread pool.
+class KeplerPropagator
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    // Called with the step number, its game time and every station's position.
+    using StepHandler = std::function<void(std::size_t step, double time, const PositionColumns& positions)>;
+
+    // Propagates the stations at indexes, in that order.
+    KeplerPropagator(const vector<std::unique_ptr<SpaceStation>>& stations, const vector<std::size_t>& indexes);
+    explicit KeplerPropagator(const vector<std::unique_ptr<SpaceStation>>& stations);
+
+    std::size_t Size() const noexcept;
+    const vector<string>& GetStationIDs() const noexcept;
+
+    // Positions at game time seconds. Stations orbiting an unknown body get NaN.
+    void Propagate(double time, PositionColumns& positions) const;
+
+    // Position of one station (by its place in the propagator) at game time
+    // seconds, solved on its own.
+    std::array<double, 3> PositionAt(std::size_t index, double time) const;
+
+    // Positions at start, start + step, ... for count steps. Steps are worked
+    // out in parallel batches and on_step is called on this thread, in time
+    // order. A thread count of 0 uses one thread per core.
+    void PropagateRange(double start, double step, std::size_t count, std::size_t threads,
+                        const StepHandler& on_step) const;
+
+    // Writes "time,id,x,y,z" CSV rows for every station at every step.
+    void WriteTrajectory(std::ostream& out, double start, double step, std::size_t count, std::size_t threads) const;
+
+  private:
+    vector<string> m_ids;
+    // Per station constants of the orbit
+    vector<double> m_mean_motion;     // rad/s
+    vector<double> m_mean_anomaly;    // rad at game time 0
+    vector<double> m_eccentricity;
+    vector<double> m_semi_major_axis; // m
+    vector<double> m_semi_minor_axis; // m
+    // Unit vectors towards periapsis (p) and 90 degrees ahead of it in the
+    // orbital plane (q)
+    vector<double> m_px, m_py, m_pz;
+    vector<double> m_qx, m_qy, m_qz;
+
+    struct Workspace;
+
+    void AddStation(const SpaceStation& station);
+
+    // Solves one time step. The workspace keeps each station's E - M from
+    // the previous step as the starting guess, so consecutive steps converge
+    // in one or two iterations.
+    void SolveStep(double time, Workspace& workspace, PositionColumns& positions) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef LIFE_SUPPORT_HPP
+#define LIFE_SUPPORT_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "space_station.hpp"
+
+using std::vector;
+
+// Runs every station's supplies down over time. Each station uses rate
+// supplies per kerbal aboard per game day (6 hours), so its crew sets how
+// fast it runs dry; crews don't change during a run. The state is kept in
+// columns and advanced in fixed steps, a block of stations at a time
+// through every step, so a block stays in L1 for the whole run. The step
+// kernel only uses selects, so with -fno-trapping-math (see CMakeLists.txt)
+// GCC vectorizes it. Steps in which no station of a block runs out are
+// applied together.
+class LifeSupportSimulator
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // USI Life Support's rate: 0.00005 supplies a second.
+    static constexpr double default_rate = 1.08;
+
+    // Copies each station's supplies and crew; later changes to the list
+    // aren't seen. Crewed stations with no supplies are dry from day 0.
+    explicit LifeSupportSimulator(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                  double rate = default_rate);
+
+    std::size_t Size() const noexcept;
+
+    // Advances every station by days in steps of step_days, the last one
+    // shortened to end on days. Can be called again to carry on.
+    // Throws std::invalid_argument unless both are positive.
+    void Advance(double days, double step_days);
+
+    double GetElapsedDays() const noexcept;
+    // Supplies left per station.
+    const vector<double>& GetSupplies() const noexcept;
+    // Day each station ran out, counted from the start of the first run
+    // and exact within a step, NaN if it hasn't.
+    const vector<double>& GetDryDays() const noexcept;
+
+  private:
+    vector<double> m_supplies;
+    vector<double> m_consumption; // per day
+    vector<double> m_dry_day;
+    double m_elapsed {};
+
+    static void Step(double* __restrict supplies, const double* __restrict consumption, double* __restrict dry_day,
+                     std::size_t count, double now, double step);
+};
+
+#endif
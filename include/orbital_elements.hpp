@@ -0,0 +1,91 @@
+#ifndef ORBITAL_ELEMENTS_HPP
+#define ORBITAL_ELEMENTS_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <fmt/format.h>
+#include "celestial_body.hpp"
+#include "space_station.hpp"
+
+using std::vector;
+
+// Physical constants of a planet or moon, as in the stock game. The orbit
+// of the body itself is simplified to a circle in its parent's equatorial
+// plane.
+struct BodyConstants
+{
+    double gravitational_parameter; // m^3/s^2
+    double radius;                  // m
+    CelestialBody parent;           // Kerbol for the planets and Kerbol itself
+    double orbit_radius;            // m, semi-major axis around parent
+    double mean_anomaly;            // rad, at game time 0
+};
+
+// Quantities derived from a station's apoapsis, periapsis and the body it
+// orbits. Distances are from the centre of the body.
+struct OrbitalElements
+{
+    double semi_major_axis; // m
+    double eccentricity;
+    double period;          // s
+    double apoapsis_speed;  // m/s
+    double periapsis_speed; // m/s
+};
+
+// The same quantities for a whole station list, one column per quantity,
+// so the batch computation and range filters run over contiguous doubles.
+struct OrbitalElementColumns
+{
+    vector<double> semi_major_axis;
+    vector<double> eccentricity;
+    vector<double> period;
+    vector<double> apoapsis_speed;
+    vector<double> periapsis_speed;
+
+    std::size_t Size() const noexcept;
+    void Resize(std::size_t size);
+    OrbitalElements Get(std::size_t index) const;
+    void Set(std::size_t index, const OrbitalElements& elements);
+    void Insert(std::size_t index, const OrbitalElements& elements);
+    void Erase(std::size_t index);
+    void Clear() noexcept;
+};
+
+// Kepler orbit quantities for stations. Apoapsis and periapsis are
+// altitudes above the surface, as the game shows them; if they are the
+// wrong way round they are swapped rather than rejected.
+class OrbitalElementsEngine
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Throws std::out_of_range for a body that isn't in CelestialBody.
+    static const BodyConstants& GetBodyConstants(CelestialBody body);
+
+    // Position of a body's centre relative to Kerbol at game time seconds.
+    static std::array<double, 3> BodyPosition(CelestialBody body, double time);
+
+    static OrbitalElements Compute(const KSP_SM::OrbitalParameters& orbit, CelestialBody body);
+    static OrbitalElements Compute(const SpaceStation& station);
+
+    // Computes every station in one pass and resizes columns to match.
+    // Stations orbiting an unknown body get NaN for every quantity.
+    static void ComputeAll(const vector<std::unique_ptr<SpaceStation>>& stations, OrbitalElementColumns& columns);
+
+    // "1h 32m 7s"
+    static void FormatDuration(fmt::memory_buffer& out, double seconds);
+
+  private:
+    // The kernel behind ComputeAll. Inputs are the apsis radii from the
+    // centre of the body and its gravitational parameter. The loop has no
+    // branches and, built with -fno-math-errno (see CMakeLists.txt), sqrt
+    // has no side effects, so GCC and Clang vectorize it at -O3.
+    static void ComputeColumns(const double* __restrict apoapsis_radius, const double* __restrict periapsis_radius,
+                               const double* __restrict mu, std::size_t count, OrbitalElementColumns& columns,
+                               std::size_t offset);
+};
+
+#endif
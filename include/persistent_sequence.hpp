@@ -0,0 +1,209 @@
+#ifndef PERSISTENT_SEQUENCE_HPP
+#define PERSISTENT_SEQUENCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// Immutable sequence with structural sharing. Every modifying operation
+// returns a new sequence and leaves the original untouched, copying only the
+// O(log n) nodes on the path to the change; everything else is shared
+// between the two versions. Copying a sequence is O(1).
+//
+// Implemented as an implicit treap: nodes are ordered by position rather
+// than by key, and random priorities keep the tree balanced in expectation.
+template <typename T>
+class PersistentSequence
+{
+  public:
+    PersistentSequence() = default;
+
+    std::size_t Size() const noexcept
+    {
+        return SizeOf(m_root);
+    }
+
+    bool Empty() const noexcept
+    {
+        return m_root == nullptr;
+    }
+
+    const T& At(std::size_t index) const
+    {
+        if (index >= Size())
+        {
+            throw std::out_of_range("PersistentSequence index out of range");
+        }
+
+        const Node* node = m_root.get();
+        while (true)
+        {
+            std::size_t left_size = SizeOf(node->left);
+            if (index < left_size)
+            {
+                node = node->left.get();
+            }
+            else if (index == left_size)
+            {
+                return node->value;
+            }
+            else
+            {
+                index -= left_size + 1;
+                node = node->right.get();
+            }
+        }
+    }
+
+    PersistentSequence PushBack(T value) const
+    {
+        return Insert(Size(), std::move(value));
+    }
+
+    PersistentSequence Insert(std::size_t index, T value) const
+    {
+        if (index > Size())
+        {
+            throw std::out_of_range("PersistentSequence index out of range");
+        }
+
+        auto [left, right] = Split(m_root, index);
+        auto single = MakeNode(std::move(value), nullptr, nullptr, NextPriority());
+        return PersistentSequence(Merge(Merge(left, single), right));
+    }
+
+    PersistentSequence Erase(std::size_t index) const
+    {
+        if (index >= Size())
+        {
+            throw std::out_of_range("PersistentSequence index out of range");
+        }
+
+        auto [left, rest] = Split(m_root, index);
+        auto [removed, right] = Split(rest, 1);
+        return PersistentSequence(Merge(left, right));
+    }
+
+    PersistentSequence Set(std::size_t index, T value) const
+    {
+        if (index >= Size())
+        {
+            throw std::out_of_range("PersistentSequence index out of range");
+        }
+        return PersistentSequence(SetAt(m_root, index, std::move(value)));
+    }
+
+    // Calls function(value) for every element in order.
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        VisitInOrder(m_root.get(), function);
+    }
+
+  private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node
+    {
+        T value;
+        NodePtr left;
+        NodePtr right;
+        std::size_t size;
+        std::uint64_t priority;
+    };
+
+    NodePtr m_root;
+
+    explicit PersistentSequence(NodePtr root) : m_root(std::move(root))
+    {
+    }
+
+    static std::size_t SizeOf(const NodePtr& node) noexcept
+    {
+        return node ? node->size : 0;
+    }
+
+    static NodePtr MakeNode(T value, NodePtr left, NodePtr right, std::uint64_t priority)
+    {
+        std::size_t size = SizeOf(left) + SizeOf(right) + 1;
+        return std::make_shared<const Node>(Node {std::move(value), std::move(left), std::move(right), size, priority});
+    }
+
+    // splitmix64 over a per thread counter. The priorities only need to look
+    // random; they don't need to be unpredictable.
+    static std::uint64_t NextPriority() noexcept
+    {
+        thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull;
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Splits node into the first count elements and the rest.
+    static std::pair<NodePtr, NodePtr> Split(const NodePtr& node, std::size_t count)
+    {
+        if (!node)
+        {
+            return {nullptr, nullptr};
+        }
+
+        std::size_t left_size = SizeOf(node->left);
+        if (count <= left_size)
+        {
+            auto [left, right] = Split(node->left, count);
+            return {left, MakeNode(node->value, right, node->right, node->priority)};
+        }
+
+        auto [left, right] = Split(node->right, count - left_size - 1);
+        return {MakeNode(node->value, node->left, left, node->priority), right};
+    }
+
+    static NodePtr Merge(const NodePtr& left, const NodePtr& right)
+    {
+        if (!left)
+        {
+            return right;
+        }
+        if (!right)
+        {
+            return left;
+        }
+
+        if (left->priority > right->priority)
+        {
+            return MakeNode(left->value, left->left, Merge(left->right, right), left->priority);
+        }
+        return MakeNode(right->value, Merge(left, right->left), right->right, right->priority);
+    }
+
+    static NodePtr SetAt(const NodePtr& node, std::size_t index, T value)
+    {
+        std::size_t left_size = SizeOf(node->left);
+        if (index < left_size)
+        {
+            return MakeNode(node->value, SetAt(node->left, index, std::move(value)), node->right, node->priority);
+        }
+        if (index == left_size)
+        {
+            return MakeNode(std::move(value), node->left, node->right, node->priority);
+        }
+        return MakeNode(node->value, node->left, SetAt(node->right, index - left_size - 1, std::move(value)), node->priority);
+    }
+
+    template <typename Function>
+    static void VisitInOrder(const Node* node, Function& function)
+    {
+        while (node)
+        {
+            VisitInOrder(node->left.get(), function);
+            function(node->value);
+            node = node->right.get();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SAVE_IMPORTER_HPP
+#define SAVE_IMPORTER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "devices.hpp"
+#include "space_station.hpp"
+
+using std::string;
+
+// Reads stations out of a KSP persistent.sfs save. The save is a tree of
+// ConfigNode text; every VESSEL of type Station under FLIGHTSTATE becomes a
+// station with the vessel's name, orbit and crew, and its parts counted up
+// into docking ports, comms devices, crew capacity and USI Life Support
+// supplies. The file is read line by line in a single pass and only the
+// vessel being read is kept, so a save of any size takes the same memory.
+//
+//     SaveImporter importer;
+//     std::ifstream save("persistent.sfs");
+//     importer.ReadSave(save, [&](auto station) { list.push_back(std::move(station)); });
+class SaveImporter
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using StationHandler = std::function<void(std::unique_ptr<SpaceStation>)>;
+
+    // What one part adds to a station.
+    struct PartInfo
+    {
+        std::size_t crew {};
+        std::optional<KSP_SM::DockingPort> port;
+        std::optional<KSP_SM::CommunicationDevice> comms;
+    };
+
+    // Knows the stock crew parts, docking ports and antennas.
+    SaveImporter();
+
+    // Adds parts, or overrides stock ones, from lines of
+    //
+    //     port <part name> <xs|sm|md|lg|xl>
+    //     comms <part name> <c16|c16s|c8888|cdts|hg5|hg55|ra15|ra2|ra100>
+    //     crew <part name> <n>
+    //
+    // for mods. Blank lines and lines starting with # are ignored and names
+    // may be quoted. Throws std::runtime_error with the line number of a bad
+    // line.
+    void ReadPartMap(std::istream& in);
+    // Part names are matched with '_' and '.' treated alike, as KSP turns
+    // the underscores of part config names into dots.
+    void SetPart(const string& name, const PartInfo& info);
+    const PartInfo* FindPart(const string& name) const;
+
+    // Calls on_station for every station vessel in the save and returns how
+    // many there were. Stations are identified by the vessel's persistentId.
+    // Stations around a body this program doesn't know, or not in a closed
+    // orbit, are passed over and counted in skipped if it is given. Throws
+    // std::runtime_error naming the line if the file isn't a well-formed
+    // save.
+    std::size_t ReadSave(std::istream& in, const StationHandler& on_station, std::size_t* skipped = nullptr) const;
+
+  private:
+    std::unordered_map<string, PartInfo> m_parts;
+
+    static string PartKey(const string& name);
+};
+
+#endif
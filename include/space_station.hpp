@@ -10,6 +10,7 @@
 #include "celestial_body.hpp"
 
 #include <nlohmann/json.hpp>
+#include <fmt/format.h>
 #include "devices.hpp"
 
 using nlohmann::json;
@@ -26,10 +27,17 @@ namespace KSP_SM
     {
         size_t apoapsis { 100000};
         std::size_t periapsis {100000};
+        // Orientation and phase, in degrees. Files without them load as an
+        // equatorial orbit at periapsis at game time 0.
+        double inclination {};
+        double ascending_node {};      // longitude of the ascending node
+        double argument_of_periapsis {};
+        double mean_anomaly {};        // at game time 0
 
     public:
         OrbitalParameters() = default;
         explicit OrbitalParameters(size_t ap, size_t pe);
+        bool operator==(const OrbitalParameters&) const = default;
     };
 
     
@@ -46,10 +54,14 @@ namespace KSP_SM
         {
 
         public:
-            ~SpaceStation();
+            ~SpaceStation() = default;
             string ToString() const;
+            void FormatTo(fmt::memory_buffer& out) const;
             static string DockingPortToString(DockingPort port);
             static string CommsDeviceToString(CommunicationDevice dev);
+            // True if j stores its devices as the old dockingPorts/commsDevs
+            // arrays rather than per-device counts. from_json reads both.
+            static bool IsLegacyJson(const json& j);
             string GetName() const;
             string GetStationID() const;
             std::size_t GetCapacity() const;
@@ -57,10 +69,23 @@ namespace KSP_SM
             void AddKerbal(const std::string& name);
             bool isActive() const;
             OrbitalParameters GetOrbitalDetails() const;
+            CelestialBody GetOrbitingBody() const;
+            const DockingPortCount& GetDockingPortQuantities() const;
+            const CommsDevCount& GetCommsDevQuantities() const;
+            const vector<string>& GetKerbals() const;
             void ChangeCapcity(const std::size_t& capacity);
+            // Life support supplies aboard, in the units
+            // LifeSupportSimulator consumes.
+            double GetSupplies() const;
+            void SetSupplies(double supplies);
             SpaceStation() = default;
             explicit SpaceStation(string station_id) noexcept;
+            SpaceStation(const SpaceStation&) = default;
+            SpaceStation(SpaceStation&&) noexcept = default;
+            SpaceStation& operator=(const SpaceStation&) = default;
+            SpaceStation& operator=(SpaceStation&&) noexcept = default;
             std::size_t RemoveKerbalByIndex(std::size_t index);
+            bool operator==(const SpaceStation&) const = default;
             
 
 
@@ -75,6 +100,7 @@ namespace KSP_SM
             DockingPortCount m_port_quantities;
             vector<string> m_kerbals;
             CelestialBody m_orbiting_body = CelestialBody::KERBIN;
+            double m_supplies {};
             std::unique_ptr<SpaceStation> build();
             friend void to_json(json& j, const SpaceStation& ss);
             friend void from_json(const json& j, SpaceStation& ss);
@@ -92,6 +118,7 @@ namespace KSP_SM
         SpaceStationBuilder& SetDockingPortQuantities(const DockingPortCount& quantities);
         SpaceStationBuilder& SetCommsDevicesQuantities(const CommsDevCount& quantities);
         SpaceStationBuilder& SetOrbitingBody(CelestialBody planet);
+        SpaceStationBuilder& SetSupplies(double supplies);
         std::unique_ptr<SpaceStation> build();
         static std::unique_ptr<SpaceStation> createStationFromConsoleInput();
 
@@ -0,0 +1,73 @@
+#ifndef SPATIAL_GRID_HPP
+#define SPATIAL_GRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kepler_propagator.hpp"
+
+using std::vector;
+
+// Points bucketed into cubic cells, for finding the points near each other
+// without comparing every pair. Cells are found through a hash of their
+// coordinates, so the grid takes the same memory however far apart the
+// points are; two cells sharing a hash only means a few extra candidates.
+class SpatialGrid
+{
+  public:
+    // Rebuilds the grid over positions. Memory is reused between builds.
+    void Build(const PositionColumns& positions, double cell_size);
+
+    // Calls visit(j) for every point in the 27 cells around (x, y, z), which
+    // includes every point within cell_size of it. A point can be visited
+    // twice if two of the cells share a hash.
+    template <typename Visit>
+    void ForEachNear(double x, double y, double z, Visit visit) const
+    {
+        auto cx = Cell(x);
+        auto cy = Cell(y);
+        auto cz = Cell(z);
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dz = -1; dz <= 1; ++dz)
+                {
+                    ForEachInCell(Hash(cx + dx, cy + dy, cz + dz), visit);
+                }
+            }
+        }
+    }
+
+  private:
+    double m_cell_size = 1.0;
+    vector<std::uint64_t> m_hashes; // per point
+    vector<std::uint32_t> m_order;  // points sorted by hash
+    std::size_t m_mask {};
+    // Open addressing table from a hash to its run in m_order
+    vector<std::uint64_t> m_slot_hashes;
+    vector<std::uint32_t> m_slot_begin;
+    vector<std::uint32_t> m_slot_end;
+
+    std::int64_t Cell(double coordinate) const noexcept;
+    static std::uint64_t Hash(std::int64_t x, std::int64_t y, std::int64_t z) noexcept;
+
+    template <typename Visit>
+    void ForEachInCell(std::uint64_t hash, Visit& visit) const
+    {
+        for (std::size_t slot = hash & m_mask; m_slot_end[slot] != 0; slot = (slot + 1) & m_mask)
+        {
+            if (m_slot_hashes[slot] == hash)
+            {
+                for (auto i = m_slot_begin[slot]; i < m_slot_end[slot]; ++i)
+                {
+                    visit(static_cast<std::size_t>(m_order[i]));
+                }
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STATION_DIFF_HPP
+#define STATION_DIFF_HPP
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// Compares two versions of a station list, matching stations by ID.
+// Stations are first compared by StationHash, so only the ones that
+// changed are compared field by field.
+class StationDiff
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    enum class Kind
+    {
+        ADDED,
+        REMOVED,
+        MODIFIED
+    };
+
+    struct FieldChange
+    {
+        string field;
+        string before;
+        string after;
+    };
+
+    struct Difference
+    {
+        Kind kind;
+        string id;
+        string name;
+        vector<FieldChange> fields; // only for MODIFIED
+    };
+
+    // Added and modified stations come in the order of after, then removed
+    // stations in the order of before. If a file repeats an ID the first
+    // station with it is used.
+    static vector<Difference> Compare(const vector<std::unique_ptr<SpaceStation>>& before,
+                                      const vector<std::unique_ptr<SpaceStation>>& after);
+    static vector<FieldChange> CompareFields(const SpaceStation& before, const SpaceStation& after);
+
+    // One line per station, "+" added, "-" removed, "~" modified, followed by
+    // an indented line per changed field.
+    static void Print(std::ostream& out, const vector<Difference>& differences);
+};
+
+#endif
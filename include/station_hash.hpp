@@ -0,0 +1,30 @@
+#ifndef STATION_HASH_HPP
+#define STATION_HASH_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "space_station.hpp"
+
+using std::string;
+
+// 64-bit content hashes of stations, for noticing that a station changed
+// without keeping a copy of it. Not cryptographic: it's fast, and two
+// different stations getting the same hash is only a 1 in 2^64 chance.
+class StationHash
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Appends a canonical encoding of every field of station to out.
+    // Stations with equal fields always encode to the same bytes, on any
+    // platform, and any difference in a field changes the encoding.
+    static void Serialize(const SpaceStation& station, string& out);
+
+    static std::uint64_t Hash(const SpaceStation& station);
+    // MurmurHash64A.
+    static std::uint64_t Hash(std::string_view bytes, std::uint64_t seed = 0) noexcept;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef STATION_HISTORY_HPP
+#define STATION_HISTORY_HPP
+
+#include <deque>
+#include <string>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "space_station.hpp"
+#include "persistent_sequence.hpp"
+
+using std::string;
+using std::vector;
+
+// Undo/redo history for a station list. Alongside the list it keeps a
+// persistent copy of the stations (see PersistentSequence), so saving the
+// state before an edit is O(1) and each recorded edit costs O(log n) plus a
+// copy of the one station that changed. Undo and redo restore only the
+// station the edit touched.
+class StationHistory
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using unique_station = std::unique_ptr<SpaceStation>;
+
+    enum class EditKind
+    {
+        ADD,
+        DELETE,
+        MODIFY,
+        REPLACE_ALL // bulk changes, undone by restoring the whole list
+    };
+
+    // What an undo or redo did to the list, so callers can update anything
+    // derived from it.
+    struct Change
+    {
+        EditKind kind;
+        std::size_t index;
+        string station_id; // of the station added, deleted or modified
+    };
+
+    // A depth of 0 turns history off; nothing is recorded or copied.
+    void SetDepth(std::size_t depth);
+    std::size_t GetDepth() const noexcept;
+    bool IsEnabled() const noexcept;
+
+    // Forgets all history and starts tracking stations as they are now.
+    void Reset(const vector<unique_station>& stations);
+
+    void RecordAdd(const SpaceStation& station);
+    void RecordDelete(std::size_t index);
+    void RecordModify(std::size_t index, const SpaceStation& station);
+    void RecordReplaceAll(const vector<unique_station>& stations);
+    // Records several edits as one undoable step. Indexes in modified and
+    // deleted (sorted, no repeats) are from before the edits; added
+    // stations were appended after the deletes.
+    void RecordBatch(const vector<std::pair<std::size_t, const SpaceStation*>>& modified,
+                     const vector<std::size_t>& deleted, const vector<const SpaceStation*>& added);
+
+    bool CanUndo() const noexcept;
+    bool CanRedo() const noexcept;
+    // Apply the previous/next state to stations. Return false if there is
+    // nothing to undo/redo.
+    bool Undo(vector<unique_station>& stations, Change& change);
+    bool Redo(vector<unique_station>& stations, Change& change);
+
+  private:
+    using StationPtr = std::shared_ptr<const SpaceStation>;
+    using Stations = PersistentSequence<StationPtr>;
+
+    struct Entry
+    {
+        Stations version; // state before the edit on the undo stack, after it on the redo stack
+        EditKind kind;
+        std::size_t index;
+    };
+
+    std::size_t m_depth {};
+    Stations m_current;
+    std::deque<Entry> m_undo;
+    vector<Entry> m_redo;
+
+    void Push(EditKind kind, std::size_t index);
+    static Stations Snapshot(const vector<unique_station>& stations);
+    static void Restore(const Stations& version, vector<unique_station>& stations);
+};
+
+#endif
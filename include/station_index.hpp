@@ -0,0 +1,111 @@
+#ifndef STATION_INDEX_HPP
+#define STATION_INDEX_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "devices.hpp"
+#include "orbital_elements.hpp"
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// Fixed length bit set with one bit per station in the station list.
+// Bit i refers to the station at index i of StationList::GetStations().
+class StationBitmap
+{
+  public:
+    StationBitmap() = default;
+    explicit StationBitmap(std::size_t size, bool value = false);
+
+    std::size_t Size() const noexcept;
+    bool Test(std::size_t pos) const;
+    void Set(std::size_t pos, bool value);
+    void PushBack(bool value);
+    void Insert(std::size_t pos, bool value);
+    void Erase(std::size_t pos);
+    void Clear() noexcept;
+
+    // Number of set bits.
+    std::size_t Count() const noexcept;
+    vector<std::size_t> GetSetPositions() const;
+
+    StationBitmap& operator&=(const StationBitmap& other);
+    StationBitmap& operator|=(const StationBitmap& other);
+    StationBitmap operator~() const;
+
+  private:
+    static constexpr std::size_t bits_per_word = 64;
+    vector<std::uint64_t> m_words;
+    std::size_t m_size {};
+    void ClearUnusedBits() noexcept;
+};
+
+StationBitmap operator&(StationBitmap lhs, const StationBitmap& rhs);
+StationBitmap operator|(StationBitmap lhs, const StationBitmap& rhs);
+
+// Precomputed bitmaps for the common station predicates. Compound filters
+// are answered by combining the bitmaps a word at a time instead of
+// evaluating every predicate against every station.
+//
+// Filter expressions are made of the terms below combined with
+// & (and), | (or), ! (not) and parentheses:
+//     active              station is active
+//     full                station is at capacity
+//     body=<name>         station orbits the named planet or moon
+//     port=<xs|sm|md|lg|xl>
+//                         station has at least one docking port of the size
+//     comms=<c16|c16s|c8888|cdts|hg5|hg55|ra15|ra2|ra100>
+//                         station has at least one of the comms device
+//     period<seconds, sma<meters, ecc<value
+//                         orbit range checks; <, <=, > and >= all work
+// e.g. "active & body=kerbin & !full & (port=md | port=lg) & period<3600"
+class StationIndex
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    StationIndex() = default;
+    void Rebuild(const vector<std::unique_ptr<SpaceStation>>& stations);
+    void Append(const SpaceStation& station);
+    void Update(std::size_t index, const SpaceStation& station);
+    void Insert(std::size_t index, const SpaceStation& station);
+    void Erase(std::size_t index);
+    void Clear() noexcept;
+    std::size_t Size() const noexcept;
+
+    const StationBitmap& Active() const noexcept;
+    const StationBitmap& AtCapacity() const noexcept;
+    const StationBitmap& Orbiting(CelestialBody body) const;
+    const StationBitmap& HasPort(KSP_SM::DockingPort port) const;
+    const StationBitmap& HasCommsDevice(KSP_SM::CommunicationDevice dev) const;
+    // Derived orbit quantities of every station, kept up to date with the
+    // bitmaps.
+    const OrbitalElementColumns& GetOrbitalElements() const noexcept;
+
+    // Evaluates a filter expression. Throws std::invalid_argument if the
+    // expression can't be parsed.
+    StationBitmap Query(const string& expression) const;
+
+  private:
+    StationBitmap m_active;
+    StationBitmap m_full;
+    std::array<StationBitmap, NUM_CELESTIAL_BODIES> m_orbiting;
+    std::array<StationBitmap, NUM_DOCKING_PORTS> m_ports;
+    std::array<StationBitmap, NUM_COMM_DEVICES> m_comms;
+    OrbitalElementColumns m_elements;
+
+    void AppendBits(const SpaceStation& station);
+    void SetBits(std::size_t index, const SpaceStation& station);
+    StationBitmap ParseOr(const string& expr, std::size_t& pos) const;
+    StationBitmap ParseAnd(const string& expr, std::size_t& pos) const;
+    StationBitmap ParseUnary(const string& expr, std::size_t& pos) const;
+    StationBitmap ParseTerm(const string& expr, std::size_t& pos) const;
+    StationBitmap ParseRange(const string& term, std::size_t comparison) const;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef STATION_IO_HPP
+#define STATION_IO_HPP
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+#include "space_station.hpp"
+
+using std::string;
+
+enum class StationFormat
+{
+    JSON,   // single pretty printed array, as written by WriteStationsToFile
+    NDJSON, // one json object per line
+    CSV,
+    TSV
+};
+
+// Line oriented import and export of stations. Every reader and writer
+// handles one station at a time, so converting between the line formats
+// runs in constant memory no matter how big the fleet is.
+//
+// CSV and TSV columns, in order:
+//     id, name, active, capacity, apoapsis, periapsis, orbiting,
+//     port_xs, port_sm, port_md, port_lg, port_xl,
+//     comms_0 ... comms_8 (same numbering as the json comms_N keys),
+//     kerbals (names separated by ';', with ';' and '\' in a name escaped
+//              by a '\'),
+//     inclination, ascending_node, arg_periapsis, mean_anomaly (degrees),
+//     supplies
+// The last five are optional on import, for files written before they were
+// added; supplies can only be given after the four angles.
+// A header row is written on export and skipped on import.
+class StationIO
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using StationHandler = std::function<void(std::unique_ptr<SpaceStation>)>;
+
+    // Picks a format from the file extension (.csv, .tsv, .ndjson, .jsonl),
+    // defaulting to JSON.
+    static StationFormat FormatFromFilename(const string& filename);
+    static bool IsLineFormat(StationFormat format) noexcept;
+
+    static void WriteHeader(std::ostream& out, StationFormat format);
+    // Appends one line for station to line, which callers clear and reuse.
+    static void FormatStation(fmt::memory_buffer& line, const SpaceStation& station, StationFormat format);
+
+    // Calls on_station for every station in in and returns how many were
+    // read. Throws std::runtime_error naming the line on malformed input.
+    static std::size_t ReadStations(std::istream& in, StationFormat format, const StationHandler& on_station);
+
+    // Reads a JSON array one station at a time, so the document is never
+    // held in memory as a whole. Stations in the legacy array layout are
+    // converted as they are read; if legacy_count is given it is set to how
+    // many there were. Throws std::runtime_error on malformed input.
+    static std::size_t ReadJsonStations(std::istream& in, const StationHandler& on_station,
+                                        std::size_t* legacy_count = nullptr);
+
+    // Streams stations from one line format to another without holding more
+    // than one station in memory.
+    static std::size_t Convert(std::istream& in, StationFormat in_format, std::ostream& out, StationFormat out_format);
+
+    // Parses a single station line. Throws std::runtime_error if it's malformed.
+    static std::unique_ptr<SpaceStation> ParseLine(std::string_view line, StationFormat format);
+
+    // Calls write with a stream on a temporary file next to filename, then
+    // renames the temporary file over filename once it has been written and
+    // closed. If anything fails the old file is left untouched and
+    // std::runtime_error is thrown.
+    static void ReplaceFile(const string& filename, const std::function<void(std::ostream&)>& write);
+
+  private:
+    static std::unique_ptr<SpaceStation> ParseDelimitedLine(std::string_view line, char delimiter, string& scratch);
+};
+
+#endif
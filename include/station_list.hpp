@@ -2,10 +2,20 @@
 #define STATION_LIST_HPP
 
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
+#include <istream>
+#include <ostream>
 #include "space_station.hpp"
+#include "station_index.hpp"
+#include "station_order.hpp"
+#include "station_io.hpp"
+#include "station_history.hpp"
+#include "change_feed.hpp"
+#include "concurrent_station_list.hpp"
+#include "station_validator.hpp"
 #include <nlohmann/json.hpp>
 
 using std::vector;
@@ -14,22 +24,97 @@ using unique_station = std::unique_ptr<KSP_SM::SpaceStationBuilder::SpaceStation
 
 class StationList {
   public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
     StationList() = default;
-    void AddStation(unique_station& station) noexcept;
-    bool DeleteStation(const std::size_t index) noexcept;
+    void AddStation(unique_station& station);
+    bool DeleteStation(const std::size_t index);
+    // Deletes every station in indexes with a single pass over the list.
+    std::size_t DeleteStations(const vector<std::size_t>& indexes);
     void ListAllStations() const;
+    void ListStationsFromConsole();
+    vector<std::size_t> GetSortedPage(const vector<SortField>& spec, std::size_t offset, std::size_t limit,
+                                      const StationBitmap* filter = nullptr);
+    // The file format is picked from the extension (see StationIO). A
+    // filename of "-" reads from standard input.
     std::size_t ReadStationsFromFile(const string &filename);
+    std::size_t ReadStations(std::istream& in, StationFormat format);
+    // How stations are checked when they are read (off by default). In
+    // strict mode ReadStations throws std::runtime_error and leaves the
+    // list as it was if any station is invalid.
+    void SetValidation(ValidationMode mode, std::size_t threads = 0) noexcept;
+    ValidationMode GetValidation() const noexcept;
+    // Problems found by the last read.
+    const vector<ValidationIssue>& GetValidationIssues() const noexcept;
+    // Stations in the last JSON file read that used the legacy array layout.
+    std::size_t GetLegacyCount() const noexcept;
     std::size_t GetSize() noexcept;
+    // Goes up by at least one with every change made through the list
+    // (edits, deletes, undo/redo, reloads, transactions).
+    std::uint64_t GetModificationCount() const noexcept;
+    // Writes to a temporary file and renames it over filename, so a failed
+    // write leaves the old file as it was. Throws std::runtime_error on
+    // failure. "-" writes NDJSON to stdout.
     void WriteStationsToFile(const string &filename);
+    void WriteStations(std::ostream& out, StationFormat format) const;
+    void WriteStations(std::ostream& out, StationFormat format, const vector<std::size_t>& indexes) const;
+    // Writes the text report of each station in indexes to out, in order.
+    // With more than one thread the reports are rendered in chunks on a
+    // thread pool while this thread writes finished chunks out in order.
+    void DumpStations(std::ostream& out, const vector<std::size_t>& indexes, std::size_t threads = 1) const;
     vector<unique_station>& GetStations();
-    void Reset() noexcept;
+    void Reset();
     void ManageStationsFromConsole();
+    // Must be called after modifying a station obtained through GetStations()
+    // so the attribute index stays in sync.
+    void RefreshStation(const std::size_t index);
+    // Crew and capacity edits. These keep the index and history up to date
+    // and publish a specific change instead of STATION_MODIFIED.
+    void AddKerbal(const std::size_t index, const string& name);
+    std::size_t RemoveKerbal(const std::size_t index, const std::size_t kerbal_index);
+    // Returns false, changing nothing, if capacity is less than the crew.
+    bool ChangeCapacity(const std::size_t index, const std::size_t capacity);
+    const StationIndex& GetIndex() const noexcept;
+    StationBitmap Filter(const string &expression) const;
+    // Number of edits that can be undone. 0 (the default) disables history.
+    void SetHistoryDepth(const std::size_t depth);
+    bool Undo();
+    bool Redo();
+    // Starts publishing every change to the list into a ring buffer of the
+    // given size. Calling it again returns the existing feed.
+    std::shared_ptr<ChangeFeed> EnableChangeFeed(const std::size_t capacity = 4096);
+    std::shared_ptr<ChangeFeed> GetChangeFeed() const noexcept;
+    // Starts keeping a ConcurrentStationList in step with every change, so
+    // other threads can render reports from snapshots while this list is
+    // being edited. Each change copies only the stations it touched.
+    // Calling it again returns the existing one.
+    std::shared_ptr<ConcurrentStationList> EnableSnapshots();
 
   private:
+   friend class StationTransaction;
    vector<unique_station> m_stations;
+   StationIndex m_index;
+   StationOrder m_order;
+   StationHistory m_history;
+   std::shared_ptr<ChangeFeed> m_feed;
+   std::shared_ptr<ConcurrentStationList> m_shared;
+   ValidationMode m_validation = ValidationMode::OFF;
+   std::size_t m_validation_threads {};
+   vector<ValidationIssue> m_validation_issues;
+   std::size_t m_legacy_count {};
+   std::uint64_t m_modification_count {};
    void AddKerbalsFromConsole(const std::size_t index, std::size_t max_additional);
    size_t RemoveKerbalFromConsole(const std::size_t& index);
    void ChangeCapacityFromConsole(const size_t& index);
+   std::size_t LoadStations(vector<unique_station> stations);
+   void StationChanged(const std::size_t index);
+   void Publish(StationChangeKind kind, std::size_t index, std::uint64_t value, std::string_view station_id,
+                std::string_view kerbal = {}) noexcept;
+   void Share(StationChangeKind kind, std::size_t index);
+   void PublishDifferences(std::size_t index, const SpaceStation& before, const SpaceStation& after);
+   void CommitTransaction(vector<std::pair<std::size_t, unique_station>>& modified,
+                          const vector<std::size_t>& deleted, vector<unique_station>& added,
+                          const string& save_filename);
 };
 
 
@@ -0,0 +1,69 @@
+#ifndef STATION_ORDER_HPP
+#define STATION_ORDER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "space_station.hpp"
+#include "station_index.hpp"
+
+using std::string;
+using std::vector;
+
+enum class SortKey
+{
+    INSERTION,
+    NAME,
+    ID,
+    CAPACITY,
+    FREE_SEATS,
+    APOAPSIS,
+    BODY,
+    CREW,
+    PERIOD,
+    SEMI_MAJOR_AXIS,
+    ECCENTRICITY
+};
+
+struct SortField
+{
+    SortKey key = SortKey::INSERTION;
+    bool descending = false;
+};
+
+// Cached sort permutation over the station list. Only as much of the
+// permutation as has been asked for is sorted (top-k via partial sort), and
+// it is kept until Invalidate() is called, so paging through a listing
+// doesn't re-sort the fleet.
+class StationOrder
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Parses a sort spec such as "free:desc,name". Keys are name, id,
+    // capacity, free, apoapsis, body, crew, period, sma and ecc, each
+    // optionally followed by :asc or :desc. Throws std::invalid_argument on an unknown key.
+    static vector<SortField> ParseSortSpec(const string& spec);
+
+    void Invalidate() noexcept;
+
+    // Returns up to limit station indexes starting at offset in the sorted
+    // order. If filter is given only stations with their bit set are counted.
+    // The orbit keys are read from elements, the index's cached columns for
+    // the same stations.
+    vector<std::size_t> GetPage(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                const OrbitalElementColumns& elements, const vector<SortField>& spec,
+                                std::size_t offset, std::size_t limit, const StationBitmap* filter = nullptr);
+
+  private:
+    vector<std::size_t> m_permutation;
+    vector<SortField> m_spec;
+    std::size_t m_sorted_count {};
+    bool m_valid = false;
+
+    void EnsureSorted(const vector<std::unique_ptr<SpaceStation>>& stations, const OrbitalElementColumns& elements,
+                      std::size_t count);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef STATION_SERVER_HPP
+#define STATION_SERVER_HPP
+
+#include <future>
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "station_list.hpp"
+#include "batch_script.hpp"
+#include "change_feed.hpp"
+#include "concurrent_station_list.hpp"
+#include "transfer_costs.hpp"
+
+using std::string;
+
+// Keeps a StationList loaded and serves requests over a local Unix domain
+// socket, so clients don't have to re-parse the station file on every
+// invocation. Linux only; it uses epoll to serve many clients from one
+// thread.
+//
+// Requests are single lines. Each response is zero or more data lines
+// followed by a line that is either "OK" or "ERR <message>".
+//     ping                       no data
+//     count                      number of stations
+//     get <station id>           the station as one NDJSON line
+//     filter <expression>        "<index> <station id>" per matching station
+//     nearest <station id>       "<delta-v> <station id>" for the 10
+//                                cheapest transfers from the station
+//     route <from>,<to>          "<from> <to> <delta-v>" per leg of the
+//                                cheapest chain of transfers
+//     dump <file>                write the station reports to a file
+//     save                       write the file now
+//     shutdown                   save and stop the server
+// plus every BatchScript command (add-station, add-kerbal, remove-kerbal,
+// set-capacity, delete). Changes are saved in the background at most once
+// per save interval, and when the server stops; a save that fails is logged
+// and tried again at the next interval. Dumps are rendered from a
+// snapshot on another thread, so requests keep being answered while a large
+// fleet is written out; they reflect the stations as they were when the
+// dump was requested. The transfer cost matrices are kept between requests
+// and only brought up to date, from the change feed, when a nearest or route
+// request comes in after the stations changed.
+//
+// A request longer than max_request_length is answered with "ERR request
+// too long" and the connection is closed. A client that lets more than
+// max_pending_output bytes of responses pile up unread is disconnected.
+class StationServer
+{
+  public:
+    static constexpr std::size_t max_request_length = 64 * 1024;
+    static constexpr std::size_t max_pending_output = 64 * 1024 * 1024;
+
+    StationServer(StationList& stations, string filename, string socket_path, int save_interval_seconds = 5);
+
+    // Serves requests until a shutdown request or SIGINT/SIGTERM. Returns a
+    // process exit code.
+    int Run();
+
+    // Sends each line of commands to the server and prints the responses.
+    // Returns a process exit code.
+    static int RunClient(const string& socket_path, std::istream& commands);
+
+  private:
+    struct Connection
+    {
+        string input;
+        string output;
+    };
+
+    StationList& m_stations;
+    BatchScript m_script;
+    string m_filename;
+    string m_socket_path;
+    int m_save_interval_seconds;
+    bool m_dirty = false;
+    bool m_stopping = false;
+    std::unordered_map<int, Connection> m_connections;
+    std::shared_ptr<ConcurrentStationList> m_snapshots;
+    std::vector<std::future<void>> m_dumps;
+    TransferCostEngine m_transfer_costs;
+    ChangeFeed::Subscription m_transfer_changes;
+    bool m_transfer_costs_ready = false;
+
+    // Answers the complete requests in connection's input. Returns false if
+    // the connection should be closed.
+    bool HandleInput(Connection& connection);
+    void HandleRequest(const string& request, string& response);
+    void StartDump(const string& filename);
+    void UpdateTransferCosts();
+    // Leaves m_dirty set and returns false if the file couldn't be written.
+    bool Save();
+};
+
+#endif
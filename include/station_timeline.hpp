@@ -0,0 +1,180 @@
+#ifndef STATION_TIMELINE_HPP
+#define STATION_TIMELINE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// A station as it was at some game time.
+struct StationSnapshot
+{
+    string id;
+    bool active;
+    std::size_t capacity;
+    CelestialBody body;
+    KSP_SM::OrbitalParameters orbit;
+    vector<string> crew; // in the order they boarded
+};
+
+// A kerbal boarding or leaving a station.
+struct CrewRecord
+{
+    double time; // game seconds
+    string station_id;
+    string kerbal;
+    bool boarded;
+};
+
+// History of a fleet over game time: crews, capacity, orbit and the active
+// flag of every station. Only changes are stored, as an event log split
+// into columns (time, station, field, value) of variable-length integers;
+// times are stored as the gap since the previous event, numbers as the
+// difference from the station's previous value and angles as the bits that
+// changed. Every so often the whole fleet state is kept as a keyframe, so
+// the fleet at a time is found by a binary search for the keyframe before
+// it and a replay of the events since. Crew changes are also indexed per
+// station and per kerbal.
+//
+//     StationTimeline timeline;
+//     timeline.Record(0, stations.GetStations());
+//     ...edit the list...
+//     timeline.Record(3600, stations.GetStations());
+//     auto fleet = timeline.FleetAt(1800);
+class StationTimeline
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Records how stations differ from the last recorded state at game time
+    // seconds (kept to the millisecond). Stations are matched by ID; ones
+    // no longer in the list are recorded as removed. Crew order isn't
+    // tracked. Throws std::invalid_argument if time is before the last
+    // recorded time.
+    void Record(double time, const vector<std::unique_ptr<SpaceStation>>& stations);
+
+    // Stations that existed at time, in the order they were first recorded.
+    vector<StationSnapshot> FleetAt(double time) const;
+    // Crew changes between from and to (inclusive), oldest first. Empty
+    // for an ID or name that was never recorded.
+    vector<CrewRecord> StationCrewHistory(const string& station_id, double from, double to) const;
+    vector<CrewRecord> KerbalHistory(const string& kerbal, double from, double to) const;
+    bool HasStation(const string& station_id) const;
+
+    std::size_t GetEventCount() const noexcept;
+    // Bytes taken by the event columns.
+    std::size_t GetEncodedSize() const noexcept;
+    // Time of the last recording, NaN if there is none.
+    double GetLastTime() const noexcept;
+
+    // Binary file of the names and event columns; keyframes and indexes are
+    // rebuilt when it is read back.
+    void Write(std::ostream& out) const;
+    // Replaces the timeline with one written by Write(). Throws
+    // std::runtime_error for anything else.
+    void Read(std::istream& in);
+
+  private:
+    enum class Field : std::uint8_t
+    {
+        ADDED,
+        REMOVED,
+        ACTIVE,
+        CAPACITY,
+        BODY,
+        APOAPSIS,
+        PERIAPSIS,
+        INCLINATION,
+        ASCENDING_NODE,
+        ARG_PERIAPSIS,
+        MEAN_ANOMALY,
+        BOARDED,
+        LEFT
+    };
+    static constexpr std::size_t num_angles = 4;
+
+    struct StationState
+    {
+        bool alive = false;
+        bool active = false;
+        std::uint64_t capacity {};
+        std::uint64_t body {};
+        std::uint64_t apoapsis {};
+        std::uint64_t periapsis {};
+        std::array<std::uint64_t, num_angles> angles {}; // bits of the doubles
+        vector<std::uint32_t> crew;                       // kerbal numbers, boarding order
+    };
+
+    struct Event
+    {
+        std::int64_t time; // ms
+        std::uint32_t station;
+        Field field;
+        std::uint64_t value;
+    };
+
+    // Where decoding stands: the next event and its byte in each column
+    struct Cursor
+    {
+        std::size_t event {};
+        std::size_t time_offset {};
+        std::size_t station_offset {};
+        std::size_t value_offset {};
+        std::int64_t time {};
+    };
+
+    struct Keyframe
+    {
+        Cursor cursor;
+        vector<StationState> stations;
+    };
+
+    struct CrewPosting
+    {
+        std::int64_t time; // ms
+        std::uint32_t other; // kerbal for a station's list, station for a kerbal's
+        bool boarded;
+    };
+
+    vector<string> m_station_ids;
+    vector<string> m_kerbals;
+    std::unordered_map<string, std::uint32_t> m_station_numbers;
+    std::unordered_map<string, std::uint32_t> m_kerbal_numbers;
+
+    // The event columns
+    vector<std::uint8_t> m_times;
+    vector<std::uint8_t> m_stations;
+    vector<std::uint8_t> m_fields;
+    vector<std::uint8_t> m_values;
+    Cursor m_end;
+
+    vector<StationState> m_current;
+    vector<Keyframe> m_keyframes;
+    vector<vector<CrewPosting>> m_station_crew;
+    vector<vector<CrewPosting>> m_kerbal_crew;
+
+    std::uint32_t StationNumber(const string& id);
+    std::uint32_t KerbalNumber(const string& name);
+    void Append(std::int64_t time, std::uint32_t station, Field field, std::uint64_t value);
+    // Updates the current state, crew indexes and keyframes for an event
+    // already in the columns; after is where decoding stands past it.
+    void Index(const Event& event, const Cursor& after);
+    bool Decode(Cursor& cursor, Event& event) const;
+    static void Apply(const Event& event, vector<StationState>& stations);
+    StationSnapshot Snapshot(std::uint32_t station, const StationState& state) const;
+    vector<CrewRecord> CrewHistory(const vector<CrewPosting>& postings, std::uint32_t number, bool by_station,
+                                   double from, double to) const;
+};
+
+#endif
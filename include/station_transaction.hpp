@@ -0,0 +1,87 @@
+#ifndef STATION_TRANSACTION_HPP
+#define STATION_TRANSACTION_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+class StationList;
+
+// Groups several changes to a StationList so they are applied together.
+// Changes are made to private copies of the stations they touch; the list
+// itself isn't changed until Commit(). Capacity limits are only checked at
+// commit time, so the order of the changes doesn't matter (a crew can be
+// moved off a station in the same transaction that lowers its capacity).
+//
+// Station indexes always refer to the list as it was when the transaction
+// was started, so deleting a station doesn't shift the others.
+//
+//     StationTransaction transaction(stations);
+//     transaction.RemoveKerbal(0, "Jebediah Kerman");
+//     transaction.AddKerbal(3, "Jebediah Kerman");
+//     transaction.SetCapacity(0, 2);
+//     transaction.Commit("stations.json");
+class StationTransaction
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using unique_station = std::unique_ptr<SpaceStation>;
+
+    explicit StationTransaction(StationList& stations);
+
+    void AddStation(unique_station station);
+    void AddKerbal(std::size_t index, const string& name);
+    // Returns false if the kerbal isn't aboard.
+    bool RemoveKerbal(std::size_t index, const string& name);
+    void SetCapacity(std::size_t index, std::size_t capacity);
+    void DeleteStation(std::size_t index);
+    // Replaces every detail of the station at index. On commit the new
+    // details are moved into the list's existing station object, so
+    // pointers and references to it stay valid.
+    void ReplaceStation(std::size_t index, unique_station station);
+
+    // The station as it will be after the transaction, with any capacity
+    // change not yet applied.
+    const SpaceStation& GetStation(std::size_t index) const;
+    bool IsDeleted(std::size_t index) const;
+    bool Empty() const noexcept;
+
+    // Checks every changed station and applies all of the changes at once,
+    // updating the list's index and undo history once. If save_filename is
+    // given the list is written to it, and the changes are taken back if the
+    // write fails. Throws std::runtime_error, leaving the list and the
+    // transaction as they were, if any station would have more kerbals than
+    // its capacity, or if the list has been changed some other way since the
+    // transaction started.
+    void Commit(const string& save_filename = "");
+    // Throws away every change.
+    void Rollback() noexcept;
+
+  private:
+    struct StagedStation
+    {
+        unique_station station;
+        std::optional<std::size_t> capacity;
+    };
+
+    StationList& m_stations;
+    std::size_t m_base_size;
+    std::uint64_t m_base_modification_count;
+    std::map<std::size_t, StagedStation> m_modified;
+    vector<std::size_t> m_deleted;
+    vector<unique_station> m_added;
+
+    StagedStation& Stage(std::size_t index);
+    void CheckIndex(std::size_t index) const;
+    void Validate() const;
+};
+
+#endif
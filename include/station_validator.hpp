@@ -0,0 +1,76 @@
+#ifndef STATION_VALIDATOR_HPP
+#define STATION_VALIDATOR_HPP
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "space_station.hpp"
+
+using std::string;
+using std::vector;
+
+// What to do with stations that break a validation rule when they are
+// loaded.
+enum class ValidationMode
+{
+    OFF,     // load everything without checking
+    STRICT,  // refuse to load the file
+    LENIENT, // load the file without the bad stations
+    REPORT   // load everything and list the problems
+};
+
+// Rules checked by StationValidator. The numbers are stable so reports can
+// be grepped and scripted against.
+enum class ValidationCode
+{
+    MISSING_ID = 1,               // V001 station ID is empty
+    DUPLICATE_ID = 2,             // V002 ID already used by an earlier station
+    CAPACITY_BELOW_CREW = 3,      // V003 more kerbals aboard than the capacity
+    PERIAPSIS_ABOVE_APOAPSIS = 4, // V004 periapsis higher than apoapsis
+    UNKNOWN_BODY = 5,             // V005 orbiting is not a known planet or moon
+    TOO_MANY_DEVICES = 6,         // V006 a port or comms count is implausibly large
+    BAD_SUPPLIES = 7              // V007 supplies negative or not a number
+};
+
+struct ValidationIssue
+{
+    std::size_t index; // of the station in the file
+    ValidationCode code;
+    string station_id;
+    string message;
+};
+
+// Checks stations after they are read, since from_json and the line
+// formats accept any values of the right type. Per-station rules run in
+// parallel over chunks of the list; duplicate IDs are found in one pass
+// afterwards.
+class StationValidator
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    // Largest count of any one docking port size or comms device accepted.
+    static constexpr std::size_t max_device_count = 1000;
+
+    // Parses "off", "strict", "lenient" or "report". Throws
+    // std::invalid_argument for anything else.
+    static ValidationMode ParseMode(const string& mode);
+    // "V003" etc.
+    static string CodeToString(ValidationCode code);
+
+    // Returns every rule broken by stations, ordered by station index. A
+    // thread count of 0 uses one thread per core.
+    static vector<ValidationIssue> Validate(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                            std::size_t threads = 0);
+    static void ValidateStation(const SpaceStation& station, std::size_t index, vector<ValidationIssue>& issues);
+    // Drops every station that has an issue, keeping the others in order.
+    // Returns how many were dropped.
+    static std::size_t RemoveInvalid(vector<std::unique_ptr<SpaceStation>>& stations,
+                                     const vector<ValidationIssue>& issues);
+
+    static void PrintReport(std::ostream& out, const vector<ValidationIssue>& issues);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef STATION_WATCHER_HPP
+#define STATION_WATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "station_list.hpp"
+
+using std::string;
+using std::vector;
+
+// Keeps a StationList in step with its file while other programs rewrite
+// it. Linux only; it uses inotify to notice the file changing.
+//
+// A background thread re-parses the file after each change and compares it
+// with the previous version by station ID, queueing only the stations that
+// were added, changed or removed. ApplyChanges() then updates just those
+// stations in one StationTransaction, so stations that didn't change keep
+// their place in the list and the cost of applying a reload depends on the
+// number of changed stations rather than the size of the file. Reloads are
+// checked with the list's validation mode: under strict a file with problems
+// is rejected, under lenient the bad stations are left out.
+class StationWatcher
+{
+  public:
+    explicit StationWatcher(string filename);
+    ~StationWatcher();
+    StationWatcher(const StationWatcher&) = delete;
+    StationWatcher& operator=(const StationWatcher&) = delete;
+
+    // Loads the file into stations and starts watching it. Returns false if
+    // the file can't be watched.
+    bool Start(StationList& stations);
+    void Stop();
+
+    // Applies the changes found since the last call. Must be called on the
+    // thread that owns stations. Returns the number of stations added,
+    // changed or removed. Throws std::runtime_error if the new file
+    // couldn't be read or would put a station over capacity; the list is
+    // left as it was.
+    std::size_t ApplyChanges(StationList& stations);
+    bool HasChanges() const noexcept;
+    const string& GetFilename() const noexcept;
+
+  private:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+    using unique_station = std::unique_ptr<SpaceStation>;
+
+    // A station to add or replace, or with no station, one to remove.
+    struct FileChange
+    {
+        string id;
+        std::size_t hint; // index of the station in the file
+        unique_station station;
+    };
+
+    string m_filename;
+    ValidationMode m_validation = ValidationMode::OFF; // the list's, taken by Start()
+    int m_inotify_fd = -1;
+    int m_stop_fd = -1;
+    std::thread m_thread;
+
+    // Index and StationHash of each station in the last version of the
+    // file, by station ID. Only used by the background thread once it has
+    // started.
+    std::unordered_map<string, std::pair<std::size_t, std::uint64_t>> m_baseline;
+
+    mutable std::mutex m_mutex;
+    vector<FileChange> m_pending;                       // guarded by m_mutex
+    std::unordered_map<string, std::size_t> m_pending_by_id; // guarded by m_mutex
+    string m_error;                                     // guarded by m_mutex
+    std::atomic<bool> m_has_changes {false};
+
+    void Run();
+    void Reload();
+    void Queue(FileChange change);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads. Tasks are run in submission order by
+// whichever worker is free.
+class ThreadPool
+{
+  public:
+    // A thread count of 0 uses one thread per hardware core.
+    explicit ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t GetThreadCount() const noexcept;
+    static std::size_t HardwareThreads() noexcept;
+
+    template <typename Function>
+    auto Submit(Function task) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        auto future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+    // Calls task(begin, end) over [0, count) split into chunks of chunk_size
+    // and blocks until every chunk has finished.
+    void ParallelFor(std::size_t count, std::size_t chunk_size,
+                     const std::function<void(std::size_t, std::size_t)>& task);
+
+  private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+
+    void WorkerLoop();
+};
+
+#endif
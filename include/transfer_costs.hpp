@@ -0,0 +1,86 @@
+#ifndef TRANSFER_COSTS_HPP
+#define TRANSFER_COSTS_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "space_station.hpp"
+#include "station_index.hpp"
+
+using std::string;
+using std::vector;
+
+// Delta-v of a Hohmann transfer between every pair of stations orbiting the
+// same body, one matrix per body. Each orbit is treated as circular at its
+// semi-major axis and plane changes are ignored, so the costs are for
+// comparing and planning rather than flying.
+//
+// The matrices are kept between calls to Update(), which only recomputes
+// what changed. Stations are matched up by ID, so adding or deleting
+// stations elsewhere in the list costs nothing; only the rows of stations
+// that joined a body or whose orbit moved are worked out again, the rest
+// are copied over.
+class TransferCostEngine
+{
+  public:
+    using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+    struct Transfer
+    {
+        std::size_t index; // in the station list
+        double delta_v;    // m/s, of this leg alone
+    };
+
+    // Delta-v in m/s between circular orbits of radius r1 and r2.
+    static double HohmannDeltaV(double mu, double r1, double r2) noexcept;
+
+    // Brings the matrices in line with stations. Whole matrices are filled
+    // in cache-sized tiles on a thread pool; a thread count of 0 uses one
+    // per core.
+    void Update(const vector<std::unique_ptr<SpaceStation>>& stations, std::size_t threads = 0);
+    void Clear() noexcept;
+    // Rows recomputed by the last Update(), for seeing what the cache saved.
+    std::size_t GetRecomputedRows() const noexcept;
+
+    // Delta-v from one station to another, infinite if they orbit different
+    // bodies. Indexes are into the list passed to Update().
+    double Cost(std::size_t from, std::size_t to) const;
+
+    // Up to count cheapest transfers from a station, cheapest first. If
+    // filter is given only stations with their bit set are considered.
+    vector<Transfer> Nearest(std::size_t from, std::size_t count, const StationBitmap* filter = nullptr) const;
+
+    // Cheapest chain of transfers from one station to another, where no leg
+    // may cost more than max_leg (0 for no limit). Stops along the way must
+    // pass filter if it is given. Empty if there is no such route.
+    vector<Transfer> CheapestRoute(std::size_t from, std::size_t to, double max_leg = 0,
+                                   const StationBitmap* filter = nullptr) const;
+
+  private:
+    struct BodyMatrix
+    {
+        vector<std::size_t> members; // station list indexes, in list order
+        vector<string> ids;          // station ID of each member
+        vector<double> radius;       // semi-major axis of each member
+        vector<float> costs;         // members x members, row major
+    };
+
+    struct Location
+    {
+        std::size_t body;
+        std::size_t position; // in the body's members
+    };
+
+    std::array<BodyMatrix, NUM_CELESTIAL_BODIES> m_bodies;
+    vector<Location> m_locations; // per station list index
+    std::size_t m_recomputed_rows {};
+
+    static void FillMatrix(BodyMatrix& matrix, double mu, std::size_t threads);
+    static void FillRow(BodyMatrix& matrix, double mu, std::size_t row);
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "celestial_body.hpp"
 #include "space_station.hpp"
 #include <vector>
+#include <fmt/format.h>
 
 using std::string;
 using std::vector;
@@ -14,7 +15,9 @@ class Utility {
 public:
     static string BoolToYesNo(bool input);
     static string PlanetToString(CelestialBody planet);
+    static bool StringToPlanet(const string& name, CelestialBody& planet);
     static string numberWithCommas(size_t input);
+    static void FormatWithCommas(fmt::memory_buffer& out, size_t input);
     static string PrettyFormatList(const vector<KSP_SM::CommunicationDevice>& list);
     static string PrettyFormatList(const vector<KSP_SM::DockingPort>& list);
     static void PressEnterToContinue();
@@ -0,0 +1,315 @@
+#include "include/kepler_propagator.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+using namespace KSP_SM;
+
+static constexpr double two_pi = 6.283185307179586;
+static constexpr double degrees_to_radians = two_pi / 360.0;
+
+// Newton iterations stop once every station's correction is below this many
+// radians; at the size of Jool's orbit around Kerbol that's under a metre.
+static constexpr double tolerance = 1e-12;
+static constexpr int max_iterations = 50;
+
+// Scratch columns for solving one time step, kept per thread.
+struct KeplerPropagator::Workspace
+{
+    vector<double> mean_anomaly;
+    vector<double> offset; // E - M
+    vector<double> sin_e;
+    vector<double> cos_e;
+    bool warm = false;     // offset holds the previous step's solution
+
+    explicit Workspace(std::size_t size) : mean_anomaly(size), offset(size), sin_e(size), cos_e(size) {}
+};
+
+std::size_t PositionColumns::Size() const noexcept
+{
+    return x.size();
+}
+
+void PositionColumns::Resize(std::size_t size)
+{
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+}
+
+KeplerPropagator::KeplerPropagator(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                   const vector<std::size_t>& indexes)
+{
+    for (auto index : indexes)
+    {
+        this->AddStation(*stations.at(index));
+    }
+}
+
+KeplerPropagator::KeplerPropagator(const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    for (const auto& station : stations)
+    {
+        this->AddStation(*station);
+    }
+}
+
+void KeplerPropagator::AddStation(const SpaceStation& station)
+{
+    auto orbit = station.GetOrbitalDetails();
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    double a = nan;
+    double e = nan;
+    double n = nan;
+    if (static_cast<std::size_t>(station.GetOrbitingBody()) < NUM_CELESTIAL_BODIES)
+    {
+        auto elements = OrbitalElementsEngine::Compute(orbit, station.GetOrbitingBody());
+        a = elements.semi_major_axis;
+        e = elements.eccentricity;
+        n = two_pi / elements.period;
+    }
+
+    m_ids.push_back(station.GetStationID());
+    m_mean_motion.push_back(n);
+    m_mean_anomaly.push_back(orbit.mean_anomaly * degrees_to_radians);
+    m_eccentricity.push_back(e);
+    m_semi_major_axis.push_back(a);
+    m_semi_minor_axis.push_back(a * std::sqrt(1.0 - e * e));
+
+    double cos_node = std::cos(orbit.ascending_node * degrees_to_radians);
+    double sin_node = std::sin(orbit.ascending_node * degrees_to_radians);
+    double cos_arg = std::cos(orbit.argument_of_periapsis * degrees_to_radians);
+    double sin_arg = std::sin(orbit.argument_of_periapsis * degrees_to_radians);
+    double cos_inc = std::cos(orbit.inclination * degrees_to_radians);
+    double sin_inc = std::sin(orbit.inclination * degrees_to_radians);
+
+    m_px.push_back(cos_node * cos_arg - sin_node * sin_arg * cos_inc);
+    m_py.push_back(sin_node * cos_arg + cos_node * sin_arg * cos_inc);
+    m_pz.push_back(sin_arg * sin_inc);
+    m_qx.push_back(-cos_node * sin_arg - sin_node * cos_arg * cos_inc);
+    m_qy.push_back(-sin_node * sin_arg + cos_node * cos_arg * cos_inc);
+    m_qz.push_back(cos_arg * sin_inc);
+}
+
+std::size_t KeplerPropagator::Size() const noexcept
+{
+    return m_ids.size();
+}
+
+const vector<string>& KeplerPropagator::GetStationIDs() const noexcept
+{
+    return m_ids;
+}
+
+void KeplerPropagator::Propagate(double time, PositionColumns& positions) const
+{
+    Workspace workspace(this->Size());
+    this->SolveStep(time, workspace, positions);
+}
+
+std::array<double, 3> KeplerPropagator::PositionAt(std::size_t index, double time) const
+{
+    double e = m_eccentricity.at(index);
+    double mean = m_mean_anomaly.at(index) + m_mean_motion.at(index) * time;
+    mean -= two_pi * std::floor(mean / two_pi);
+
+    double anomaly = mean + e * std::sin(mean);
+    for (int iteration = 0; iteration < max_iterations; ++iteration)
+    {
+        double correction = (anomaly - e * std::sin(anomaly) - mean) / (1.0 - e * std::cos(anomaly));
+        anomaly -= correction;
+        if (!(std::abs(correction) >= tolerance))
+        {
+            break;
+        }
+    }
+
+    double along = m_semi_major_axis[index] * (std::cos(anomaly) - e);
+    double across = m_semi_minor_axis[index] * std::sin(anomaly);
+    return {along * m_px[index] + across * m_qx[index], along * m_py[index] + across * m_qy[index],
+            along * m_pz[index] + across * m_qz[index]};
+}
+
+void KeplerPropagator::SolveStep(double time, Workspace& workspace, PositionColumns& positions) const
+{
+    const std::size_t count = this->Size();
+    positions.Resize(count);
+
+    double* __restrict mean = workspace.mean_anomaly.data();
+    double* __restrict offset = workspace.offset.data();
+    double* __restrict sin_e = workspace.sin_e.data();
+    double* __restrict cos_e = workspace.cos_e.data();
+    const double* __restrict eccentricity = m_eccentricity.data();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double m = m_mean_anomaly[i] + m_mean_motion[i] * time;
+        mean[i] = m - two_pi * std::floor(m / two_pi);
+    }
+    if (!workspace.warm)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            offset[i] = m_eccentricity[i] * std::sin(mean[i]);
+        }
+        workspace.warm = true;
+    }
+
+    // Every station gets the same number of iterations, so the loop body
+    // has no branches. Stations with NaN orbits never count as unconverged.
+    // Built with -fopenmp-simd -fno-math-errno (see CMakeLists.txt) GCC
+    // vectorizes the loop; sin and cos become one scalar sincos call per
+    // station, since glibc only declares its vector versions under
+    // -ffast-math, which would break the NaN handling.
+    for (int iteration = 0; iteration < max_iterations; ++iteration)
+    {
+        double largest = 0.0;
+#pragma omp simd reduction(max : largest)
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double e = eccentricity[i];
+            double anomaly = mean[i] + offset[i];
+            double s = std::sin(anomaly);
+            double c = std::cos(anomaly);
+            double correction = (anomaly - e * s - mean[i]) / (1.0 - e * c);
+            offset[i] -= correction;
+            sin_e[i] = s;
+            cos_e[i] = c;
+            double size = std::abs(correction);
+            largest = size > largest ? size : largest;
+        }
+        if (largest < tolerance)
+        {
+            break;
+        }
+    }
+
+    double* x = positions.x.data();
+    double* y = positions.y.data();
+    double* z = positions.z.data();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // Position in the orbital plane, then rotated into the body frame
+        double along = m_semi_major_axis[i] * (cos_e[i] - m_eccentricity[i]);
+        double across = m_semi_minor_axis[i] * sin_e[i];
+        x[i] = along * m_px[i] + across * m_qx[i];
+        y[i] = along * m_py[i] + across * m_qy[i];
+        z[i] = along * m_pz[i] + across * m_qz[i];
+    }
+}
+
+void KeplerPropagator::PropagateRange(double start, double step, std::size_t count, std::size_t threads,
+                                      const StepHandler& on_step) const
+{
+    // Steps solved per task, chosen so a task's positions take about 8 MB;
+    // each task warm starts from its own previous step.
+    constexpr std::size_t task_bytes = 8 << 20;
+    constexpr std::size_t max_steps_per_task = 64;
+    constexpr std::size_t tasks_ahead_per_thread = 2;
+
+    std::size_t step_bytes = std::max<std::size_t>(this->Size(), 1) * 3 * sizeof(double);
+    std::size_t steps_per_task = std::clamp<std::size_t>(task_bytes / step_bytes, 1, max_steps_per_task);
+
+    auto solve_steps = [this, start, step](std::size_t begin, std::size_t end) {
+        auto results = std::make_unique<vector<PositionColumns>>(end - begin);
+        Workspace workspace(this->Size());
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            this->SolveStep(start + step * static_cast<double>(i), workspace, results->at(i - begin));
+        }
+        return results;
+    };
+
+    if (threads == 1 || count <= steps_per_task)
+    {
+        for (std::size_t begin = 0; begin < count; begin += steps_per_task)
+        {
+            std::size_t end = std::min(begin + steps_per_task, count);
+            auto results = solve_steps(begin, end);
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                on_step(i, start + step * static_cast<double>(i), results->at(i - begin));
+            }
+        }
+        return;
+    }
+
+    ThreadPool pool(threads);
+    std::size_t max_in_flight = pool.GetThreadCount() * tasks_ahead_per_thread;
+    std::deque<std::future<std::unique_ptr<vector<PositionColumns>>>> in_flight;
+    std::size_t next_begin {};
+
+    auto submit_next = [&]() {
+        std::size_t begin = next_begin;
+        std::size_t end = std::min(begin + steps_per_task, count);
+        next_begin = end;
+        in_flight.push_back(pool.Submit([begin, end, &solve_steps]() { return solve_steps(begin, end); }));
+    };
+
+    while (next_begin < count && in_flight.size() < max_in_flight)
+    {
+        submit_next();
+    }
+
+    // Hand steps over in time order, topping up the window as each task's
+    // results are used
+    std::size_t first_step {};
+    while (!in_flight.empty())
+    {
+        auto results = in_flight.front().get();
+        in_flight.pop_front();
+        if (next_begin < count)
+        {
+            submit_next();
+        }
+        for (std::size_t i = 0; i < results->size(); ++i, ++first_step)
+        {
+            on_step(first_step, start + step * static_cast<double>(first_step), results->at(i));
+        }
+    }
+}
+
+void KeplerPropagator::WriteTrajectory(std::ostream& out, double start, double step, std::size_t count,
+                                       std::size_t threads) const
+{
+    // IDs are quoted once up front if they would break the CSV
+    vector<string> ids;
+    ids.reserve(m_ids.size());
+    for (const auto& id : m_ids)
+    {
+        if (id.find_first_of(",\"\n") == string::npos)
+        {
+            ids.push_back(id);
+            continue;
+        }
+        string quoted = "\"";
+        for (char c : id)
+        {
+            quoted.append(c == '"' ? "\"\"" : string(1, c == '\n' ? ' ' : c));
+        }
+        ids.push_back(quoted + "\"");
+    }
+
+    out << "time,id,x,y,z\n";
+    fmt::memory_buffer buffer;
+    auto it = std::back_inserter(buffer);
+    this->PropagateRange(start, step, count, threads, [&](std::size_t, double time, const PositionColumns& positions) {
+        buffer.clear();
+        for (std::size_t i = 0; i < positions.Size(); ++i)
+        {
+            fmt::format_to(it, "{},{},{:.1f},{:.1f},{:.1f}\n", time, ids[i], positions.x[i], positions.y[i],
+                           positions.z[i]);
+        }
+        out.write(buffer.data(), buffer.size());
+    });
+}
@@ -0,0 +1,106 @@
+#include "include/life_support.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Stations advanced together through every step: three columns of 512
+// doubles fit in L1 alongside everything else.
+static constexpr std::size_t block_size = 512;
+
+LifeSupportSimulator::LifeSupportSimulator(const vector<std::unique_ptr<SpaceStation>>& stations, double rate)
+{
+    const std::size_t size = stations.size();
+    m_supplies.resize(size);
+    m_consumption.resize(size);
+    m_dry_day.assign(size, std::numeric_limits<double>::quiet_NaN());
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        m_supplies[i] = std::max(0.0, stations[i]->GetSupplies());
+        m_consumption[i] = rate * static_cast<double>(stations[i]->GetNumberKerbalsAboard());
+        if (m_supplies[i] == 0.0 && m_consumption[i] > 0.0)
+        {
+            m_dry_day[i] = 0.0;
+        }
+    }
+}
+
+std::size_t LifeSupportSimulator::Size() const noexcept
+{
+    return m_supplies.size();
+}
+
+void LifeSupportSimulator::Advance(double days, double step_days)
+{
+    if (!(days > 0) || !(step_days > 0))
+    {
+        throw std::invalid_argument("days and step must be positive");
+    }
+
+    auto steps = static_cast<std::size_t>(std::ceil(days / step_days));
+    for (std::size_t begin = 0; begin < m_supplies.size(); begin += block_size)
+    {
+        std::size_t count = std::min(block_size, m_supplies.size() - begin);
+        double* supplies = m_supplies.data() + begin;
+        const double* consumption = m_consumption.data() + begin;
+        double* dry_day = m_dry_day.data() + begin;
+
+        for (std::size_t s = 0; s < steps;)
+        {
+            // Until a station in the block runs out, every step takes the
+            // same amount off each one, so the run of steps before that is
+            // taken in one pass. A block needs about one pass per station
+            // that runs dry rather than one per step.
+            double quiet = static_cast<double>(steps - s);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                double left = consumption[i] > 0.0 && supplies[i] > 0.0
+                                  ? std::floor(supplies[i] / (consumption[i] * step_days))
+                                  : quiet;
+                quiet = std::min(quiet, left);
+            }
+            auto run = std::max<std::size_t>(1, static_cast<std::size_t>(quiet));
+            run = std::min(run, steps - s);
+
+            double now = static_cast<double>(s) * step_days;
+            Step(supplies, consumption, dry_day, count, m_elapsed + now,
+                 std::min(static_cast<double>(run) * step_days, days - now));
+            s += run;
+        }
+    }
+    m_elapsed += days;
+}
+
+void LifeSupportSimulator::Step(double* __restrict supplies, const double* __restrict consumption,
+                                double* __restrict dry_day, std::size_t count, double now, double step)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double before = supplies[i];
+        double after = before - consumption[i] * step;
+        // Supplies run out part way through the step, when what was left
+        // has been used up. The time is worked out for every station and
+        // only kept where it applies, so there is nothing to branch on.
+        double runs_out_at = now + before / consumption[i];
+        double previous = dry_day[i];
+        bool runs_out = (before > 0.0) & (after <= 0.0);
+        dry_day[i] = runs_out ? runs_out_at : previous;
+        supplies[i] = std::max(0.0, after);
+    }
+}
+
+double LifeSupportSimulator::GetElapsedDays() const noexcept
+{
+    return m_elapsed;
+}
+
+const vector<double>& LifeSupportSimulator::GetSupplies() const noexcept
+{
+    return m_supplies;
+}
+
+const vector<double>& LifeSupportSimulator::GetDryDays() const noexcept
+{
+    return m_dry_day;
+}
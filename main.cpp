@@ -4,18 +4,39 @@
 #include <string>
 #include <cstring>
 #include <fstream>
+#include <sstream>
 #include <limits>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
 #include <ios>
 #include <cxxopts.hpp>
 
 #include <nlohmann/json.hpp>
 #include <fmt/core.h>
+#include <fmt/format.h>
 
 #include "include/space_station.hpp"
 #include "include/menu.hpp"
 #include "include/celestial_body.hpp"
 #include "include/build_vars.h"
 #include "include/station_list.hpp"
+#include "include/station_io.hpp"
+#include "include/batch_script.hpp"
+#include "include/station_server.hpp"
+#include "include/station_watcher.hpp"
+#include "include/station_diff.hpp"
+#include "include/kepler_propagator.hpp"
+#include "include/close_approach.hpp"
+#include "include/transfer_costs.hpp"
+#include "include/comms_network.hpp"
+#include "include/crew_scheduler.hpp"
+#include "include/docking_matcher.hpp"
+#include "include/life_support.hpp"
+#include "include/station_timeline.hpp"
+#include "include/utils.hpp"
+#include "include/save_importer.hpp"
+#include "include/station_transaction.hpp"
 
 using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
 using SpaceStationBuilder = KSP_SM::SpaceStationBuilder;
@@ -27,6 +48,9 @@ using namespace KSP_SM;
 using unique_station = std::unique_ptr<SpaceStation>;
 
 int main(int argc, char **argv);
+vector<std::size_t> SelectStations(StationList& stations, const cxxopts::ParseResult& result);
+std::size_t ParseTimeRange(const string& range, double& start, double& step);
+std::size_t FindStationIndex(StationList& stations, const string& id);
 
 const string STATIONS_FILENAME = "stations.json";
 
@@ -85,11 +109,56 @@ int main(int argc, char **argv)
     ("d,dump", "Dump Station Info To Text File") // Bool parameter
     ("o,outfile", "Output Filename", cxxopts::value<string>()->default_value("stations.txt"))
     ("i,infile", "Stations JSON Input Filename", cxxopts::value<string>()->default_value("stations.json"))
+    ("f,filter", "Only include stations matching a filter expression, e.g. \"active & body=kerbin & !full\"", cxxopts::value<string>())
+    ("s,sort", "Sort stations by keys, e.g. \"free:desc,name\" (name, id, capacity, free, apoapsis, body, crew, period, sma, ecc)", cxxopts::value<string>()->default_value(""))
+    ("offset", "Skip this many stations of the sorted listing", cxxopts::value<std::size_t>()->default_value("0"))
+    ("limit", "Only include the first N stations of the sorted listing", cxxopts::value<std::size_t>()->default_value("0"))
+    ("t,threads", "Worker threads used by --dump, --propagate, --approaches and --comms (0 = one per core)", cxxopts::value<std::size_t>()->default_value("1"))
+    ("e,export", "Export stations to a .csv, .tsv, .ndjson or .json file (- for NDJSON on stdout)", cxxopts::value<string>())
+    ("script", "Apply a file of batch commands (- for stdin) to the input file and save it", cxxopts::value<string>())
+    ("serve", "Load the input file and serve requests on a Unix socket")
+    ("client", "Send a request (- for one request per line of stdin) to a running server", cxxopts::value<string>())
+    ("socket", "Unix socket path for --serve and --client", cxxopts::value<string>()->default_value("ksp_station_manager.sock"))
+    ("watch", "Load stations.json and pick up changes other programs make to it (Linux)")
+    ("diff", "Compare two station files by station ID: --diff a.json b.json", cxxopts::value<vector<string>>())
+    ("validate", "Check stations when loading them: strict (refuse the file), lenient (skip bad stations), report or off", cxxopts::value<string>()->default_value("report"))
+    ("propagate", "Write station positions as CSV at a game time in seconds, or over start:end:step", cxxopts::value<string>())
+    ("approaches", "List stations around the same body passing within --within meters over start:end:step", cxxopts::value<string>())
+    ("within", "Distance in meters for --approaches", cxxopts::value<double>()->default_value("1000"))
+    ("nearest", "List the cheapest Hohmann transfers from a station to others around the same body (up to --limit, default 10)", cxxopts::value<string>())
+    ("route", "Cheapest chain of Hohmann transfers between two stations: --route FROM,TO", cxxopts::value<string>())
+    ("max-leg", "Most delta-v (m/s) any one leg of a --route may cost, 0 for no limit", cxxopts::value<double>()->default_value("0"))
+    ("comms", "Show which stations can reach Kerbin through the relay network at a game time in seconds", cxxopts::value<double>())
+    ("dsn-power", "Range rating of the Kerbin ground stations for --comms, in meters", cxxopts::value<double>()->default_value("250e9"))
+    ("rotate", "Plan crew moves meeting a file of demands (- for stdin) with as few moves as possible", cxxopts::value<string>())
+    ("rotate-cost", "What --rotate keeps down: moves or delta-v", cxxopts::value<string>()->default_value("moves"))
+    ("apply", "Carry out the --rotate plan and save the input file")
+    ("dock", "Assign a file of incoming vessels (- for stdin) to free docking ports", cxxopts::value<string>())
+    ("dock-state", "File of vessels already docked, read before --dock and updated after it", cxxopts::value<string>())
+    ("life-support", "List the stations that run out of supplies within this many game days", cxxopts::value<double>())
+    ("step", "Step size in game days for --life-support", cxxopts::value<double>()->default_value("1"))
+    ("supply-rate", "Supplies each kerbal uses per game day for --life-support", cxxopts::value<double>()->default_value(fmt::format("{}", LifeSupportSimulator::default_rate)))
+    ("timeline", "History file for --record, --fleet-at and --crew-history", cxxopts::value<string>()->default_value("stations.timeline"))
+    ("record", "Add the input file's changes to the --timeline file at a game time in seconds", cxxopts::value<double>())
+    ("fleet-at", "Show the stations recorded in the --timeline file as they were at a game time in seconds", cxxopts::value<double>())
+    ("crew-history", "List the recorded crew changes of a station ID or kerbal", cxxopts::value<string>())
+    ("import-save", "Update the input file with the station vessels of a KSP persistent.sfs save", cxxopts::value<string>())
+    ("part-map", "File of modded parts for --import-save: lines of port|comms|crew <part name> <size, device or crew>", cxxopts::value<string>())
+    ("migrate", "Rewrite the input file in the current format, converting stations saved with the old device arrays")
+    ("history", "Number of edits that can be undone in the interactive menus", cxxopts::value<std::size_t>()->default_value("100"))
     ;
+    // The second file of --diff
+    options.parse_positional({"diff"});
     
     string out_filename {};
+    std::size_t history_depth {};
+    bool watch {};
+    ValidationMode validation {};
     try{
         auto result = options.parse(argc,argv);
+        history_depth = result["history"].as<std::size_t>();
+        watch = result.count("watch") > 0;
+        validation = StationValidator::ParseMode(result["validate"].as<string>());
         
         if (result.count("dump"))
         {
@@ -100,13 +169,673 @@ int main(int argc, char **argv)
             std::cout << fmt::format("Input filename: {}\n", in_filename);
 
             StationList stations;
+            stations.SetValidation(validation);
             stations.ReadStationsFromFile(in_filename);
-            std::ofstream out_file(out_filename);
+
+            // Large stream buffer so the dump goes out in few, big writes
+            vector<char> write_buffer(1 << 20);
+            std::ofstream out_file;
+            out_file.rdbuf()->pubsetbuf(write_buffer.data(), write_buffer.size());
+            out_file.open(out_filename);
             out_file.exceptions(std::ofstream::failbit);
-            for (const auto& current : stations.GetStations())
+            stations.DumpStations(out_file, SelectStations(stations, result), result["threads"].as<std::size_t>());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("propagate"))
+        {
+            double start {};
+            double step {};
+            auto count = ParseTimeRange(result["propagate"].as<string>(), start, step);
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            KeplerPropagator propagator(stations.GetStations(), SelectStations(stations, result));
+            propagator.WriteTrajectory(std::cout, start, step, count, result["threads"].as<std::size_t>());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("approaches"))
+        {
+            double start {};
+            double step {};
+            auto count = ParseTimeRange(result["approaches"].as<string>(), start, step);
+            auto threshold = result["within"].as<double>();
+            if (!(threshold > 0))
+            {
+                throw std::invalid_argument("--within must be a positive distance");
+            }
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            auto approaches = CloseApproachFinder::Find(stations.GetStations(), SelectStations(stations, result), start,
+                                                        step, count, threshold, result["threads"].as<std::size_t>());
+            CloseApproachFinder::Print(std::cout, approaches);
+            std::cout << fmt::format("{} close approaches found.\n", approaches.size());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("nearest") || result.count("route"))
+        {
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            const auto& list = stations.GetStations();
+
+            // -f limits which stations can be transferred to or through
+            StationBitmap filter;
+            if (result.count("filter"))
+            {
+                filter = stations.Filter(result["filter"].as<string>());
+            }
+            const StationBitmap* allowed = result.count("filter") ? &filter : nullptr;
+
+            TransferCostEngine costs;
+            costs.Update(list, result["threads"].as<std::size_t>());
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+
+            if (result.count("nearest"))
+            {
+                auto from = FindStationIndex(stations, result["nearest"].as<string>());
+                auto limit = result["limit"].as<std::size_t>();
+                for (const auto& transfer : costs.Nearest(from, limit == 0 ? 10 : limit, allowed))
+                {
+                    fmt::format_to(it, "{:10.1f} m/s  {} ({})\n", transfer.delta_v,
+                                   list.at(transfer.index)->GetStationID(), list.at(transfer.index)->GetName());
+                }
+            }
+            else
+            {
+                auto ends = result["route"].as<string>();
+                auto comma = ends.find(',');
+                if (comma == string::npos)
+                {
+                    throw std::invalid_argument("--route takes FROM,TO station IDs");
+                }
+                auto from = FindStationIndex(stations, ends.substr(0, comma));
+                auto to = FindStationIndex(stations, ends.substr(comma + 1));
+                auto route = costs.CheapestRoute(from, to, result["max-leg"].as<double>(), allowed);
+                if (route.empty())
+                {
+                    std::cerr << fmt::format("No route from {} to {}.\n", ends.substr(0, comma), ends.substr(comma + 1));
+                    return EXIT_FAILURE;
+                }
+
+                double total {};
+                std::size_t previous = from;
+                for (const auto& leg : route)
+                {
+                    fmt::format_to(it, "{} -> {}: {:.1f} m/s\n", list.at(previous)->GetStationID(),
+                                   list.at(leg.index)->GetStationID(), leg.delta_v);
+                    total += leg.delta_v;
+                    previous = leg.index;
+                }
+                fmt::format_to(it, "Total: {:.1f} m/s over {} legs.\n", total, route.size());
+            }
+            std::cout.write(buffer.data(), buffer.size());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("comms"))
+        {
+            auto dsn_power = result["dsn-power"].as<double>();
+            if (!(dsn_power > 0))
+            {
+                throw std::invalid_argument("--dsn-power must be a positive range");
+            }
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            const auto& list = stations.GetStations();
+
+            CommsNetwork network;
+            network.Build(list, result["comms"].as<double>(), result["threads"].as<std::size_t>(), dsn_power);
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+            std::size_t connected {};
+            auto selected = SelectStations(stations, result);
+            for (auto index : selected)
+            {
+                fmt::format_to(it, "{}: ", list.at(index)->GetStationID());
+                if (!network.IsConnected(index))
+                {
+                    fmt::format_to(it, "no connection\n");
+                    continue;
+                }
+                ++connected;
+                auto path = network.RelayPath(index);
+                for (std::size_t hop = 1; hop < path.size(); ++hop)
+                {
+                    fmt::format_to(it, "{} -> ", list.at(path[hop])->GetStationID());
+                }
+                fmt::format_to(it, "Kerbin ({:.0f} km)\n", network.PathLength(index) / 1000);
+            }
+            fmt::format_to(it, "{} of {} stations connected to Kerbin, {} links.\n", connected, selected.size(),
+                           network.GetLinkCount());
+            std::cout.write(buffer.data(), buffer.size());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("rotate"))
+        {
+            auto cost_name = result["rotate-cost"].as<string>();
+            if (cost_name != "moves" && cost_name != "delta-v")
+            {
+                throw std::invalid_argument("--rotate-cost must be moves or delta-v");
+            }
+            auto cost = cost_name == "moves" ? CrewScheduler::Cost::MOVES : CrewScheduler::Cost::DELTA_V;
+
+            string in_filename = result["infile"].as<string>();
+            string demands_filename = result["rotate"].as<string>();
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(in_filename);
+            const auto& list = stations.GetStations();
+
+            CrewScheduler scheduler(list);
+            if (demands_filename.compare("-") == 0)
+            {
+                scheduler.ReadDemands(std::cin);
+            }
+            else
+            {
+                std::ifstream demands_file(demands_filename);
+                if (!demands_file)
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", demands_filename);
+                    return EXIT_FAILURE;
+                }
+                scheduler.ReadDemands(demands_file);
+            }
+            auto plan = scheduler.Solve(cost);
+
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+            double total {};
+            for (const auto& move : plan)
+            {
+                fmt::format_to(it, "{}: {} -> {}", move.kerbal, list.at(move.from)->GetStationID(),
+                               list.at(move.to)->GetStationID());
+                if (cost == CrewScheduler::Cost::DELTA_V)
+                {
+                    if (std::isnan(move.delta_v))
+                    {
+                        fmt::format_to(it, " (interplanetary)");
+                    }
+                    else
+                    {
+                        fmt::format_to(it, " ({:.1f} m/s)", move.delta_v);
+                        total += move.delta_v;
+                    }
+                }
+                fmt::format_to(it, "\n");
+            }
+            fmt::format_to(it, "{} moves", plan.size());
+            if (cost == CrewScheduler::Cost::DELTA_V)
+            {
+                fmt::format_to(it, ", {:.1f} m/s within bodies", total);
+            }
+            fmt::format_to(it, ".\n");
+            std::cout.write(buffer.data(), buffer.size());
+
+            if (result.count("apply"))
+            {
+                CrewScheduler::Apply(stations, plan, in_filename);
+                std::cout << fmt::format("Plan applied. {} stations saved to {}.\n", stations.GetSize(), in_filename);
+            }
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("dock"))
+        {
+            string vessels_filename = result["dock"].as<string>();
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            const auto& list = stations.GetStations();
+
+            DockingMatcher matcher(list);
+            string state_filename = result.count("dock-state") ? result["dock-state"].as<string>() : "";
+            if (!state_filename.empty())
+            {
+                // A state file that doesn't exist yet means nothing is docked
+                std::ifstream state_file(state_filename);
+                if (state_file)
+                {
+                    matcher.ReadState(state_file);
+                }
+            }
+
+            vector<IncomingVessel> vessels;
+            if (vessels_filename.compare("-") == 0)
+            {
+                vessels = DockingMatcher::ReadVessels(std::cin);
+            }
+            else
+            {
+                std::ifstream vessels_file(vessels_filename);
+                if (!vessels_file)
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", vessels_filename);
+                    return EXIT_FAILURE;
+                }
+                vessels = DockingMatcher::ReadVessels(vessels_file);
+            }
+
+            auto dockings = matcher.Schedule(vessels);
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+            for (const auto& docking : dockings)
+            {
+                fmt::format_to(it, "{}: {} ({})\n", docking.vessel, list.at(docking.station)->GetStationID(),
+                               SpaceStation::DockingPortToString(docking.port));
+            }
+            std::size_t waiting {};
+            for (const auto& vessel : vessels)
+            {
+                if (!matcher.IsDocked(vessel.name))
+                {
+                    fmt::format_to(it, "{}: waiting\n", vessel.name);
+                    ++waiting;
+                }
+            }
+            fmt::format_to(it, "{} vessels docked, {} waiting.\n", dockings.size(), waiting);
+            std::cout.write(buffer.data(), buffer.size());
+
+            if (!state_filename.empty())
+            {
+                StationIO::ReplaceFile(state_filename, [&](std::ostream& out) { matcher.WriteState(out); });
+            }
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("life-support"))
+        {
+            auto rate = result["supply-rate"].as<double>();
+            if (!(rate >= 0))
+            {
+                throw std::invalid_argument("--supply-rate can't be negative");
+            }
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+            const auto& list = stations.GetStations();
+
+            auto days = result["life-support"].as<double>();
+            LifeSupportSimulator simulator(list, rate);
+            simulator.Advance(days, result["step"].as<double>());
+
+            // Soonest first
+            const auto& dry_days = simulator.GetDryDays();
+            auto selected = SelectStations(stations, result);
+            vector<std::size_t> dry;
+            for (auto index : selected)
+            {
+                if (!std::isnan(dry_days[index]))
+                {
+                    dry.push_back(index);
+                }
+            }
+            std::stable_sort(dry.begin(), dry.end(),
+                             [&dry_days](std::size_t a, std::size_t b) { return dry_days[a] < dry_days[b]; });
+
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+            for (auto index : dry)
+            {
+                fmt::format_to(it, "{}: out of supplies on day {:.1f} ({} kerbals aboard)\n",
+                               list.at(index)->GetStationID(), dry_days[index],
+                               list.at(index)->GetNumberKerbalsAboard());
+            }
+            fmt::format_to(it, "{} of {} stations run out of supplies within {} days.\n", dry.size(), selected.size(),
+                           days);
+            std::cout.write(buffer.data(), buffer.size());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("record") || result.count("fleet-at") || result.count("crew-history"))
+        {
+            string timeline_filename = result["timeline"].as<string>();
+            StationTimeline timeline;
+            {
+                // A timeline that doesn't exist yet has nothing recorded
+                std::ifstream timeline_file(timeline_filename, std::ios::binary);
+                if (timeline_file)
+                {
+                    timeline.Read(timeline_file);
+                }
+                else if (!result.count("record"))
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", timeline_filename);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            fmt::memory_buffer buffer;
+            auto it = std::back_inserter(buffer);
+            if (result.count("record"))
+            {
+                StationList stations;
+                stations.SetValidation(validation);
+                stations.ReadStationsFromFile(result["infile"].as<string>());
+                auto time = result["record"].as<double>();
+                std::size_t before = timeline.GetEventCount();
+                timeline.Record(time, stations.GetStations());
+
+                // Replaced in one rename, so a failed write can't lose the
+                // history recorded so far
+                StationIO::ReplaceFile(timeline_filename, [&](std::ostream& out) { timeline.Write(out); });
+                fmt::format_to(it, "Recorded {} changes at {}s; {} holds {} changes in {} bytes.\n",
+                               timeline.GetEventCount() - before, time, timeline_filename, timeline.GetEventCount(),
+                               timeline.GetEncodedSize());
+            }
+
+            if (result.count("fleet-at"))
+            {
+                auto time = result["fleet-at"].as<double>();
+                auto fleet = timeline.FleetAt(time);
+                for (const auto& station : fleet)
+                {
+                    fmt::format_to(it, "{}: {} {}x{} m, {}/{} crew{}", station.id, Utility::PlanetToString(station.body),
+                                   station.orbit.apoapsis, station.orbit.periapsis, station.crew.size(),
+                                   station.capacity, station.active ? "" : ", inactive");
+                    for (std::size_t i = 0; i < station.crew.size(); ++i)
+                    {
+                        fmt::format_to(it, "{}{}", i == 0 ? " (" : ", ", station.crew[i]);
+                    }
+                    fmt::format_to(it, "{}\n", station.crew.empty() ? "" : ")");
+                }
+                fmt::format_to(it, "{} stations at {}s.\n", fleet.size(), time);
+            }
+
+            if (result.count("crew-history"))
+            {
+                // A station ID if one was recorded, otherwise a kerbal
+                string name = result["crew-history"].as<string>();
+                constexpr double forever = std::numeric_limits<double>::infinity();
+                bool station = timeline.HasStation(name);
+                auto records = station ? timeline.StationCrewHistory(name, -forever, forever)
+                                       : timeline.KerbalHistory(name, -forever, forever);
+                for (const auto& record : records)
+                {
+                    fmt::format_to(it, "{:>12.1f}s  {} {} {}\n", record.time, record.kerbal,
+                                   record.boarded ? "boarded" : "left", record.station_id);
+                }
+                fmt::format_to(it, "{} crew changes for {}.\n", records.size(), name);
+            }
+            std::cout.write(buffer.data(), buffer.size());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("import-save"))
+        {
+            SaveImporter importer;
+            if (result.count("part-map"))
+            {
+                string map_filename = result["part-map"].as<string>();
+                std::ifstream map_file(map_filename);
+                if (!map_file)
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", map_filename);
+                    return EXIT_FAILURE;
+                }
+                importer.ReadPartMap(map_file);
+            }
+
+            string save_filename = result["import-save"].as<string>();
+            std::ifstream save_file(save_filename);
+            if (!save_file)
+            {
+                std::cerr << fmt::format("Error: {} not found.\n", save_filename);
+                return EXIT_FAILURE;
+            }
+
+            // Stations already in the input file are replaced by the vessel
+            // with the same ID; the rest of the file is kept
+            string in_filename = result["infile"].as<string>();
+            StationList stations;
+            stations.SetValidation(validation);
+            if (std::ifstream(in_filename))
+            {
+                stations.ReadStationsFromFile(in_filename);
+            }
+            std::unordered_map<string, std::size_t> id_to_index;
+            for (std::size_t i = 0; i < stations.GetStations().size(); ++i)
+            {
+                id_to_index.emplace(stations.GetStations()[i]->GetStationID(), i);
+            }
+
+            StationTransaction transaction(stations);
+            std::size_t updated {};
+            std::size_t skipped {};
+            auto imported = importer.ReadSave(
+                save_file,
+                [&](std::unique_ptr<SpaceStation> station) {
+                    auto it = id_to_index.find(station->GetStationID());
+                    if (it != id_to_index.end())
+                    {
+                        transaction.ReplaceStation(it->second, std::move(station));
+                        ++updated;
+                    }
+                    else
+                    {
+                        transaction.AddStation(std::move(station));
+                    }
+                },
+                &skipped);
+            transaction.Commit(in_filename);
+
+            std::cout << fmt::format("Imported {} stations from {} ({} updated, {} new).\n", imported, save_filename,
+                                     updated, imported - updated);
+            if (skipped > 0)
+            {
+                std::cout << fmt::format("{} stations skipped: not in a closed orbit around a known body.\n",
+                                         skipped);
+            }
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("serve"))
+        {
+            string in_filename = result["infile"].as<string>();
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(in_filename);
+            StationServer server(stations, in_filename, result["socket"].as<string>());
+            return server.Run();
+        }
+
+        if (result.count("client"))
+        {
+            string request = result["client"].as<string>();
+            if (request.compare("-") == 0)
+            {
+                return StationServer::RunClient(result["socket"].as<string>(), std::cin);
+            }
+            std::istringstream single_request(request);
+            return StationServer::RunClient(result["socket"].as<string>(), single_request);
+        }
+
+        if (result.count("diff"))
+        {
+            auto files = result["diff"].as<vector<string>>();
+            if (files.size() != 2)
+            {
+                std::cerr << "Error: --diff needs two station files.\n";
+                return EXIT_FAILURE;
+            }
+
+            StationList before;
+            StationList after;
+            before.SetValidation(validation);
+            after.SetValidation(validation);
+            for (const auto& file : files)
+            {
+                if (!std::ifstream(file))
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", file);
+                    return EXIT_FAILURE;
+                }
+            }
+            before.ReadStationsFromFile(files.at(0));
+            after.ReadStationsFromFile(files.at(1));
+
+            auto differences = StationDiff::Compare(before.GetStations(), after.GetStations());
+            StationDiff::Print(std::cout, differences);
+
+            std::size_t added {};
+            std::size_t removed {};
+            for (const auto& difference : differences)
+            {
+                added += difference.kind == StationDiff::Kind::ADDED;
+                removed += difference.kind == StationDiff::Kind::REMOVED;
+            }
+            std::cout << fmt::format("{} added, {} removed, {} modified.\n", added, removed,
+                                     differences.size() - added - removed);
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("migrate"))
+        {
+            string in_filename = result["infile"].as<string>();
+            if (in_filename.compare("-") != 0 && !std::ifstream(in_filename))
             {
-                out_file << current->ToString();
+                std::cerr << fmt::format("Error: {} not found.\n", in_filename);
+                return EXIT_FAILURE;
             }
+
+            // Lenient loading drops bad stations, and the rewrite would make
+            // that permanent
+            if (validation == ValidationMode::LENIENT)
+            {
+                throw std::invalid_argument("--migrate can't be used with --validate lenient");
+            }
+
+            StationList stations;
+            stations.SetValidation(validation);
+            auto num_stations = stations.ReadStationsFromFile(in_filename);
+            stations.WriteStationsToFile(in_filename);
+            std::cerr << fmt::format("Rewrote {} stations, {} converted from the legacy layout.\n", num_stations,
+                                     stations.GetLegacyCount());
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("script"))
+        {
+            string in_filename = result["infile"].as<string>();
+            string script_filename = result["script"].as<string>();
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(in_filename);
+            BatchScript script(stations);
+
+            std::size_t errors {};
+            if (script_filename.compare("-") == 0)
+            {
+                errors = script.Run(std::cin);
+            }
+            else
+            {
+                std::ifstream script_file(script_filename);
+                if (!script_file)
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", script_filename);
+                    return EXIT_FAILURE;
+                }
+                errors = script.Run(script_file);
+            }
+
+            // Nothing is saved unless every command succeeded
+            if (errors)
+            {
+                std::cerr << fmt::format("{} commands failed. {} was not modified.\n", errors, in_filename);
+                return EXIT_FAILURE;
+            }
+
+            stations.WriteStationsToFile(in_filename);
+            std::cout << fmt::format("Applied {} commands. {} stations saved to {}.\n",
+                                     script.GetCommandsApplied(), stations.GetSize(), in_filename);
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("export"))
+        {
+            string in_filename = result["infile"].as<string>();
+            out_filename = result["export"].as<string>();
+            auto in_format = in_filename.compare("-") == 0 ? StationFormat::NDJSON : StationIO::FormatFromFilename(in_filename);
+            auto out_format = out_filename.compare("-") == 0 ? StationFormat::NDJSON : StationIO::FormatFromFilename(out_filename);
+            bool selecting = result.count("filter") || result.count("offset") || result.count("limit") ||
+                !result["sort"].as<string>().empty();
+
+            std::ifstream in_file;
+            std::istream* in = &std::cin;
+            if (in_filename.compare("-") != 0)
+            {
+                in_file.open(in_filename);
+                if (!in_file)
+                {
+                    std::cerr << fmt::format("Error: {} not found.\n", in_filename);
+                    return EXIT_FAILURE;
+                }
+                in = &in_file;
+            }
+
+            std::ofstream out_file;
+            std::ostream* out = &std::cout;
+            if (out_filename.compare("-") != 0)
+            {
+                out_file.open(out_filename);
+                out_file.exceptions(std::ofstream::failbit);
+                out = &out_file;
+            }
+
+            // Line format to line format streams straight through without
+            // loading the whole fleet.
+            if (!selecting && StationIO::IsLineFormat(in_format) && StationIO::IsLineFormat(out_format))
+            {
+                StationIO::Convert(*in, in_format, *out, out_format);
+                return EXIT_SUCCESS;
+            }
+
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStations(*in, in_format);
+            auto selected = SelectStations(stations, result);
+
+            if (out_format == StationFormat::JSON)
+            {
+                json stations_json = json::array();
+                for (auto index : selected)
+                {
+                    stations_json.push_back(stations.GetStations().at(index));
+                }
+                *out << stations_json.dump(4) << std::endl;
+                return EXIT_SUCCESS;
+            }
+
+            stations.WriteStations(*out, out_format, selected);
+            return EXIT_SUCCESS;
+        }
+
+        if (result.count("filter"))
+        {
+            // Print the stations matching the filter without entering the menu
+            StationList stations;
+            stations.SetValidation(validation);
+            stations.ReadStationsFromFile(result["infile"].as<string>());
+
+            for (auto index : SelectStations(stations, result))
+            {
+                const auto& station = stations.GetStations().at(index);
+                std::cout << fmt::format("{}) {} - {}\n", index, station->GetStationID(), station->GetName());
+            }
+            std::cout << fmt::format("{} of {} stations matched.\n", stations.Filter(result["filter"].as<string>()).Count(), stations.GetSize());
             return EXIT_SUCCESS;
         }
     } catch (const cxxopts::exceptions::parsing& e)
@@ -114,10 +843,18 @@ int main(int argc, char **argv)
         std::cerr << "Caught\n";
         std::cerr << fmt::format("Error: {}\n", e.what());
         return EXIT_FAILURE;
+    } catch (const std::invalid_argument& e)
+    {
+        std::cerr << fmt::format("Invalid option value: {}\n", e.what());
+        return EXIT_FAILURE;
     } catch (std::ofstream::failure& e)
     {
         std::cerr << fmt::format("Error opening file: {} for writing. Aborting.\n", out_filename);
         return EXIT_FAILURE;
+    } catch (const std::runtime_error& e)
+    {
+        std::cerr << fmt::format("Error: {}\n", e.what());
+        return EXIT_FAILURE;
     }
 
     
@@ -125,6 +862,8 @@ int main(int argc, char **argv)
    
 
     StationList stations;
+    stations.SetValidation(validation);
+    stations.SetHistoryDepth(history_depth);
     bool exitProgram = false;
     std::string buffer;
     std::string menuText = Menu::GetMainMenuText();
@@ -132,8 +871,40 @@ int main(int argc, char **argv)
     std::cout << "KSP Station Manger\n";
     std::cout << fmt::format("Verson: {}.{}\n", KSP_SM_VERSION_MAJOR, KSP_SM_VERSION_MINOR);
 
+    StationWatcher watcher(STATIONS_FILENAME);
+    if (watch)
+    {
+        try {
+            if (!watcher.Start(stations))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << fmt::format("Error reading stations: {}\n", e.what());
+            return EXIT_FAILURE;
+        }
+        std::cout << fmt::format("Watching {} for changes. Read in {} stations.\n", STATIONS_FILENAME, stations.GetSize());
+    }
+
     while (!exitProgram)
     {
+        // Changes to the file are picked up each time the main menu is shown
+        if (watcher.HasChanges())
+        {
+            try {
+                auto changed = watcher.ApplyChanges(stations);
+                if (changed)
+                {
+                    std::cout << fmt::format("\nReloaded {} changed stations from {}.\n", changed, STATIONS_FILENAME);
+                }
+            }
+            catch (const std::runtime_error& e)
+            {
+                std::cerr << fmt::format("\nError: {}\n", e.what());
+            }
+        }
 
         std::cout << std::endl;
         std::cout << menuText;
@@ -147,7 +918,14 @@ int main(int argc, char **argv)
         if (selection == 'r')
         {
             // Attempt to read stations from file. Result is the number of stations read from json file.
-            auto number_of_stations = stations.ReadStationsFromFile(STATIONS_FILENAME);
+            std::size_t number_of_stations {};
+            try {
+                number_of_stations = stations.ReadStationsFromFile(STATIONS_FILENAME);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << fmt::format("Error reading stations: {}\n", e.what());
+            }
             if (!number_of_stations) // Show an error if no stations are found / file not found.
             {
                 std::cerr << "Aborting." << std::endl;
@@ -159,7 +937,14 @@ int main(int argc, char **argv)
         }
         if (selection == 'w')
         {
-            stations.WriteStationsToFile(STATIONS_FILENAME);
+            try {
+                stations.WriteStationsToFile(STATIONS_FILENAME);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << fmt::format("Error writing stations: {}\n", e.what());
+                continue;
+            }
 
             std::cout << "Wrote stations list to file." << std::endl
                       << std::endl;
@@ -200,7 +985,7 @@ int main(int argc, char **argv)
 
         if (selection == 'l')
         {
-            stations.ListAllStations();
+            stations.ListStationsFromConsole();
             continue;
         }
 
@@ -209,6 +994,16 @@ int main(int argc, char **argv)
             stations.ManageStationsFromConsole();
             continue;
         }
+        if (selection == 'u')
+        {
+            std::cout << (stations.Undo() ? "Undid last change." : "Nothing to undo.") << std::endl;
+            continue;
+        }
+        if (selection == 'y')
+        {
+            std::cout << (stations.Redo() ? "Redid last change." : "Nothing to redo.") << std::endl;
+            continue;
+        }
         if (selection == 'q')
         {
             exitProgram = true;
@@ -220,3 +1015,78 @@ int main(int argc, char **argv)
 
     return 0;
 }
+
+// Applies the --filter, --sort, --offset and --limit options and returns the
+// indexes of the selected stations in listing order.
+vector<std::size_t> SelectStations(StationList& stations, const cxxopts::ParseResult& result)
+{
+    auto spec = StationOrder::ParseSortSpec(result["sort"].as<string>());
+    auto offset = result["offset"].as<std::size_t>();
+    auto limit = result["limit"].as<std::size_t>();
+    if (limit == 0)
+    {
+        limit = stations.GetSize();
+    }
+
+    if (result.count("filter"))
+    {
+        auto selected = stations.Filter(result["filter"].as<string>());
+        return stations.GetSortedPage(spec, offset, limit, &selected);
+    }
+
+    return stations.GetSortedPage(spec, offset, limit);
+}
+
+// Parses "time" or "start:end:step" (game seconds) and returns the number of
+// steps. Throws std::invalid_argument if the range is malformed.
+std::size_t ParseTimeRange(const string& range, double& start, double& step)
+{
+    vector<double> values;
+    std::stringstream in(range);
+    string field;
+    while (std::getline(in, field, ':'))
+    {
+        std::size_t used {};
+        try {
+            values.push_back(std::stod(field, &used));
+        }
+        catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != field.size())
+        {
+            throw std::invalid_argument(fmt::format("'{}' is not a time in seconds", field));
+        }
+    }
+
+    if (values.size() == 1)
+    {
+        start = values.at(0);
+        step = 0;
+        return 1;
+    }
+    if (values.size() != 3 || values.at(2) <= 0 || values.at(1) < values.at(0))
+    {
+        throw std::invalid_argument(fmt::format("expected start:end:step with start <= end and step > 0, not '{}'",
+                                                range));
+    }
+
+    start = values.at(0);
+    step = values.at(2);
+    // The small slack keeps end in the range when step doesn't divide it exactly in binary
+    return static_cast<std::size_t>((values.at(1) - start) / step + 1e-9) + 1;
+}
+
+// Throws std::invalid_argument if no station has the ID.
+std::size_t FindStationIndex(StationList& stations, const string& id)
+{
+    const auto& list = stations.GetStations();
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        if (list.at(i)->GetStationID() == id)
+        {
+            return i;
+        }
+    }
+    throw std::invalid_argument(fmt::format("no station has the ID '{}'", id));
+}
@@ -13,6 +13,8 @@ string Menu::GetMainMenuText()
     ss << "M -> Manage Station" << std::endl;
     ss << "D -> Delete Station" << std::endl;
     ss << "L -> List All Stations" << std::endl;
+    ss << "U -> Undo Last Change" << std::endl;
+    ss << "Y -> Redo Last Undone Change" << std::endl;
     ss << "Q -> Quit" << std::endl << std::endl;
 
     return ss.str();
@@ -26,6 +28,8 @@ string Menu::GetMangeStationMenuText()
     ss << "A -> Add Kerbal\n";
     ss << "R -> Remove Kerbal\n";
     ss << "E -> Edit Capacity\n";
+    ss << "U -> Undo Last Change\n";
+    ss << "Y -> Redo Last Undone Change\n";
     ss << "F -> Finish Managing Stations\n\n";
     ss << "Enter Your Selection: ";
 
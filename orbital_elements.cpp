@@ -0,0 +1,214 @@
+#include "include/orbital_elements.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+using namespace KSP_SM;
+
+// Stock game values, in CelestialBody order.
+static constexpr std::array<BodyConstants, NUM_CELESTIAL_BODIES> body_constants = {{
+    {1.1723328e18, 261600000.0, CelestialBody::KERBOL, 0.0, 0.0},          // Kerbol
+    {1.6860938e11, 250000.0, CelestialBody::KERBOL, 5263138304.0, 3.14},   // Moho
+    {8.1717302e12, 700000.0, CelestialBody::KERBOL, 9832684544.0, 3.14},   // Eve
+    {8.2894498e6, 13000.0, CelestialBody::EVE, 31500000.0, 0.9},           // Gilly
+    {3.5316000e12, 600000.0, CelestialBody::KERBOL, 13599840256.0, 3.14},  // Kerbin
+    {6.5138398e10, 200000.0, CelestialBody::KERBIN, 12000000.0, 1.7},      // Mun
+    {1.7658000e9, 60000.0, CelestialBody::KERBIN, 47000000.0, 0.9},        // Minmus
+    {3.0136321e11, 320000.0, CelestialBody::KERBOL, 20726155264.0, 3.14},  // Duna
+    {1.8568369e10, 130000.0, CelestialBody::DUNA, 3200000.0, 1.7},         // Ike
+    {2.1484489e10, 138000.0, CelestialBody::KERBOL, 40839348203.0, 3.14},  // Dres
+    {2.8252800e14, 6000000.0, CelestialBody::KERBOL, 68773560320.0, 0.1},  // Jool
+    {1.9620000e12, 500000.0, CelestialBody::JOOL, 27184000.0, 3.14},       // Laythe
+    {2.0748150e11, 300000.0, CelestialBody::JOOL, 43152000.0, 0.9},        // Vall
+    {2.8252800e12, 600000.0, CelestialBody::JOOL, 68500000.0, 3.14},       // Tylo
+    {2.4868349e9, 65000.0, CelestialBody::JOOL, 128500000.0, 0.9},         // Bop
+    {7.2170208e8, 44000.0, CelestialBody::JOOL, 179890000.0, 0.9},         // Pol
+    {7.4410815e10, 210000.0, CelestialBody::KERBOL, 90118820000.0, 3.14}   // Eeloo
+}};
+
+// Stations gathered per block by ComputeAll; small enough for the inputs to
+// stay in L1 while the kernel runs over them.
+static constexpr std::size_t block_size = 512;
+
+std::size_t OrbitalElementColumns::Size() const noexcept
+{
+    return semi_major_axis.size();
+}
+
+void OrbitalElementColumns::Resize(std::size_t size)
+{
+    semi_major_axis.resize(size);
+    eccentricity.resize(size);
+    period.resize(size);
+    apoapsis_speed.resize(size);
+    periapsis_speed.resize(size);
+}
+
+OrbitalElements OrbitalElementColumns::Get(std::size_t index) const
+{
+    return OrbitalElements {semi_major_axis.at(index), eccentricity.at(index), period.at(index),
+                            apoapsis_speed.at(index), periapsis_speed.at(index)};
+}
+
+void OrbitalElementColumns::Set(std::size_t index, const OrbitalElements& elements)
+{
+    semi_major_axis.at(index) = elements.semi_major_axis;
+    eccentricity.at(index) = elements.eccentricity;
+    period.at(index) = elements.period;
+    apoapsis_speed.at(index) = elements.apoapsis_speed;
+    periapsis_speed.at(index) = elements.periapsis_speed;
+}
+
+void OrbitalElementColumns::Insert(std::size_t index, const OrbitalElements& elements)
+{
+    semi_major_axis.insert(semi_major_axis.begin() + index, elements.semi_major_axis);
+    eccentricity.insert(eccentricity.begin() + index, elements.eccentricity);
+    period.insert(period.begin() + index, elements.period);
+    apoapsis_speed.insert(apoapsis_speed.begin() + index, elements.apoapsis_speed);
+    periapsis_speed.insert(periapsis_speed.begin() + index, elements.periapsis_speed);
+}
+
+void OrbitalElementColumns::Erase(std::size_t index)
+{
+    semi_major_axis.erase(semi_major_axis.begin() + index);
+    eccentricity.erase(eccentricity.begin() + index);
+    period.erase(period.begin() + index);
+    apoapsis_speed.erase(apoapsis_speed.begin() + index);
+    periapsis_speed.erase(periapsis_speed.begin() + index);
+}
+
+void OrbitalElementColumns::Clear() noexcept
+{
+    semi_major_axis.clear();
+    eccentricity.clear();
+    period.clear();
+    apoapsis_speed.clear();
+    periapsis_speed.clear();
+}
+
+const BodyConstants& OrbitalElementsEngine::GetBodyConstants(CelestialBody body)
+{
+    return body_constants.at(static_cast<std::size_t>(body));
+}
+
+std::array<double, 3> OrbitalElementsEngine::BodyPosition(CelestialBody body, double time)
+{
+    std::array<double, 3> position {0.0, 0.0, 0.0};
+    for (auto current = body; current != CelestialBody::KERBOL;)
+    {
+        const auto& constants = GetBodyConstants(current);
+        const auto& parent = GetBodyConstants(constants.parent);
+        double mean_motion = std::sqrt(parent.gravitational_parameter / std::pow(constants.orbit_radius, 3));
+        double angle = constants.mean_anomaly + mean_motion * time;
+        position[0] += constants.orbit_radius * std::cos(angle);
+        position[1] += constants.orbit_radius * std::sin(angle);
+        current = constants.parent;
+    }
+    return position;
+}
+
+OrbitalElements OrbitalElementsEngine::Compute(const OrbitalParameters& orbit, CelestialBody body)
+{
+    const auto& constants = GetBodyConstants(body);
+    double apoapsis = static_cast<double>(std::max(orbit.apoapsis, orbit.periapsis)) + constants.radius;
+    double periapsis = static_cast<double>(std::min(orbit.apoapsis, orbit.periapsis)) + constants.radius;
+
+    OrbitalElementColumns columns;
+    columns.Resize(1);
+    ComputeColumns(&apoapsis, &periapsis, &constants.gravitational_parameter, 1, columns, 0);
+    return columns.Get(0);
+}
+
+OrbitalElements OrbitalElementsEngine::Compute(const SpaceStation& station)
+{
+    return Compute(station.GetOrbitalDetails(), station.GetOrbitingBody());
+}
+
+void OrbitalElementsEngine::ComputeAll(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                       OrbitalElementColumns& columns)
+{
+    columns.Resize(stations.size());
+
+    std::array<double, block_size> apoapsis;
+    std::array<double, block_size> periapsis;
+    std::array<double, block_size> mu;
+    for (std::size_t begin = 0; begin < stations.size(); begin += block_size)
+    {
+        std::size_t count = std::min(block_size, stations.size() - begin);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto& station = *stations[begin + i];
+            auto orbit = station.GetOrbitalDetails();
+            auto body = static_cast<std::size_t>(station.GetOrbitingBody());
+
+            // An unknown body poisons the results rather than stopping the batch
+            BodyConstants constants {std::numeric_limits<double>::quiet_NaN(), 0.0, CelestialBody::KERBOL, 0.0, 0.0};
+            if (body < NUM_CELESTIAL_BODIES)
+            {
+                constants = body_constants[body];
+            }
+            apoapsis[i] = static_cast<double>(std::max(orbit.apoapsis, orbit.periapsis)) + constants.radius;
+            periapsis[i] = static_cast<double>(std::min(orbit.apoapsis, orbit.periapsis)) + constants.radius;
+            mu[i] = constants.gravitational_parameter;
+        }
+        ComputeColumns(apoapsis.data(), periapsis.data(), mu.data(), count, columns, begin);
+    }
+}
+
+void OrbitalElementsEngine::ComputeColumns(const double* __restrict apoapsis_radius,
+                                           const double* __restrict periapsis_radius, const double* __restrict mu,
+                                           std::size_t count, OrbitalElementColumns& columns, std::size_t offset)
+{
+    constexpr double two_pi = 6.283185307179586;
+
+    // The columns never alias each other or the inputs; saying so lets the
+    // compiler keep the loop in vector registers
+    double* __restrict semi_major_axis = columns.semi_major_axis.data() + offset;
+    double* __restrict eccentricity = columns.eccentricity.data() + offset;
+    double* __restrict period = columns.period.data() + offset;
+    double* __restrict apoapsis_speed = columns.apoapsis_speed.data() + offset;
+    double* __restrict periapsis_speed = columns.periapsis_speed.data() + offset;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double ra = apoapsis_radius[i];
+        double rp = periapsis_radius[i];
+        double a = 0.5 * (ra + rp);
+
+        semi_major_axis[i] = a;
+        eccentricity[i] = (ra - rp) / (ra + rp);
+        period[i] = two_pi * std::sqrt(a * a * a / mu[i]);
+        // Vis-viva equation
+        apoapsis_speed[i] = std::sqrt(mu[i] * (2.0 / ra - 1.0 / a));
+        periapsis_speed[i] = std::sqrt(mu[i] * (2.0 / rp - 1.0 / a));
+    }
+}
+
+void OrbitalElementsEngine::FormatDuration(fmt::memory_buffer& out, double seconds)
+{
+    auto it = std::back_inserter(out);
+    if (!std::isfinite(seconds) || seconds < 0)
+    {
+        fmt::format_to(it, "unknown");
+        return;
+    }
+
+    auto total = static_cast<unsigned long long>(std::llround(seconds));
+    auto hours = total / 3600;
+    auto minutes = total / 60 % 60;
+    if (hours > 0)
+    {
+        fmt::format_to(it, "{}h {}m {}s", hours, minutes, total % 60);
+    }
+    else if (minutes > 0)
+    {
+        fmt::format_to(it, "{}m {}s", minutes, total % 60);
+    }
+    else
+    {
+        fmt::format_to(it, "{}s", total % 60);
+    }
+}
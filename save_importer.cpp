@@ -0,0 +1,458 @@
+#include "include/save_importer.hpp"
+#include "include/batch_script.hpp"
+#include "include/orbital_elements.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+using namespace KSP_SM;
+using std::vector;
+
+static constexpr double two_pi = 6.283185307179586;
+static constexpr double radians_to_degrees = 360.0 / two_pi;
+
+// Bodies in the order of an ORBIT's REF, the index KSP gives each body
+static constexpr std::array<CelestialBody, NUM_CELESTIAL_BODIES> ref_bodies = {
+    CelestialBody::KERBOL, CelestialBody::KERBIN, CelestialBody::MUN,   CelestialBody::MINMUS, CelestialBody::MOHO,
+    CelestialBody::EVE,    CelestialBody::DUNA,   CelestialBody::IKE,   CelestialBody::JOOL,   CelestialBody::LAYTHE,
+    CelestialBody::VALL,   CelestialBody::BOP,    CelestialBody::TYLO,  CelestialBody::GILLY,  CelestialBody::POL,
+    CelestialBody::DRES,   CelestialBody::ELOO};
+
+static const char* port_names[NUM_DOCKING_PORTS] = {"xs", "sm", "md", "lg", "xl"};
+static const char* comms_names[NUM_COMM_DEVICES] = {"c16", "c16s", "c8888", "cdts", "hg5",
+                                                    "hg55", "ra15", "ra2", "ra100"};
+
+namespace
+{
+// The vessel being read, with its part and resource being read
+struct Vessel
+{
+    string name;
+    string type;
+    string persistent_id;
+    string pid;
+    bool has_orbit = false;
+    double semi_major_axis {};
+    double eccentricity {};
+    double inclination {};
+    double ascending_node {};
+    double argument_of_periapsis {};
+    double mean_anomaly {}; // rad, at epoch
+    double epoch {};
+    std::size_t ref = NUM_CELESTIAL_BODIES;
+    vector<string> crew;
+    std::array<std::size_t, NUM_DOCKING_PORTS> ports {};
+    std::array<std::size_t, NUM_COMM_DEVICES> comms {};
+    std::size_t capacity {};
+    double supplies {};
+
+    string part_name;
+    string resource_name;
+    double resource_amount {};
+};
+
+std::string_view Trim(std::string_view text)
+{
+    auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+    auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+template <typename T>
+T ReadNumber(std::string_view key, std::string_view value)
+{
+    T number {};
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc() || end != value.data() + value.size() || value.empty())
+    {
+        throw std::runtime_error(fmt::format("{} = {} isn't a number", key, value));
+    }
+    return number;
+}
+} // namespace
+
+SaveImporter::SaveImporter()
+{
+    // Stock parts by the names they have in a save
+    const std::pair<const char*, std::size_t> crew_parts[] = {
+        {"mk1pod", 1},           {"mk1pod.v2", 1},          {"Mark1-2Pod", 3},       {"mk1-3pod", 3},
+        {"Mk2Pod", 2},           {"landerCabinSmall", 1},   {"mk2LanderCabin", 2},   {"mk2LanderCabin.v2", 2},
+        {"cupola", 1},           {"crewCabin", 4},          {"MK1CrewCabin", 2},     {"mk2CrewCabin", 2},
+        {"mk3CrewCabin", 16},    {"Large.Crewed.Lab", 2},   {"Mark1Cockpit", 1},     {"Mark2Cockpit", 1},
+        {"mk2Cockpit.Standard", 2}, {"mk2Cockpit.Inline", 2}, {"mk3Cockpit.Shuttle", 4}, {"seatExternalCmd", 1},
+        {"MEMLander", 3},        {"kv1Pod", 1},             {"kv2Pod", 2},           {"kv3Pod", 3}};
+    for (const auto& [name, crew] : crew_parts)
+    {
+        SetPart(name, {crew, {}, {}});
+    }
+
+    const std::pair<const char*, DockingPort> ports[] = {
+        {"dockingPort3", DockingPort::XSMALL},      {"dockingPort2", DockingPort::SMALL},
+        {"dockingPort1", DockingPort::SMALL},       {"dockingPortLateral", DockingPort::SMALL},
+        {"mk2DockingPort", DockingPort::SMALL},     {"dockingPortLarge", DockingPort::LARGE}};
+    for (const auto& [name, port] : ports)
+    {
+        SetPart(name, {0, port, {}});
+    }
+
+    const std::pair<const char*, CommunicationDevice> antennas[] = {
+        {"longAntenna", CommunicationDevice::COMM_16},          {"SurfAntenna", CommunicationDevice::COMM_16S},
+        {"commDish", CommunicationDevice::COMM_88_88},          {"HighGainAntenna", CommunicationDevice::COMM_DTS_M1},
+        {"HighGainAntenna5", CommunicationDevice::COMM_HG_5},   {"HighGainAntenna5.v2", CommunicationDevice::COMM_HG_5},
+        {"mediumDishAntenna", CommunicationDevice::COMM_HG_55}, {"RelayAntenna50", CommunicationDevice::RA_15},
+        {"RelayAntenna5", CommunicationDevice::RA_2},           {"RelayAntenna100", CommunicationDevice::RA_100}};
+    for (const auto& [name, device] : antennas)
+    {
+        SetPart(name, {0, {}, device});
+    }
+}
+
+void SaveImporter::ReadPartMap(std::istream& in)
+{
+    string line;
+    std::size_t line_number {};
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        try {
+            std::string_view text = line;
+            auto kind = BatchScript::NextToken(text);
+            if (kind.empty() || kind.front() == '#')
+            {
+                continue;
+            }
+
+            auto name = string(BatchScript::NextToken(text));
+            auto value = BatchScript::NextToken(text);
+            if (name.empty() || value.empty() || !BatchScript::NextToken(text).empty())
+            {
+                throw std::invalid_argument("wrong number of arguments");
+            }
+
+            // Lines for the same part add up, so a part can carry crew and a port
+            const PartInfo* known = FindPart(name);
+            PartInfo info = known ? *known : PartInfo {};
+            if (kind == "crew")
+            {
+                info.crew = ReadNumber<std::size_t>(kind, value);
+            }
+            else if (kind == "port")
+            {
+                auto it = std::find(std::begin(port_names), std::end(port_names), value);
+                if (it == std::end(port_names))
+                {
+                    throw std::invalid_argument(fmt::format("unknown port size {}", value));
+                }
+                info.port = static_cast<DockingPort>(it - std::begin(port_names));
+            }
+            else if (kind == "comms")
+            {
+                auto it = std::find(std::begin(comms_names), std::end(comms_names), value);
+                if (it == std::end(comms_names))
+                {
+                    throw std::invalid_argument(fmt::format("unknown comms device {}", value));
+                }
+                info.comms = static_cast<CommunicationDevice>(it - std::begin(comms_names));
+            }
+            else
+            {
+                throw std::invalid_argument(fmt::format("unknown part kind {}", kind));
+            }
+            SetPart(name, info);
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("line {}: {}", line_number, e.what()));
+        }
+    }
+}
+
+void SaveImporter::SetPart(const string& name, const PartInfo& info)
+{
+    m_parts[PartKey(name)] = info;
+}
+
+const SaveImporter::PartInfo* SaveImporter::FindPart(const string& name) const
+{
+    auto it = m_parts.find(PartKey(name));
+    return it == m_parts.end() ? nullptr : &it->second;
+}
+
+std::size_t SaveImporter::ReadSave(std::istream& in, const StationHandler& on_station, std::size_t* skipped) const
+{
+    constexpr std::size_t none = static_cast<std::size_t>(-1);
+    std::size_t count {};
+    std::size_t passed_over {};
+
+    // Names of the nodes the reader is in, and the one a '{' would open
+    vector<string> path;
+    string pending;
+    Vessel vessel;
+    // path.size() while directly inside the VESSEL being read
+    std::size_t vessel_depth = none;
+
+    auto finish_vessel = [&]() {
+        if (vessel.type != "Station")
+        {
+            return;
+        }
+        if (!vessel.has_orbit || vessel.ref >= ref_bodies.size() || !(vessel.semi_major_axis > 0) ||
+            !(vessel.eccentricity >= 0 && vessel.eccentricity < 1))
+        {
+            ++passed_over;
+            return;
+        }
+
+        CelestialBody body = ref_bodies[vessel.ref];
+        const auto& constants = OrbitalElementsEngine::GetBodyConstants(body);
+        double apoapsis = vessel.semi_major_axis * (1 + vessel.eccentricity) - constants.radius;
+        double periapsis = vessel.semi_major_axis * (1 - vessel.eccentricity) - constants.radius;
+        OrbitalParameters orbit(static_cast<std::size_t>(std::llround(std::max(0.0, apoapsis))),
+                                static_cast<std::size_t>(std::llround(std::max(0.0, periapsis))));
+        orbit.inclination = vessel.inclination;
+        orbit.ascending_node = vessel.ascending_node;
+        orbit.argument_of_periapsis = vessel.argument_of_periapsis;
+        // Saves give the mean anomaly at an epoch; stations keep it at game time 0
+        double mean_motion = std::sqrt(constants.gravitational_parameter / std::pow(vessel.semi_major_axis, 3));
+        double mean_anomaly = std::fmod((vessel.mean_anomaly - mean_motion * vessel.epoch) * radians_to_degrees, 360.0);
+        orbit.mean_anomaly = mean_anomaly < 0 ? mean_anomaly + 360.0 : mean_anomaly;
+
+        string id = !vessel.persistent_id.empty() ? vessel.persistent_id
+                    : !vessel.pid.empty()         ? vessel.pid
+                                                  : vessel.name;
+        SpaceStationBuilder builder(id);
+        builder.SetName(vessel.name)
+            .SetOrbitDetails(orbit)
+            .SetOrbitingBody(body)
+            .SetCapacity(std::max(vessel.capacity, vessel.crew.size()))
+            .SetActive(true)
+            .AddKerbals(vessel.crew)
+            .SetDockingPortQuantities(DockingPortCount(vessel.ports))
+            .SetCommsDevicesQuantities(CommsDevCount(vessel.comms))
+            .SetSupplies(vessel.supplies);
+        on_station(builder.build());
+        ++count;
+    };
+
+    auto open_node = [&]() {
+        bool starts_vessel =
+            vessel_depth == none && pending == "VESSEL" && !path.empty() && path.back() == "FLIGHTSTATE";
+        path.push_back(pending);
+        pending.clear();
+        if (starts_vessel)
+        {
+            vessel = Vessel {};
+            vessel_depth = path.size();
+        }
+        else if (vessel_depth != none && path.size() == vessel_depth + 1 && path.back() == "PART")
+        {
+            vessel.part_name.clear();
+        }
+        else if (vessel_depth != none && path.size() == vessel_depth + 2 && path.back() == "RESOURCE")
+        {
+            vessel.resource_name.clear();
+            vessel.resource_amount = 0;
+        }
+    };
+
+    auto close_node = [&]() {
+        if (path.empty())
+        {
+            throw std::runtime_error("} without a node to close");
+        }
+        if (vessel_depth != none)
+        {
+            if (path.size() == vessel_depth)
+            {
+                finish_vessel();
+                vessel_depth = none;
+            }
+            else if (path.size() == vessel_depth + 1 && path.back() == "PART")
+            {
+                if (const PartInfo* part = FindPart(vessel.part_name))
+                {
+                    vessel.capacity += part->crew;
+                    if (part->port)
+                    {
+                        ++vessel.ports[static_cast<std::size_t>(*part->port)];
+                    }
+                    if (part->comms)
+                    {
+                        ++vessel.comms[static_cast<std::size_t>(*part->comms)];
+                    }
+                }
+            }
+            else if (path.size() == vessel_depth + 2 && path.back() == "RESOURCE" &&
+                     path[vessel_depth] == "PART" && vessel.resource_name == "Supplies")
+            {
+                vessel.supplies += vessel.resource_amount;
+            }
+        }
+        path.pop_back();
+        pending.clear();
+    };
+
+    // Only the values of the vessel being read are looked at
+    auto read_value = [&](std::string_view key, std::string_view value) {
+        if (vessel_depth == none)
+        {
+            return;
+        }
+        if (path.size() == vessel_depth)
+        {
+            if (key == "name")
+            {
+                vessel.name = value;
+            }
+            else if (key == "type")
+            {
+                vessel.type = value;
+            }
+            else if (key == "persistentId")
+            {
+                vessel.persistent_id = value;
+            }
+            else if (key == "pid")
+            {
+                vessel.pid = value;
+            }
+        }
+        else if (path.size() == vessel_depth + 1 && path.back() == "ORBIT")
+        {
+            vessel.has_orbit = true;
+            if (key == "SMA")
+            {
+                vessel.semi_major_axis = ReadNumber<double>(key, value);
+            }
+            else if (key == "ECC")
+            {
+                vessel.eccentricity = ReadNumber<double>(key, value);
+            }
+            else if (key == "INC")
+            {
+                vessel.inclination = ReadNumber<double>(key, value);
+            }
+            else if (key == "LAN")
+            {
+                vessel.ascending_node = ReadNumber<double>(key, value);
+            }
+            else if (key == "LPE")
+            {
+                vessel.argument_of_periapsis = ReadNumber<double>(key, value);
+            }
+            else if (key == "MNA")
+            {
+                vessel.mean_anomaly = ReadNumber<double>(key, value);
+            }
+            else if (key == "EPH")
+            {
+                vessel.epoch = ReadNumber<double>(key, value);
+            }
+            else if (key == "REF")
+            {
+                vessel.ref = ReadNumber<std::size_t>(key, value);
+            }
+        }
+        else if (path.size() == vessel_depth + 1 && path.back() == "PART")
+        {
+            if (key == "name")
+            {
+                vessel.part_name = value;
+            }
+            else if (key == "crew" && !value.empty())
+            {
+                vessel.crew.emplace_back(value);
+            }
+        }
+        else if (path.size() == vessel_depth + 2 && path.back() == "RESOURCE" && path[vessel_depth] == "PART")
+        {
+            if (key == "name")
+            {
+                vessel.resource_name = value;
+            }
+            else if (key == "amount")
+            {
+                vessel.resource_amount = ReadNumber<double>(key, value);
+            }
+        }
+    };
+
+    string line;
+    std::size_t line_number {};
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        try {
+            std::string_view text = line;
+            if (auto comment = text.find("//"); comment != std::string_view::npos)
+            {
+                text = text.substr(0, comment);
+            }
+
+            // Braces usually have a line to themselves but can follow a node
+            // name or share a line with values
+            while (!text.empty())
+            {
+                auto brace = text.find_first_of("{}");
+                auto segment = Trim(text.substr(0, brace));
+                if (!segment.empty())
+                {
+                    auto equals = segment.find('=');
+                    if (equals == std::string_view::npos)
+                    {
+                        pending = segment;
+                    }
+                    else
+                    {
+                        pending.clear();
+                        read_value(Trim(segment.substr(0, equals)), Trim(segment.substr(equals + 1)));
+                    }
+                }
+                if (brace == std::string_view::npos)
+                {
+                    break;
+                }
+                if (text[brace] == '{')
+                {
+                    open_node();
+                }
+                else
+                {
+                    close_node();
+                }
+                text.remove_prefix(brace + 1);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("line {}: {}", line_number, e.what()));
+        }
+    }
+    if (!path.empty())
+    {
+        throw std::runtime_error(fmt::format("line {}: {} isn't closed", line_number, path.back()));
+    }
+
+    if (skipped)
+    {
+        *skipped = passed_over;
+    }
+    return count;
+}
+
+string SaveImporter::PartKey(const string& name)
+{
+    string key = name;
+    std::replace(key.begin(), key.end(), '_', '.');
+    return key;
+}
@@ -1,11 +1,18 @@
 #include "include/space_station.hpp"
 #include "include/utils.hpp"
 #include "include/devices.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/life_support.hpp"
+#include <cmath>
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <fmt/core.h>
+#include <fmt/format.h>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
 
 using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
 using SpaceStationBuilder = KSP_SM::SpaceStationBuilder;
@@ -35,61 +42,114 @@ namespace KSP_SM
 
     string SpaceStation::ToString() const
     {
-        stringstream ss;
-        string tab = "\t";
-
-        ss << "Station Information" << endl;
-        ss << endl;
-        ss << "Station ID: " << m_station_id << endl;
-        ss << "Station Name: " << m_station_name << endl;
-        ss << fmt::format("Orbiting Planet: {}", Utility::PlanetToString(m_orbiting_body)) << endl;
-        ss << "Orbit Details: " << endl;
-        ss << fmt::format("\t Apoapsis: {} meters\n", Utility::numberWithCommas(m_orbit_details.apoapsis));
-        ss << fmt::format("\tPeriapsis: {} meters\n", Utility::numberWithCommas(m_orbit_details.periapsis));
-        ss << fmt::format("Capacity: {} kerbals", m_capacity) << endl;
-        ss << fmt::format("Station Currently Active: {}", Utility::BoolToYesNo(m_active)) << endl;
+        fmt::memory_buffer buffer;
+        this->FormatTo(buffer);
+        return fmt::to_string(buffer);
+    }
 
-        ss << "Communication Equipment: \n";
+    // Appends the station report to out. Nothing here allocates apart from
+    // out growing, so callers rendering many stations should clear and reuse
+    // one buffer.
+    void SpaceStation::FormatTo(fmt::memory_buffer& out) const
+    {
+        // Names are looked up once and kept for the life of the program
+        static const std::array<string, NUM_CELESTIAL_BODIES> planet_names = [] {
+            std::array<string, NUM_CELESTIAL_BODIES> names;
+            for (size_t i = 0; i < NUM_CELESTIAL_BODIES; ++i)
+            {
+                names.at(i) = Utility::PlanetToString(static_cast<CelestialBody>(i));
+            }
+            return names;
+        }();
+        static const std::array<string, NUM_COMM_DEVICES> comms_names = [] {
+            std::array<string, NUM_COMM_DEVICES> names;
+            for (size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+            {
+                names.at(i) = CommsDeviceToString(static_cast<CommunicationDevice>(i));
+            }
+            return names;
+        }();
+        static const std::array<string, NUM_DOCKING_PORTS> port_names = [] {
+            std::array<string, NUM_DOCKING_PORTS> names;
+            for (size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+            {
+                names.at(i) = DockingPortToString(static_cast<DockingPort>(i));
+            }
+            return names;
+        }();
+
+        auto it = std::back_inserter(out);
+
+        fmt::format_to(it, "Station Information\n\n");
+        fmt::format_to(it, "Station ID: {}\n", m_station_id);
+        fmt::format_to(it, "Station Name: {}\n", m_station_name);
+        const bool known_body = static_cast<size_t>(m_orbiting_body) < NUM_CELESTIAL_BODIES;
+        fmt::format_to(it, "Orbiting Planet: {}\n",
+                       known_body ? std::string_view(planet_names[static_cast<size_t>(m_orbiting_body)])
+                                  : std::string_view("Unknown"));
+        fmt::format_to(it, "Orbit Details: \n");
+        fmt::format_to(it, "\t Apoapsis: ");
+        Utility::FormatWithCommas(out, m_orbit_details.apoapsis);
+        fmt::format_to(it, " meters\n\tPeriapsis: ");
+        Utility::FormatWithCommas(out, m_orbit_details.periapsis);
+        fmt::format_to(it, " meters\n");
+        if (known_body)
+        {
+            auto elements = OrbitalElementsEngine::Compute(m_orbit_details, m_orbiting_body);
+            fmt::format_to(it, "\tSemi-major Axis: ");
+            Utility::FormatWithCommas(out, static_cast<size_t>(std::llround(elements.semi_major_axis)));
+            fmt::format_to(it, " meters\n\t   Eccentricity: {:.4f}\n", elements.eccentricity);
+            fmt::format_to(it, "\t Orbital Period: ");
+            OrbitalElementsEngine::FormatDuration(out, elements.period);
+            fmt::format_to(it, "\n\t Apoapsis Speed: {:.1f} m/s\n", elements.apoapsis_speed);
+            fmt::format_to(it, "\tPeriapsis Speed: {:.1f} m/s\n", elements.periapsis_speed);
+        }
+        fmt::format_to(it, "Capacity: {} kerbals\n", m_capacity);
+        fmt::format_to(it, "Supplies: {:.1f}", m_supplies);
+        if (!m_kerbals.empty())
+        {
+            double days = m_supplies / (LifeSupportSimulator::default_rate * static_cast<double>(m_kerbals.size()));
+            fmt::format_to(it, " ({:.1f} days for the current crew at the default USI rate)", days);
+        }
+        fmt::format_to(it, "\n");
+        fmt::format_to(it, "Station Currently Active: {}\n", m_active ? "Yes" : "No");
 
-        std::array<std::size_t, NUM_COMM_DEVICES> comm_counts = m_comms_dev_quantities.GetAsArray();
+        fmt::format_to(it, "Communication Equipment: \n");
         for (size_t i = 0; i < NUM_COMM_DEVICES; ++i)
         {
-            if(comm_counts.at(i) > 0)
+            auto count = m_comms_dev_quantities.GetCount(static_cast<CommunicationDevice>(i));
+            if (count > 0)
             {
-                ss << fmt::format("\t{:25}: {:4}\n", CommsDeviceToString(static_cast<CommunicationDevice>(i)), comm_counts.at(i));
+                fmt::format_to(it, "\t{:25}: {:4}\n", comms_names.at(i), count);
             }
         }
 
-        ss << "\n";
-
+        fmt::format_to(it, "\n");
 
-        ss << "Docking Ports Installed: \n";
-        std::array<std::size_t, NUM_DOCKING_PORTS> docking_counts = m_port_quantities.GetAsArray();
-        for(size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+        fmt::format_to(it, "Docking Ports Installed: \n");
+        for (size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
         {
-            if(docking_counts.at(i) > 0)
+            auto count = m_port_quantities.GetCount(static_cast<DockingPort>(i));
+            if (count > 0)
             {
-                ss << fmt::format("\t{:25}: {:4}\n", DockingPortToString(static_cast<DockingPort>(i)) , docking_counts.at(i));    
+                fmt::format_to(it, "\t{:25}: {:4}\n", port_names.at(i), count);
             }
         }
-        
-        ss << "\n";
 
-        ss << "Kerbals Present: " << endl;
+        fmt::format_to(it, "\n");
+
+        fmt::format_to(it, "Kerbals Present: \n");
         if (m_kerbals.size() > 0)
         {
-            
             for (size_t i {0}; i < m_kerbals.size(); ++i)
             {
-                ss << fmt::format("{}{}) {}", tab, i, m_kerbals.at(i)) << endl;
+                fmt::format_to(it, "\t{}) {}\n", i, m_kerbals.at(i));
             }
         }
         else
         {
-            ss << tab << "No kerbals currently onboard.\n";
+            fmt::format_to(it, "\tNo kerbals currently onboard.\n");
         }
-
-        return ss.str();
     }
 
     SpaceStationBuilder &SpaceStationBuilder::SetName(const string &name)
@@ -142,6 +202,12 @@ namespace KSP_SM
         return *this;
     }
 
+    SpaceStationBuilder& SpaceStationBuilder::SetSupplies(double supplies)
+    {
+        m_space_station->m_supplies = supplies;
+        return *this;
+    }
+
     SpaceStationBuilder& SpaceStationBuilder::SetDockingPortQuantities(const DockingPortCount& quantities)
     {
         this->m_space_station->m_port_quantities = quantities;
@@ -239,6 +305,36 @@ namespace KSP_SM
         return m_orbit_details;
     }
 
+    CelestialBody SpaceStation::GetOrbitingBody() const
+    {
+        return m_orbiting_body;
+    }
+
+    const DockingPortCount& SpaceStation::GetDockingPortQuantities() const
+    {
+        return m_port_quantities;
+    }
+
+    const CommsDevCount& SpaceStation::GetCommsDevQuantities() const
+    {
+        return m_comms_dev_quantities;
+    }
+
+    const vector<string>& SpaceStation::GetKerbals() const
+    {
+        return m_kerbals;
+    }
+
+    double SpaceStation::GetSupplies() const
+    {
+        return m_supplies;
+    }
+
+    void SpaceStation::SetSupplies(double supplies)
+    {
+        m_supplies = supplies;
+    }
+
     void to_json(json& j, const SpaceStation& ss)
     {
         j = json{{"id", ss.m_station_id}, {"name", ss.m_station_name},
@@ -246,6 +342,11 @@ namespace KSP_SM
                 {"capacity", ss.m_capacity},
                 {"kerbals", ss.m_kerbals}, {"apoapsis", ss.m_orbit_details.apoapsis},
                 {"periapsis", ss.m_orbit_details.periapsis}, {"orbiting", ss.m_orbiting_body},
+                {"inclination", ss.m_orbit_details.inclination},
+                {"ascending_node", ss.m_orbit_details.ascending_node},
+                {"arg_periapsis", ss.m_orbit_details.argument_of_periapsis},
+                {"mean_anomaly", ss.m_orbit_details.mean_anomaly},
+                {"supplies", ss.m_supplies},
                 {"port_quan_xs", ss.m_port_quantities.xs}, {"port_quan_sm", ss.m_port_quantities.sm},
                 {"port_quan_md", ss.m_port_quantities.md}, {"port_quan_lg", ss.m_port_quantities.lg},
                 {"port_quan_xl", ss.m_port_quantities.xl},
@@ -266,6 +367,11 @@ namespace KSP_SM
                 {"capacity", ss->m_capacity},
                 {"kerbals", ss->m_kerbals}, {"apoapsis", ss->m_orbit_details.apoapsis},
                 {"periapsis", ss->m_orbit_details.periapsis}, {"orbiting", ss->m_orbiting_body},
+                {"inclination", ss->m_orbit_details.inclination},
+                {"ascending_node", ss->m_orbit_details.ascending_node},
+                {"arg_periapsis", ss->m_orbit_details.argument_of_periapsis},
+                {"mean_anomaly", ss->m_orbit_details.mean_anomaly},
+                {"supplies", ss->m_supplies},
                 {"port_quan_xs", ss->m_port_quantities.xs}, {"port_quan_sm", ss->m_port_quantities.sm},
                 {"port_quan_md", ss->m_port_quantities.md}, {"port_quan_lg", ss->m_port_quantities.lg},
                 {"port_quan_xl", ss->m_port_quantities.xl}, {"comms_0", ss->m_comms_dev_quantities.C16},
@@ -277,35 +383,75 @@ namespace KSP_SM
 
     }
 
+    // Older files list every device as an array of enum values, one entry
+    // per device ("dockingPorts": [2, 2, 1] is two medium ports and a small
+    // one). Counts are used when a file has them, the arrays otherwise.
+    static void ReadPortCounts(const json& j, DockingPortCount& ports)
+    {
+        if (j.contains("port_quan_xs"))
+        {
+            j.at("port_quan_xs").get_to(ports.xs);
+            j.at("port_quan_sm").get_to(ports.sm);
+            j.at("port_quan_md").get_to(ports.md);
+            j.at("port_quan_lg").get_to(ports.lg);
+            j.at("port_quan_xl").get_to(ports.xl);
+            return;
+        }
+
+        std::array<std::size_t, NUM_DOCKING_PORTS> counts {};
+        for (const auto& port : j.at("dockingPorts"))
+        {
+            auto value = port.get<std::size_t>();
+            if (value >= NUM_DOCKING_PORTS)
+            {
+                throw std::runtime_error(fmt::format("unknown docking port {} in station {}", value, j.value("id", "")));
+            }
+            ++counts.at(value);
+        }
+        ports = DockingPortCount(counts);
+    }
+
+    static void ReadCommsCounts(const json& j, CommsDevCount& comms)
+    {
+        if (j.contains("comms_0"))
+        {
+            j.at("comms_0").get_to(comms.C16);
+            j.at("comms_1").get_to(comms.C16S);
+            j.at("comms_2").get_to(comms.C8888);
+            j.at("comms_3").get_to(comms.CDTS);
+            j.at("comms_4").get_to(comms.CHG55);
+            j.at("comms_5").get_to(comms.CHG5);
+            j.at("comms_6").get_to(comms.RA100);
+            j.at("comms_7").get_to(comms.RA15);
+            j.at("comms_8").get_to(comms.RA2);
+            return;
+        }
+
+        // The constructor takes counts in CommunicationDevice order
+        std::array<std::size_t, NUM_COMM_DEVICES> counts {};
+        for (const auto& dev : j.at("commsDevs"))
+        {
+            auto value = dev.get<std::size_t>();
+            if (value >= NUM_COMM_DEVICES)
+            {
+                throw std::runtime_error(fmt::format("unknown comms device {} in station {}", value, j.value("id", "")));
+            }
+            ++counts.at(value);
+        }
+        comms = CommsDevCount(counts);
+    }
+
+    bool SpaceStation::IsLegacyJson(const json& j)
+    {
+        return !j.contains("port_quan_xs") || !j.contains("comms_0");
+    }
+
     void from_json(const json& j, std::unique_ptr<SpaceStation>& ss)
     {
         ss.reset(new SpaceStation());
-        j.at("id").get_to(ss->m_station_id);
-        j.at("name").get_to(ss->m_station_name);
-        j.at("active").get_to(ss->m_active);
-        j.at("capacity").get_to(ss->m_capacity);
-        j.at("apoapsis").get_to(ss->m_orbit_details.apoapsis);
-        j.at("periapsis").get_to(ss->m_orbit_details.periapsis);
-        j.at("orbiting").get_to(ss->m_orbiting_body);
-        j.at("kerbals").get_to(ss->m_kerbals);
-        j.at("port_quan_xs").get_to(ss->m_port_quantities.xs);
-        j.at("port_quan_sm").get_to(ss->m_port_quantities.sm);
-        j.at("port_quan_md").get_to(ss->m_port_quantities.md);
-        j.at("port_quan_lg").get_to(ss->m_port_quantities.lg);
-        j.at("port_quan_xl").get_to(ss->m_port_quantities.xl);
-        j.at("comms_0").get_to(ss->m_comms_dev_quantities.C16);
-        j.at("comms_1").get_to(ss->m_comms_dev_quantities.C16S);
-        j.at("comms_2").get_to(ss->m_comms_dev_quantities.C8888);
-        j.at("comms_3").get_to(ss->m_comms_dev_quantities.CDTS);
-        j.at("comms_4").get_to(ss->m_comms_dev_quantities.CHG55);
-        j.at("comms_5").get_to(ss->m_comms_dev_quantities.CHG5);
-        j.at("comms_6").get_to(ss->m_comms_dev_quantities.RA100);
-        j.at("comms_7").get_to(ss->m_comms_dev_quantities.RA15);
-        j.at("comms_8").get_to(ss->m_comms_dev_quantities.RA2);
+        from_json(j, *ss);
     }
 
-    
-
     void from_json(const json& j, SpaceStation& ss)
     {
         j.at("id").get_to(ss.m_station_id);
@@ -316,20 +462,13 @@ namespace KSP_SM
         j.at("periapsis").get_to(ss.m_orbit_details.periapsis);
         j.at("orbiting").get_to(ss.m_orbiting_body);
         j.at("kerbals").get_to(ss.m_kerbals);
-        j.at("port_quan_xs").get_to(ss.m_port_quantities.xs);
-        j.at("port_quan_sm").get_to(ss.m_port_quantities.sm);
-        j.at("port_quan_md").get_to(ss.m_port_quantities.md);
-        j.at("port_quan_lg").get_to(ss.m_port_quantities.lg);
-        j.at("port_quan_xl").get_to(ss.m_port_quantities.xl);
-        j.at("comms_0").get_to(ss.m_comms_dev_quantities.C16);
-        j.at("comms_1").get_to(ss.m_comms_dev_quantities.C16S);
-        j.at("comms_2").get_to(ss.m_comms_dev_quantities.C8888);
-        j.at("comms_3").get_to(ss.m_comms_dev_quantities.CDTS);
-        j.at("comms_4").get_to(ss.m_comms_dev_quantities.CHG55);
-        j.at("comms_5").get_to(ss.m_comms_dev_quantities.CHG5);
-        j.at("comms_6").get_to(ss.m_comms_dev_quantities.RA100);
-        j.at("comms_7").get_to(ss.m_comms_dev_quantities.RA15);
-        j.at("comms_8").get_to(ss.m_comms_dev_quantities.RA2);
+        ss.m_orbit_details.inclination = j.value("inclination", 0.0);
+        ss.m_orbit_details.ascending_node = j.value("ascending_node", 0.0);
+        ss.m_orbit_details.argument_of_periapsis = j.value("arg_periapsis", 0.0);
+        ss.m_orbit_details.mean_anomaly = j.value("mean_anomaly", 0.0);
+        ss.m_supplies = j.value("supplies", 0.0);
+        ReadPortCounts(j, ss.m_port_quantities);
+        ReadCommsCounts(j, ss.m_comms_dev_quantities);
     }
 
     OrbitalParameters::OrbitalParameters(size_t ap, size_t pe)
@@ -338,11 +477,6 @@ namespace KSP_SM
         periapsis = pe;
     }
 
-    SpaceStation::~SpaceStation()
-    {
-        std::cout << "I'm being deleted!" << std::endl;
-    }
-
     SpaceStationBuilder& SpaceStationBuilder::AddKerbals(const vector<string>& kerbals)
     {
         m_space_station->m_kerbals = kerbals;
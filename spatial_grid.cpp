@@ -0,0 +1,65 @@
+#include "include/spatial_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+void SpatialGrid::Build(const PositionColumns& positions, double cell_size)
+{
+    std::size_t count = positions.Size();
+    m_cell_size = cell_size;
+    m_hashes.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        m_hashes[i] = Hash(Cell(positions.x[i]), Cell(positions.y[i]), Cell(positions.z[i]));
+    }
+
+    m_order.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::sort(m_order.begin(), m_order.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return m_hashes[a] < m_hashes[b];
+    });
+
+    // At most half full, so probe runs stay short
+    std::size_t slots = 16;
+    while (slots < count * 2)
+    {
+        slots *= 2;
+    }
+    m_mask = slots - 1;
+    m_slot_hashes.assign(slots, 0);
+    m_slot_begin.assign(slots, 0);
+    m_slot_end.assign(slots, 0);
+
+    for (std::size_t begin = 0; begin < count;)
+    {
+        std::size_t end = begin + 1;
+        while (end < count && m_hashes[m_order[end]] == m_hashes[m_order[begin]])
+        {
+            ++end;
+        }
+        std::uint64_t hash = m_hashes[m_order[begin]];
+        std::size_t slot = hash & m_mask;
+        while (m_slot_end[slot] != 0)
+        {
+            slot = (slot + 1) & m_mask;
+        }
+        m_slot_hashes[slot] = hash;
+        m_slot_begin[slot] = static_cast<std::uint32_t>(begin);
+        m_slot_end[slot] = static_cast<std::uint32_t>(end);
+        begin = end;
+    }
+}
+
+std::int64_t SpatialGrid::Cell(double coordinate) const noexcept
+{
+    return static_cast<std::int64_t>(std::floor(coordinate / m_cell_size));
+}
+
+std::uint64_t SpatialGrid::Hash(std::int64_t x, std::int64_t y, std::int64_t z) noexcept
+{
+    std::uint64_t h = static_cast<std::uint64_t>(x) * 0x9E3779B97F4A7C15ULL;
+    h ^= static_cast<std::uint64_t>(y) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= static_cast<std::uint64_t>(z) * 0x165667B19E3779F9ULL;
+    return h ^ (h >> 29);
+}
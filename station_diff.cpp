@@ -0,0 +1,172 @@
+#include "include/station_diff.hpp"
+#include "include/station_hash.hpp"
+#include "include/utils.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+vector<StationDiff::Difference> StationDiff::Compare(const vector<std::unique_ptr<SpaceStation>>& before,
+                                                     const vector<std::unique_ptr<SpaceStation>>& after)
+{
+    struct Entry
+    {
+        const SpaceStation* station;
+        std::uint64_t hash;
+        bool matched;
+    };
+
+    std::unordered_map<string, Entry> old_stations;
+    old_stations.reserve(before.size());
+    for (const auto& station : before)
+    {
+        old_stations.try_emplace(station->GetStationID(), Entry {station.get(), StationHash::Hash(*station), false});
+    }
+
+    vector<Difference> differences;
+    std::unordered_set<string> seen;
+    seen.reserve(after.size());
+    for (const auto& station : after)
+    {
+        const auto& id = station->GetStationID();
+        if (!seen.insert(id).second)
+        {
+            continue;
+        }
+
+        auto found = old_stations.find(id);
+        if (found == old_stations.end())
+        {
+            differences.push_back(Difference {Kind::ADDED, id, station->GetName(), {}});
+            continue;
+        }
+
+        found->second.matched = true;
+        if (found->second.hash != StationHash::Hash(*station))
+        {
+            differences.push_back(Difference {Kind::MODIFIED, id, station->GetName(),
+                                              CompareFields(*found->second.station, *station)});
+        }
+    }
+
+    for (const auto& station : before)
+    {
+        auto& entry = old_stations.at(station->GetStationID());
+        if (!entry.matched && entry.station == station.get())
+        {
+            differences.push_back(Difference {Kind::REMOVED, station->GetStationID(), station->GetName(), {}});
+        }
+    }
+    return differences;
+}
+
+vector<StationDiff::FieldChange> StationDiff::CompareFields(const SpaceStation& before, const SpaceStation& after)
+{
+    vector<FieldChange> changes;
+    auto compare = [&changes](const string& field, const auto& old_value, const auto& new_value) {
+        if (old_value != new_value)
+        {
+            changes.push_back(FieldChange {field, fmt::format("{}", old_value), fmt::format("{}", new_value)});
+        }
+    };
+
+    compare("name", before.GetName(), after.GetName());
+    compare("active", Utility::BoolToYesNo(before.isActive()), Utility::BoolToYesNo(after.isActive()));
+    compare("capacity", before.GetCapacity(), after.GetCapacity());
+    compare("apoapsis", before.GetOrbitalDetails().apoapsis, after.GetOrbitalDetails().apoapsis);
+    compare("periapsis", before.GetOrbitalDetails().periapsis, after.GetOrbitalDetails().periapsis);
+    compare("inclination", before.GetOrbitalDetails().inclination, after.GetOrbitalDetails().inclination);
+    compare("ascending_node", before.GetOrbitalDetails().ascending_node, after.GetOrbitalDetails().ascending_node);
+    compare("arg_periapsis", before.GetOrbitalDetails().argument_of_periapsis,
+            after.GetOrbitalDetails().argument_of_periapsis);
+    compare("mean_anomaly", before.GetOrbitalDetails().mean_anomaly, after.GetOrbitalDetails().mean_anomaly);
+    // Same known-body check as the report; out-of-range bodies are shown by
+    // their number so two different ones still read as different
+    auto body_name = [](CelestialBody body) {
+        const auto value = static_cast<std::size_t>(body);
+        return value < NUM_CELESTIAL_BODIES ? Utility::PlanetToString(body) : fmt::format("Unknown ({})", value);
+    };
+    compare("orbiting", body_name(before.GetOrbitingBody()), body_name(after.GetOrbitingBody()));
+    compare("supplies", before.GetSupplies(), after.GetSupplies());
+
+    for (std::size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+    {
+        auto port = static_cast<KSP_SM::DockingPort>(i);
+        compare(SpaceStation::DockingPortToString(port), before.GetDockingPortQuantities().GetCount(port),
+                after.GetDockingPortQuantities().GetCount(port));
+    }
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        auto dev = static_cast<KSP_SM::CommunicationDevice>(i);
+        compare(SpaceStation::CommsDeviceToString(dev), before.GetCommsDevQuantities().GetCount(dev),
+                after.GetCommsDevQuantities().GetCount(dev));
+    }
+
+    // Crew changes are listed as the kerbals who left and boarded; a
+    // reordered crew is reported as the whole list
+    const auto& old_crew = before.GetKerbals();
+    const auto& new_crew = after.GetKerbals();
+    if (old_crew != new_crew)
+    {
+        vector<bool> stayed(old_crew.size(), false);
+        vector<string> boarded;
+        for (const auto& name : new_crew)
+        {
+            bool found = false;
+            for (std::size_t o = 0; o < old_crew.size() && !found; ++o)
+            {
+                if (!stayed.at(o) && old_crew.at(o) == name)
+                {
+                    stayed.at(o) = found = true;
+                }
+            }
+            if (!found)
+            {
+                boarded.push_back(name);
+            }
+        }
+        vector<string> left;
+        for (std::size_t o = 0; o < old_crew.size(); ++o)
+        {
+            if (!stayed.at(o))
+            {
+                left.push_back(old_crew.at(o));
+            }
+        }
+
+        if (left.empty() && boarded.empty())
+        {
+            changes.push_back(FieldChange {"kerbals", fmt::format("{}", fmt::join(old_crew, ", ")),
+                                           fmt::format("{}", fmt::join(new_crew, ", "))});
+        }
+        else
+        {
+            changes.push_back(FieldChange {"kerbals", fmt::format("{}", fmt::join(left, ", ")),
+                                           fmt::format("{}", fmt::join(boarded, ", "))});
+        }
+    }
+    return changes;
+}
+
+void StationDiff::Print(std::ostream& out, const vector<Difference>& differences)
+{
+    fmt::memory_buffer buffer;
+    auto it = std::back_inserter(buffer);
+    for (const auto& difference : differences)
+    {
+        char marker = difference.kind == Kind::ADDED ? '+' : difference.kind == Kind::REMOVED ? '-' : '~';
+        fmt::format_to(it, "{} {} ({})\n", marker, difference.id, difference.name);
+        for (const auto& field : difference.fields)
+        {
+            if (field.field == "kerbals")
+            {
+                fmt::format_to(it, "    kerbals: -[{}] +[{}]\n", field.before, field.after);
+                continue;
+            }
+            fmt::format_to(it, "    {}: {} -> {}\n", field.field, field.before, field.after);
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+}
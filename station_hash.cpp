@@ -0,0 +1,103 @@
+#include "include/station_hash.hpp"
+
+#include <bit>
+#include <cstring>
+
+// Bumped if the encoding changes, so old and new hashes never match.
+static constexpr char encoding_version = 3;
+
+static void AppendNumber(string& out, std::uint64_t value)
+{
+    // Little endian regardless of the platform
+    for (int i = 0; i < 8; ++i)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Length first, so "ab" + "c" and "a" + "bc" encode differently.
+static void AppendText(string& out, const string& text)
+{
+    AppendNumber(out, text.size());
+    out.append(text);
+}
+
+void StationHash::Serialize(const SpaceStation& station, string& out)
+{
+    out.push_back(encoding_version);
+    AppendText(out, station.GetStationID());
+    AppendText(out, station.GetName());
+    AppendNumber(out, station.isActive());
+    AppendNumber(out, station.GetCapacity());
+    AppendNumber(out, station.GetOrbitalDetails().apoapsis);
+    AppendNumber(out, station.GetOrbitalDetails().periapsis);
+    AppendNumber(out, std::bit_cast<std::uint64_t>(station.GetOrbitalDetails().inclination));
+    AppendNumber(out, std::bit_cast<std::uint64_t>(station.GetOrbitalDetails().ascending_node));
+    AppendNumber(out, std::bit_cast<std::uint64_t>(station.GetOrbitalDetails().argument_of_periapsis));
+    AppendNumber(out, std::bit_cast<std::uint64_t>(station.GetOrbitalDetails().mean_anomaly));
+    AppendNumber(out, std::bit_cast<std::uint64_t>(station.GetSupplies()));
+    AppendNumber(out, static_cast<std::uint64_t>(station.GetOrbitingBody()));
+
+    // In enum order, whatever order the count structs keep them in
+    for (std::size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+    {
+        AppendNumber(out, station.GetDockingPortQuantities().GetCount(static_cast<KSP_SM::DockingPort>(i)));
+    }
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        AppendNumber(out, station.GetCommsDevQuantities().GetCount(static_cast<KSP_SM::CommunicationDevice>(i)));
+    }
+
+    AppendNumber(out, station.GetKerbals().size());
+    for (const auto& kerbal : station.GetKerbals())
+    {
+        AppendText(out, kerbal);
+    }
+}
+
+std::uint64_t StationHash::Hash(const SpaceStation& station)
+{
+    // Reused so hashing a whole file doesn't allocate per station
+    thread_local string buffer;
+    buffer.clear();
+    Serialize(station, buffer);
+    return Hash(buffer);
+}
+
+std::uint64_t StationHash::Hash(std::string_view bytes, std::uint64_t seed) noexcept
+{
+    constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+    constexpr int r = 47;
+
+    std::uint64_t h = seed ^ (bytes.size() * m);
+    const char* data = bytes.data();
+    const char* end = data + (bytes.size() / 8) * 8;
+
+    for (; data != end; data += 8)
+    {
+        std::uint64_t k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (bytes.size() & 7)
+    {
+    case 7: h ^= std::uint64_t(static_cast<unsigned char>(data[6])) << 48; [[fallthrough]];
+    case 6: h ^= std::uint64_t(static_cast<unsigned char>(data[5])) << 40; [[fallthrough]];
+    case 5: h ^= std::uint64_t(static_cast<unsigned char>(data[4])) << 32; [[fallthrough]];
+    case 4: h ^= std::uint64_t(static_cast<unsigned char>(data[3])) << 24; [[fallthrough]];
+    case 3: h ^= std::uint64_t(static_cast<unsigned char>(data[2])) << 16; [[fallthrough]];
+    case 2: h ^= std::uint64_t(static_cast<unsigned char>(data[1])) << 8; [[fallthrough]];
+    case 1: h ^= std::uint64_t(static_cast<unsigned char>(data[0]));
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
@@ -0,0 +1,218 @@
+#include "include/station_history.hpp"
+
+void StationHistory::SetDepth(std::size_t depth)
+{
+    m_depth = depth;
+    while (m_undo.size() > m_depth)
+    {
+        m_undo.pop_front();
+    }
+    if (m_depth == 0)
+    {
+        m_redo.clear();
+        m_current = Stations();
+    }
+}
+
+std::size_t StationHistory::GetDepth() const noexcept
+{
+    return m_depth;
+}
+
+bool StationHistory::IsEnabled() const noexcept
+{
+    return m_depth > 0;
+}
+
+void StationHistory::Reset(const vector<unique_station>& stations)
+{
+    m_undo.clear();
+    m_redo.clear();
+    m_current = IsEnabled() ? Snapshot(stations) : Stations();
+}
+
+void StationHistory::RecordAdd(const SpaceStation& station)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+    Push(EditKind::ADD, m_current.Size());
+    m_current = m_current.PushBack(std::make_shared<const SpaceStation>(station));
+}
+
+void StationHistory::RecordDelete(std::size_t index)
+{
+    if (!IsEnabled() || index >= m_current.Size())
+    {
+        return;
+    }
+    Push(EditKind::DELETE, index);
+    m_current = m_current.Erase(index);
+}
+
+void StationHistory::RecordModify(std::size_t index, const SpaceStation& station)
+{
+    if (!IsEnabled() || index >= m_current.Size())
+    {
+        return;
+    }
+    Push(EditKind::MODIFY, index);
+    m_current = m_current.Set(index, std::make_shared<const SpaceStation>(station));
+}
+
+void StationHistory::RecordReplaceAll(const vector<unique_station>& stations)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+    Push(EditKind::REPLACE_ALL, 0);
+    m_current = Snapshot(stations);
+}
+
+void StationHistory::RecordBatch(const vector<std::pair<std::size_t, const SpaceStation*>>& modified,
+                                 const vector<std::size_t>& deleted, const vector<const SpaceStation*>& added)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    // Undone like a bulk change, but recorded without copying the stations
+    // the batch didn't touch
+    Push(EditKind::REPLACE_ALL, 0);
+    for (const auto& [index, station] : modified)
+    {
+        m_current = m_current.Set(index, std::make_shared<const SpaceStation>(*station));
+    }
+    for (auto index = deleted.rbegin(); index != deleted.rend(); ++index)
+    {
+        m_current = m_current.Erase(*index);
+    }
+    for (const auto* station : added)
+    {
+        m_current = m_current.PushBack(std::make_shared<const SpaceStation>(*station));
+    }
+}
+
+bool StationHistory::CanUndo() const noexcept
+{
+    return !m_undo.empty();
+}
+
+bool StationHistory::CanRedo() const noexcept
+{
+    return !m_redo.empty();
+}
+
+bool StationHistory::Undo(vector<unique_station>& stations, Change& change)
+{
+    if (m_undo.empty())
+    {
+        return false;
+    }
+
+    Entry entry = std::move(m_undo.back());
+    m_undo.pop_back();
+    m_redo.push_back(Entry {m_current, entry.kind, entry.index});
+
+    const Stations& before = entry.version;
+    // An undone add is only in the current version, anything else is in before
+    string station_id;
+    if (entry.kind != EditKind::REPLACE_ALL)
+    {
+        station_id = (entry.kind == EditKind::ADD ? m_current : before).At(entry.index)->GetStationID();
+    }
+
+    switch (entry.kind)
+    {
+    case EditKind::ADD:
+        stations.erase(stations.begin() + entry.index);
+        break;
+    case EditKind::DELETE:
+        stations.insert(stations.begin() + entry.index, std::make_unique<SpaceStation>(*before.At(entry.index)));
+        break;
+    case EditKind::MODIFY:
+        *stations.at(entry.index) = *before.At(entry.index);
+        break;
+    case EditKind::REPLACE_ALL:
+        Restore(before, stations);
+        break;
+    }
+
+    m_current = before;
+    change = Change {entry.kind, entry.index, std::move(station_id)};
+    return true;
+}
+
+bool StationHistory::Redo(vector<unique_station>& stations, Change& change)
+{
+    if (m_redo.empty())
+    {
+        return false;
+    }
+
+    Entry entry = std::move(m_redo.back());
+    m_redo.pop_back();
+    m_undo.push_back(Entry {m_current, entry.kind, entry.index});
+
+    const Stations& after = entry.version;
+    // A redone delete is only in the current version, anything else is in after
+    string station_id;
+    if (entry.kind != EditKind::REPLACE_ALL)
+    {
+        station_id = (entry.kind == EditKind::DELETE ? m_current : after).At(entry.index)->GetStationID();
+    }
+
+    switch (entry.kind)
+    {
+    case EditKind::ADD:
+        stations.insert(stations.begin() + entry.index, std::make_unique<SpaceStation>(*after.At(entry.index)));
+        break;
+    case EditKind::DELETE:
+        stations.erase(stations.begin() + entry.index);
+        break;
+    case EditKind::MODIFY:
+        *stations.at(entry.index) = *after.At(entry.index);
+        break;
+    case EditKind::REPLACE_ALL:
+        Restore(after, stations);
+        break;
+    }
+
+    m_current = after;
+    change = Change {entry.kind, entry.index, std::move(station_id)};
+    return true;
+}
+
+// Saves the current version before an edit. The saved version shares its
+// nodes with m_current, so this doesn't copy any stations.
+void StationHistory::Push(EditKind kind, std::size_t index)
+{
+    m_undo.push_back(Entry {m_current, kind, index});
+    m_redo.clear();
+    while (m_undo.size() > m_depth)
+    {
+        m_undo.pop_front();
+    }
+}
+
+StationHistory::Stations StationHistory::Snapshot(const vector<unique_station>& stations)
+{
+    Stations snapshot;
+    for (const auto& station : stations)
+    {
+        snapshot = snapshot.PushBack(std::make_shared<const SpaceStation>(*station));
+    }
+    return snapshot;
+}
+
+void StationHistory::Restore(const Stations& version, vector<unique_station>& stations)
+{
+    stations.clear();
+    stations.reserve(version.Size());
+    version.ForEach([&](const StationPtr& station) {
+        stations.push_back(std::make_unique<SpaceStation>(*station));
+    });
+}
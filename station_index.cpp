@@ -0,0 +1,587 @@
+#include "include/station_index.hpp"
+#include "include/utils.hpp"
+
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+#include <fmt/core.h>
+
+using namespace KSP_SM;
+
+// Stations orbiting an unknown body match no orbit range filter.
+static OrbitalElements ComputeElements(const KSP_SM::SpaceStationBuilder::SpaceStation& station)
+{
+    if (static_cast<std::size_t>(station.GetOrbitingBody()) >= NUM_CELESTIAL_BODIES)
+    {
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        return OrbitalElements {nan, nan, nan, nan, nan};
+    }
+    return OrbitalElementsEngine::Compute(station);
+}
+
+StationBitmap::StationBitmap(std::size_t size, bool value)
+{
+    m_size = size;
+    m_words.assign((size + bits_per_word - 1) / bits_per_word, value ? ~std::uint64_t{0} : 0);
+    ClearUnusedBits();
+}
+
+std::size_t StationBitmap::Size() const noexcept
+{
+    return m_size;
+}
+
+bool StationBitmap::Test(std::size_t pos) const
+{
+    return (m_words.at(pos / bits_per_word) >> (pos % bits_per_word)) & 1;
+}
+
+void StationBitmap::Set(std::size_t pos, bool value)
+{
+    std::uint64_t mask = std::uint64_t{1} << (pos % bits_per_word);
+    if (value)
+    {
+        m_words.at(pos / bits_per_word) |= mask;
+    }
+    else
+    {
+        m_words.at(pos / bits_per_word) &= ~mask;
+    }
+}
+
+void StationBitmap::PushBack(bool value)
+{
+    if (m_size % bits_per_word == 0)
+    {
+        m_words.push_back(0);
+    }
+    ++m_size;
+    Set(m_size - 1, value);
+}
+
+// Inserts a bit at pos and shifts every following bit up by one, the
+// counterpart of Erase for a vector::insert on the station list.
+void StationBitmap::Insert(std::size_t pos, bool value)
+{
+    if (pos >= m_size)
+    {
+        PushBack(value);
+        return;
+    }
+
+    if (m_size % bits_per_word == 0)
+    {
+        m_words.push_back(0);
+    }
+
+    std::size_t word = pos / bits_per_word;
+    std::size_t bit = pos % bits_per_word;
+
+    // Every word after the one holding pos shifts up by one, taking the top
+    // bit of the previous word as its lowest bit.
+    for (std::size_t i = m_words.size() - 1; i > word; --i)
+    {
+        m_words.at(i) = (m_words.at(i) << 1) | (m_words.at(i - 1) >> (bits_per_word - 1));
+    }
+
+    std::uint64_t low_mask = (std::uint64_t{1} << bit) - 1;
+    std::uint64_t current = m_words.at(word);
+    m_words.at(word) = (current & low_mask) | ((current & ~low_mask) << 1) | (std::uint64_t{value} << bit);
+
+    ++m_size;
+    ClearUnusedBits();
+}
+
+// Removes the bit at pos and shifts every following bit down by one so the
+// bitmap stays in step with a vector::erase on the station list.
+void StationBitmap::Erase(std::size_t pos)
+{
+    if (pos >= m_size)
+    {
+        return;
+    }
+
+    std::size_t word = pos / bits_per_word;
+    std::size_t bit = pos % bits_per_word;
+
+    // Within the first word, keep the bits below pos and shift the rest down.
+    std::uint64_t low_mask = (std::uint64_t{1} << bit) - 1;
+    std::uint64_t current = m_words.at(word);
+    m_words.at(word) = (current & low_mask) | ((current >> 1) & ~low_mask);
+
+    // Every following word shifts down by one, carrying its lowest bit into
+    // the top of the previous word.
+    for (std::size_t i = word + 1; i < m_words.size(); ++i)
+    {
+        m_words.at(i - 1) |= (m_words.at(i) & 1) << (bits_per_word - 1);
+        m_words.at(i) >>= 1;
+    }
+
+    --m_size;
+    if (m_size % bits_per_word == 0)
+    {
+        m_words.pop_back();
+    }
+    ClearUnusedBits();
+}
+
+void StationBitmap::Clear() noexcept
+{
+    m_words.clear();
+    m_size = 0;
+}
+
+std::size_t StationBitmap::Count() const noexcept
+{
+    std::size_t count {};
+    for (auto word : m_words)
+    {
+        count += std::popcount(word);
+    }
+    return count;
+}
+
+vector<std::size_t> StationBitmap::GetSetPositions() const
+{
+    vector<std::size_t> positions;
+    positions.reserve(Count());
+
+    for (std::size_t i = 0; i < m_words.size(); ++i)
+    {
+        std::uint64_t word = m_words.at(i);
+        while (word)
+        {
+            positions.push_back(i * bits_per_word + std::countr_zero(word));
+            word &= word - 1; // clear lowest set bit
+        }
+    }
+
+    return positions;
+}
+
+StationBitmap& StationBitmap::operator&=(const StationBitmap& other)
+{
+    for (std::size_t i = 0; i < m_words.size() && i < other.m_words.size(); ++i)
+    {
+        m_words[i] &= other.m_words[i];
+    }
+    return *this;
+}
+
+StationBitmap& StationBitmap::operator|=(const StationBitmap& other)
+{
+    for (std::size_t i = 0; i < m_words.size() && i < other.m_words.size(); ++i)
+    {
+        m_words[i] |= other.m_words[i];
+    }
+    return *this;
+}
+
+StationBitmap StationBitmap::operator~() const
+{
+    StationBitmap result = *this;
+    for (auto& word : result.m_words)
+    {
+        word = ~word;
+    }
+    result.ClearUnusedBits();
+    return result;
+}
+
+// Bits past m_size in the last word must stay zero so Count() and the
+// bitwise operators don't pick up stations that don't exist.
+void StationBitmap::ClearUnusedBits() noexcept
+{
+    std::size_t used = m_size % bits_per_word;
+    if (used != 0 && !m_words.empty())
+    {
+        m_words.back() &= (std::uint64_t{1} << used) - 1;
+    }
+}
+
+StationBitmap operator&(StationBitmap lhs, const StationBitmap& rhs)
+{
+    lhs &= rhs;
+    return lhs;
+}
+
+StationBitmap operator|(StationBitmap lhs, const StationBitmap& rhs)
+{
+    lhs |= rhs;
+    return lhs;
+}
+
+void StationIndex::Rebuild(const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    this->Clear();
+    for (const auto& station : stations)
+    {
+        this->AppendBits(*station);
+    }
+    // Orbits are computed for the whole list in one batch
+    OrbitalElementsEngine::ComputeAll(stations, m_elements);
+}
+
+void StationIndex::Append(const SpaceStation& station)
+{
+    this->AppendBits(station);
+    m_elements.Insert(m_elements.Size(), ComputeElements(station));
+}
+
+void StationIndex::AppendBits(const SpaceStation& station)
+{
+    m_active.PushBack(false);
+    m_full.PushBack(false);
+    for (auto& bitmap : m_orbiting)
+    {
+        bitmap.PushBack(false);
+    }
+    for (auto& bitmap : m_ports)
+    {
+        bitmap.PushBack(false);
+    }
+    for (auto& bitmap : m_comms)
+    {
+        bitmap.PushBack(false);
+    }
+
+    SetBits(m_active.Size() - 1, station);
+}
+
+// Refreshes the bits for a station after it has been modified in place.
+void StationIndex::Update(std::size_t index, const SpaceStation& station)
+{
+    if (index >= this->Size())
+    {
+        return;
+    }
+    SetBits(index, station);
+    m_elements.Set(index, ComputeElements(station));
+}
+
+void StationIndex::Insert(std::size_t index, const SpaceStation& station)
+{
+    if (index >= this->Size())
+    {
+        Append(station);
+        return;
+    }
+
+    m_active.Insert(index, false);
+    m_full.Insert(index, false);
+    for (auto& bitmap : m_orbiting)
+    {
+        bitmap.Insert(index, false);
+    }
+    for (auto& bitmap : m_ports)
+    {
+        bitmap.Insert(index, false);
+    }
+    for (auto& bitmap : m_comms)
+    {
+        bitmap.Insert(index, false);
+    }
+    m_elements.Insert(index, ComputeElements(station));
+
+    SetBits(index, station);
+}
+
+void StationIndex::Erase(std::size_t index)
+{
+    m_active.Erase(index);
+    m_full.Erase(index);
+    for (auto& bitmap : m_orbiting)
+    {
+        bitmap.Erase(index);
+    }
+    for (auto& bitmap : m_ports)
+    {
+        bitmap.Erase(index);
+    }
+    for (auto& bitmap : m_comms)
+    {
+        bitmap.Erase(index);
+    }
+    m_elements.Erase(index);
+}
+
+void StationIndex::Clear() noexcept
+{
+    m_active.Clear();
+    m_full.Clear();
+    for (auto& bitmap : m_orbiting)
+    {
+        bitmap.Clear();
+    }
+    for (auto& bitmap : m_ports)
+    {
+        bitmap.Clear();
+    }
+    for (auto& bitmap : m_comms)
+    {
+        bitmap.Clear();
+    }
+    m_elements.Clear();
+}
+
+std::size_t StationIndex::Size() const noexcept
+{
+    return m_active.Size();
+}
+
+const StationBitmap& StationIndex::Active() const noexcept
+{
+    return m_active;
+}
+
+const StationBitmap& StationIndex::AtCapacity() const noexcept
+{
+    return m_full;
+}
+
+const StationBitmap& StationIndex::Orbiting(CelestialBody body) const
+{
+    return m_orbiting.at(static_cast<std::size_t>(body));
+}
+
+const StationBitmap& StationIndex::HasPort(DockingPort port) const
+{
+    return m_ports.at(static_cast<std::size_t>(port));
+}
+
+const StationBitmap& StationIndex::HasCommsDevice(CommunicationDevice dev) const
+{
+    return m_comms.at(static_cast<std::size_t>(dev));
+}
+
+const OrbitalElementColumns& StationIndex::GetOrbitalElements() const noexcept
+{
+    return m_elements;
+}
+
+void StationIndex::SetBits(std::size_t index, const SpaceStation& station)
+{
+    m_active.Set(index, station.isActive());
+    m_full.Set(index, station.GetNumberKerbalsAboard() >= station.GetCapacity());
+
+    for (std::size_t i = 0; i < NUM_CELESTIAL_BODIES; ++i)
+    {
+        m_orbiting.at(i).Set(index, station.GetOrbitingBody() == static_cast<CelestialBody>(i));
+    }
+    for (std::size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+    {
+        m_ports.at(i).Set(index, station.GetDockingPortQuantities().GetCount(static_cast<DockingPort>(i)) > 0);
+    }
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        m_comms.at(i).Set(index, station.GetCommsDevQuantities().GetCount(static_cast<CommunicationDevice>(i)) > 0);
+    }
+}
+
+static void SkipSpaces(const string& expr, std::size_t& pos)
+{
+    while (pos < expr.size() && std::isspace(static_cast<unsigned char>(expr.at(pos))))
+    {
+        ++pos;
+    }
+}
+
+StationBitmap StationIndex::Query(const string& expression) const
+{
+    std::size_t pos = 0;
+    StationBitmap result = ParseOr(expression, pos);
+
+    SkipSpaces(expression, pos);
+    if (pos != expression.size())
+    {
+        throw std::invalid_argument(fmt::format("Unexpected '{}' at position {} in filter", expression.at(pos), pos));
+    }
+
+    return result;
+}
+
+StationBitmap StationIndex::ParseOr(const string& expr, std::size_t& pos) const
+{
+    StationBitmap result = ParseAnd(expr, pos);
+
+    SkipSpaces(expr, pos);
+    while (pos < expr.size() && expr.at(pos) == '|')
+    {
+        ++pos;
+        result |= ParseAnd(expr, pos);
+        SkipSpaces(expr, pos);
+    }
+
+    return result;
+}
+
+StationBitmap StationIndex::ParseAnd(const string& expr, std::size_t& pos) const
+{
+    StationBitmap result = ParseUnary(expr, pos);
+
+    SkipSpaces(expr, pos);
+    while (pos < expr.size() && expr.at(pos) == '&')
+    {
+        ++pos;
+        result &= ParseUnary(expr, pos);
+        SkipSpaces(expr, pos);
+    }
+
+    return result;
+}
+
+StationBitmap StationIndex::ParseUnary(const string& expr, std::size_t& pos) const
+{
+    SkipSpaces(expr, pos);
+    if (pos < expr.size() && expr.at(pos) == '!')
+    {
+        ++pos;
+        return ~ParseUnary(expr, pos);
+    }
+
+    if (pos < expr.size() && expr.at(pos) == '(')
+    {
+        ++pos;
+        StationBitmap result = ParseOr(expr, pos);
+        SkipSpaces(expr, pos);
+        if (pos >= expr.size() || expr.at(pos) != ')')
+        {
+            throw std::invalid_argument("Missing ')' in filter");
+        }
+        ++pos;
+        return result;
+    }
+
+    return ParseTerm(expr, pos);
+}
+
+StationBitmap StationIndex::ParseTerm(const string& expr, std::size_t& pos) const
+{
+    static const char* port_names[NUM_DOCKING_PORTS] = {"xs", "sm", "md", "lg", "xl"};
+    static const char* comms_names[NUM_COMM_DEVICES] = {
+        "c16", "c16s", "c8888", "cdts", "hg5", "hg55", "ra15", "ra2", "ra100"
+    };
+
+    std::size_t start = pos;
+    while (pos < expr.size() && (std::isalnum(static_cast<unsigned char>(expr.at(pos))) || expr.at(pos) == '=' ||
+                                 expr.at(pos) == '<' || expr.at(pos) == '>' || expr.at(pos) == '.'))
+    {
+        ++pos;
+    }
+
+    string term = expr.substr(start, pos - start);
+    for (auto& c : term)
+    {
+        c = std::tolower(c);
+    }
+
+    if (term.empty())
+    {
+        throw std::invalid_argument(fmt::format("Expected a filter term at position {}", start));
+    }
+
+    if (term.compare("active") == 0)
+    {
+        return m_active;
+    }
+    if (term.compare("full") == 0)
+    {
+        return m_full;
+    }
+
+    auto comparison = term.find_first_of("<>");
+    if (comparison != string::npos)
+    {
+        return ParseRange(term, comparison);
+    }
+
+    auto equals = term.find('=');
+    if (equals != string::npos)
+    {
+        string key = term.substr(0, equals);
+        string value = term.substr(equals + 1);
+
+        if (key.compare("body") == 0)
+        {
+            CelestialBody body;
+            if (Utility::StringToPlanet(value, body))
+            {
+                return this->Orbiting(body);
+            }
+        }
+        if (key.compare("port") == 0)
+        {
+            for (std::size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+            {
+                if (value.compare(port_names[i]) == 0)
+                {
+                    return m_ports.at(i);
+                }
+            }
+        }
+        if (key.compare("comms") == 0)
+        {
+            for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+            {
+                if (value.compare(comms_names[i]) == 0)
+                {
+                    return m_comms.at(i);
+                }
+            }
+        }
+    }
+
+    throw std::invalid_argument(fmt::format("Unknown filter term '{}'", term));
+}
+
+// Evaluates "key<value" and friends by scanning one orbital element column.
+StationBitmap StationIndex::ParseRange(const string& term, std::size_t comparison) const
+{
+    string key = term.substr(0, comparison);
+    bool less = term.at(comparison) == '<';
+    std::size_t value_start = comparison + 1;
+    bool inclusive = value_start < term.size() && term.at(value_start) == '=';
+    if (inclusive)
+    {
+        ++value_start;
+    }
+
+    const vector<double>* column = nullptr;
+    if (key.compare("period") == 0)
+    {
+        column = &m_elements.period;
+    }
+    else if (key.compare("sma") == 0)
+    {
+        column = &m_elements.semi_major_axis;
+    }
+    else if (key.compare("ecc") == 0)
+    {
+        column = &m_elements.eccentricity;
+    }
+    else
+    {
+        throw std::invalid_argument(fmt::format("Unknown filter term '{}'", term));
+    }
+
+    double value {};
+    const char* first = term.data() + value_start;
+    const char* last = term.data() + term.size();
+    auto [end, error] = std::from_chars(first, last, value);
+    if (first == last || error != std::errc() || end != last)
+    {
+        throw std::invalid_argument(fmt::format("Expected a number in filter term '{}'", term));
+    }
+
+    // NaN compares false either way, so unknown orbits never match
+    StationBitmap result(column->size());
+    for (std::size_t i = 0; i < column->size(); ++i)
+    {
+        double x = (*column)[i];
+        bool match = less ? (inclusive ? x <= value : x < value) : (inclusive ? x >= value : x > value);
+        result.Set(i, match);
+    }
+    return result;
+}
@@ -0,0 +1,469 @@
+#include "include/station_io.hpp"
+
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+using namespace KSP_SM;
+using nlohmann::json;
+
+static constexpr std::size_t NUM_ORBIT_ANGLES = 4;
+static constexpr std::size_t NUM_BASE_COLUMNS = 7 + NUM_DOCKING_PORTS + NUM_COMM_DEVICES + 1;
+static constexpr std::size_t NUM_COLUMNS = NUM_BASE_COLUMNS + NUM_ORBIT_ANGLES + 1;
+
+static bool EndsWith(const string& value, const string& suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+StationFormat StationIO::FormatFromFilename(const string& filename)
+{
+    if (EndsWith(filename, ".csv"))
+    {
+        return StationFormat::CSV;
+    }
+    if (EndsWith(filename, ".tsv"))
+    {
+        return StationFormat::TSV;
+    }
+    if (EndsWith(filename, ".ndjson") || EndsWith(filename, ".jsonl"))
+    {
+        return StationFormat::NDJSON;
+    }
+    return StationFormat::JSON;
+}
+
+bool StationIO::IsLineFormat(StationFormat format) noexcept
+{
+    return format != StationFormat::JSON;
+}
+
+void StationIO::WriteHeader(std::ostream& out, StationFormat format)
+{
+    if (format != StationFormat::CSV && format != StationFormat::TSV)
+    {
+        return;
+    }
+
+    char delimiter = format == StationFormat::CSV ? ',' : '\t';
+    fmt::memory_buffer line;
+    auto it = std::back_inserter(line);
+
+    fmt::format_to(it, "id{0}name{0}active{0}capacity{0}apoapsis{0}periapsis{0}orbiting", delimiter);
+    fmt::format_to(it, "{0}port_xs{0}port_sm{0}port_md{0}port_lg{0}port_xl", delimiter);
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        fmt::format_to(it, "{}comms_{}", delimiter, i);
+    }
+    fmt::format_to(it, "{0}kerbals{0}inclination{0}ascending_node{0}arg_periapsis{0}mean_anomaly{0}supplies\n",
+                   delimiter);
+
+    out.write(line.data(), line.size());
+}
+
+// Writes a text field, quoting it for CSV when needed. TSV has no quoting,
+// so tabs are replaced with spaces. Newlines are always replaced since every
+// station must stay on one line.
+static void AppendText(fmt::memory_buffer& line, std::string_view text, char delimiter)
+{
+    bool quote = delimiter == ',' && text.find_first_of(",\"") != std::string_view::npos;
+
+    if (quote)
+    {
+        line.push_back('"');
+    }
+    for (char c : text)
+    {
+        if (c == '\n' || c == '\r' || (c == '\t' && delimiter == '\t'))
+        {
+            c = ' ';
+        }
+        if (quote && c == '"')
+        {
+            line.push_back('"');
+        }
+        line.push_back(c);
+    }
+    if (quote)
+    {
+        line.push_back('"');
+    }
+}
+
+// Appends one name to the kerbals field. Names are separated by ';', so a
+// ';' or '\\' in a name is escaped with a backslash.
+static void AppendKerbalName(fmt::memory_buffer& line, std::string_view name, char delimiter)
+{
+    for (char c : name)
+    {
+        if (c == '\n' || c == '\r' || (c == '\t' && delimiter == '\t'))
+        {
+            c = ' ';
+        }
+        if (c == ';' || c == '\\')
+        {
+            line.push_back('\\');
+        }
+        line.push_back(c);
+    }
+}
+
+void StationIO::FormatStation(fmt::memory_buffer& line, const SpaceStation& station, StationFormat format)
+{
+    auto it = std::back_inserter(line);
+
+    if (format == StationFormat::NDJSON || format == StationFormat::JSON)
+    {
+        json j = station;
+        auto text = j.dump();
+        line.append(text.data(), text.data() + text.size());
+        line.push_back('\n');
+        return;
+    }
+
+    char delimiter = format == StationFormat::CSV ? ',' : '\t';
+    const auto& ports = station.GetDockingPortQuantities();
+    const auto& comms = station.GetCommsDevQuantities();
+    const auto orbit = station.GetOrbitalDetails();
+
+    AppendText(line, station.GetStationID(), delimiter);
+    line.push_back(delimiter);
+    AppendText(line, station.GetName(), delimiter);
+    fmt::format_to(it, "{0}{1}{0}{2}{0}{3}{0}{4}{0}{5}", delimiter, station.isActive(), station.GetCapacity(),
+                   orbit.apoapsis, orbit.periapsis, static_cast<int>(station.GetOrbitingBody()));
+    fmt::format_to(it, "{0}{1}{0}{2}{0}{3}{0}{4}{0}{5}", delimiter, ports.xs, ports.sm, ports.md, ports.lg, ports.xl);
+    // Same order as the comms_N json keys
+    for (auto count : {comms.C16, comms.C16S, comms.C8888, comms.CDTS, comms.CHG55, comms.CHG5,
+                       comms.RA100, comms.RA15, comms.RA2})
+    {
+        fmt::format_to(it, "{}{}", delimiter, count);
+    }
+    line.push_back(delimiter);
+
+    // Kerbals are joined first so the whole sub-field is quoted together
+    std::size_t kerbals_start = line.size();
+    const auto& kerbals = station.GetKerbals();
+    for (std::size_t i = 0; i < kerbals.size(); ++i)
+    {
+        if (i > 0)
+        {
+            line.push_back(';');
+        }
+        AppendKerbalName(line, kerbals.at(i), delimiter);
+    }
+    if (delimiter == ',')
+    {
+        string joined(line.data() + kerbals_start, line.size() - kerbals_start);
+        line.resize(kerbals_start);
+        AppendText(line, joined, delimiter);
+    }
+    fmt::format_to(it, "{0}{1}{0}{2}{0}{3}{0}{4}{0}{5}\n", delimiter, orbit.inclination, orbit.ascending_node,
+                   orbit.argument_of_periapsis, orbit.mean_anomaly, station.GetSupplies());
+}
+
+// Returns the field starting at pos and moves pos past the following
+// delimiter. Quoted CSV fields containing escaped quotes are unescaped into
+// scratch, so the returned view is only valid until the next call.
+static std::string_view NextField(std::string_view line, std::size_t& pos, char delimiter, string& scratch)
+{
+    if (pos > line.size())
+    {
+        throw std::runtime_error("too few columns");
+    }
+
+    if (delimiter == ',' && pos < line.size() && line.at(pos) == '"')
+    {
+        scratch.clear();
+        std::size_t i = pos + 1;
+        while (true)
+        {
+            if (i >= line.size())
+            {
+                throw std::runtime_error("unterminated quoted field");
+            }
+            if (line.at(i) == '"')
+            {
+                if (i + 1 < line.size() && line.at(i + 1) == '"')
+                {
+                    scratch.push_back('"');
+                    i += 2;
+                    continue;
+                }
+                break;
+            }
+            scratch.push_back(line.at(i));
+            ++i;
+        }
+        // i is on the closing quote, which has to end the field
+        if (i + 1 < line.size() && line.at(i + 1) != delimiter)
+        {
+            throw std::runtime_error("unexpected text after a quoted field");
+        }
+        pos = i + 2;
+        return scratch;
+    }
+
+    auto end = line.find(delimiter, pos);
+    if (end == std::string_view::npos)
+    {
+        end = line.size();
+    }
+    std::string_view field = line.substr(pos, end - pos);
+    pos = end + 1;
+    return field;
+}
+
+template <typename T>
+static T ParseNumber(std::string_view field, const char* column)
+{
+    T value {};
+    auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (ec != std::errc() || end != field.data() + field.size())
+    {
+        throw std::runtime_error(fmt::format("invalid {} '{}'", column, field));
+    }
+    return value;
+}
+
+static bool ParseBool(std::string_view field)
+{
+    if (field == "true" || field == "1")
+    {
+        return true;
+    }
+    if (field == "false" || field == "0")
+    {
+        return false;
+    }
+    throw std::runtime_error(fmt::format("invalid active flag '{}'", field));
+}
+
+std::unique_ptr<StationIO::SpaceStation> StationIO::ParseDelimitedLine(std::string_view line, char delimiter, string& scratch)
+{
+    std::size_t pos = 0;
+
+    SpaceStationBuilder builder(string(NextField(line, pos, delimiter, scratch)));
+    builder.SetName(string(NextField(line, pos, delimiter, scratch)));
+    builder.SetActive(ParseBool(NextField(line, pos, delimiter, scratch)));
+    builder.SetCapacity(ParseNumber<std::size_t>(NextField(line, pos, delimiter, scratch), "capacity"));
+
+    auto apoapsis = ParseNumber<std::size_t>(NextField(line, pos, delimiter, scratch), "apoapsis");
+    auto periapsis = ParseNumber<std::size_t>(NextField(line, pos, delimiter, scratch), "periapsis");
+    OrbitalParameters orbit(apoapsis, periapsis);
+
+    auto orbiting = ParseNumber<int>(NextField(line, pos, delimiter, scratch), "orbiting");
+    builder.SetOrbitingBody(static_cast<CelestialBody>(orbiting));
+
+    DockingPortCount ports;
+    for (auto* count : {&ports.xs, &ports.sm, &ports.md, &ports.lg, &ports.xl})
+    {
+        *count = ParseNumber<std::size_t>(NextField(line, pos, delimiter, scratch), "docking port count");
+    }
+    builder.SetDockingPortQuantities(ports);
+
+    CommsDevCount comms;
+    for (auto* count : {&comms.C16, &comms.C16S, &comms.C8888, &comms.CDTS, &comms.CHG55, &comms.CHG5,
+                        &comms.RA100, &comms.RA15, &comms.RA2})
+    {
+        *count = ParseNumber<std::size_t>(NextField(line, pos, delimiter, scratch), "comms device count");
+    }
+    builder.SetCommsDevicesQuantities(comms);
+
+    // Names are separated by ';', with '\\' escaping the next character
+    std::string_view kerbals = NextField(line, pos, delimiter, scratch);
+    string name;
+    for (std::size_t i = 0; i < kerbals.size(); ++i)
+    {
+        if (kerbals.at(i) == '\\' && i + 1 < kerbals.size())
+        {
+            name.push_back(kerbals.at(++i));
+        }
+        else if (kerbals.at(i) == ';')
+        {
+            builder.AddKerbal(std::move(name));
+            name.clear();
+        }
+        else
+        {
+            name.push_back(kerbals.at(i));
+        }
+    }
+    if (!name.empty())
+    {
+        builder.AddKerbal(std::move(name));
+    }
+
+    // The orbit orientation and supplies columns were added later and may
+    // be missing
+    if (pos <= line.size())
+    {
+        for (auto* angle : {&orbit.inclination, &orbit.ascending_node, &orbit.argument_of_periapsis,
+                            &orbit.mean_anomaly})
+        {
+            *angle = ParseNumber<double>(NextField(line, pos, delimiter, scratch), "orbit angle");
+        }
+    }
+    builder.SetOrbitDetails(orbit);
+    if (pos <= line.size())
+    {
+        builder.SetSupplies(ParseNumber<double>(NextField(line, pos, delimiter, scratch), "supplies"));
+    }
+
+    if (pos <= line.size())
+    {
+        throw std::runtime_error(fmt::format("expected {}, {} or {} columns", NUM_BASE_COLUMNS,
+                                             NUM_BASE_COLUMNS + NUM_ORBIT_ANGLES, NUM_COLUMNS));
+    }
+
+    return builder.build();
+}
+
+std::size_t StationIO::ReadJsonStations(std::istream& in, const StationHandler& on_station, std::size_t* legacy_count)
+{
+    std::size_t count {};
+    std::size_t legacy {};
+
+    // Each element of the top level array is converted as soon as its
+    // closing brace is parsed and then dropped from the document
+    json::parser_callback_t callback = [&](int depth, json::parse_event_t event, json& parsed) {
+        if (depth != 1 || event != json::parse_event_t::object_end)
+        {
+            return true;
+        }
+        if (SpaceStation::IsLegacyJson(parsed))
+        {
+            ++legacy;
+        }
+        on_station(parsed.get<std::unique_ptr<SpaceStation>>());
+        ++count;
+        return false;
+    };
+
+    // Syntax errors and fields of the wrong type are reported the same way
+    // as problems in the line formats
+    json rest;
+    try {
+        rest = json::parse(in, callback);
+    }
+    catch (const json::exception& e)
+    {
+        throw std::runtime_error(fmt::format("Station {}: {}", count + 1, e.what()));
+    }
+    if (!rest.is_array() || !rest.empty())
+    {
+        throw std::runtime_error("expected an array of station objects");
+    }
+
+    if (legacy_count != nullptr)
+    {
+        *legacy_count = legacy;
+    }
+    return count;
+}
+
+std::size_t StationIO::ReadStations(std::istream& in, StationFormat format, const StationHandler& on_station)
+{
+    if (format == StationFormat::JSON)
+    {
+        return ReadJsonStations(in, on_station);
+    }
+
+    char delimiter = format == StationFormat::CSV ? ',' : '\t';
+    string line;
+    string scratch;
+    std::size_t line_number {};
+    std::size_t count {};
+
+    // The line buffer is reused, so after the first few lines reading does
+    // no allocation apart from the station itself.
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+        if (line_number == 1 && format != StationFormat::NDJSON && line.compare(0, 3, "id" + string(1, delimiter)) == 0)
+        {
+            continue; // header row
+        }
+
+        try {
+            if (format == StationFormat::NDJSON)
+            {
+                on_station(json::parse(line).get<std::unique_ptr<SpaceStation>>());
+            }
+            else
+            {
+                on_station(ParseDelimitedLine(line, delimiter, scratch));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("Line {}: {}", line_number, e.what()));
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+std::unique_ptr<StationIO::SpaceStation> StationIO::ParseLine(std::string_view line, StationFormat format)
+{
+    if (format == StationFormat::NDJSON || format == StationFormat::JSON)
+    {
+        try {
+            return json::parse(line).get<std::unique_ptr<SpaceStation>>();
+        }
+        catch (const json::exception& e)
+        {
+            throw std::runtime_error(e.what());
+        }
+    }
+
+    string scratch;
+    return ParseDelimitedLine(line, format == StationFormat::CSV ? ',' : '\t', scratch);
+}
+
+std::size_t StationIO::Convert(std::istream& in, StationFormat in_format, std::ostream& out, StationFormat out_format)
+{
+    fmt::memory_buffer line;
+
+    WriteHeader(out, out_format);
+    return ReadStations(in, in_format, [&](std::unique_ptr<SpaceStation> station) {
+        line.clear();
+        FormatStation(line, *station, out_format);
+        out.write(line.data(), line.size());
+    });
+}
+
+void StationIO::ReplaceFile(const string& filename, const std::function<void(std::ostream&)>& write)
+{
+    const string temp_filename = filename + ".tmp";
+    try {
+        std::ofstream out_file;
+        out_file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        out_file.open(temp_filename, std::ios::binary);
+        write(out_file);
+        out_file.close();
+    }
+    catch (const std::exception&)
+    {
+        std::remove(temp_filename.c_str());
+        throw std::runtime_error(fmt::format("couldn't write {}", temp_filename));
+    }
+
+    if (std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(temp_filename.c_str());
+        throw std::runtime_error(fmt::format("couldn't replace {}", filename));
+    }
+}
@@ -1,66 +1,436 @@
 #include "include/station_list.hpp"
 #include "include/utils.hpp"
 #include "include/menu.hpp"
+#include "include/thread_pool.hpp"
 
 #include <fmt/core.h>
+#include <fmt/format.h>
+#include <iterator>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <numeric>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include <cctype>
 
 
 
-void StationList::AddStation(unique_station& station) noexcept
+void StationList::AddStation(unique_station& station)
 {
     this->m_stations.push_back(std::move(station));
+    this->m_index.Append(*this->m_stations.back());
+    this->m_order.Invalidate();
+    this->m_history.RecordAdd(*this->m_stations.back());
+    ++this->m_modification_count;
+    this->Share(StationChangeKind::STATION_ADDED, this->m_stations.size() - 1);
+    this->Publish(StationChangeKind::STATION_ADDED, this->m_stations.size() - 1,
+                  this->m_stations.back()->GetCapacity(), this->m_stations.back()->GetStationID());
 }
 
-bool StationList::DeleteStation(const std::size_t index) noexcept
+bool StationList::DeleteStation(const std::size_t index)
 {
     if (index < this->m_stations.size())
     {
+        this->Publish(StationChangeKind::STATION_DELETED, index, 0, this->m_stations.at(index)->GetStationID());
         this->m_stations.erase(m_stations.begin() + index);
+        this->m_index.Erase(index);
+        this->m_order.Invalidate();
+        this->m_history.RecordDelete(index);
+        ++this->m_modification_count;
+        this->Share(StationChangeKind::STATION_DELETED, index);
         return true;
     }
 
     return false;
 }
 
+std::size_t StationList::DeleteStations(const vector<std::size_t>& indexes)
+{
+    vector<bool> doomed(m_stations.size(), false);
+    for (auto index : indexes)
+    {
+        if (index < doomed.size())
+        {
+            doomed.at(index) = true;
+        }
+    }
+
+    // Highest first, so each index is still right when the event is applied
+    for (std::size_t i = doomed.size(); m_feed && i-- > 0;)
+    {
+        if (doomed.at(i))
+        {
+            Publish(StationChangeKind::STATION_DELETED, i, 0, m_stations.at(i)->GetStationID());
+        }
+    }
+
+    std::size_t kept {};
+    for (std::size_t i = 0; i < m_stations.size(); ++i)
+    {
+        if (!doomed.at(i))
+        {
+            if (kept != i)
+            {
+                m_stations.at(kept) = std::move(m_stations.at(i));
+            }
+            ++kept;
+        }
+    }
+
+    if (m_shared)
+    {
+        m_shared->Update([&doomed](const ConcurrentStationList::Stations& shared) {
+            auto remaining = shared;
+            for (std::size_t i = doomed.size(); i-- > 0;)
+            {
+                if (doomed.at(i))
+                {
+                    remaining = remaining.Erase(i);
+                }
+            }
+            return remaining;
+        });
+    }
+
+    std::size_t removed = m_stations.size() - kept;
+    m_stations.resize(kept);
+    m_index.Rebuild(m_stations);
+    m_order.Invalidate();
+    m_history.RecordReplaceAll(m_stations);
+    ++m_modification_count;
+    return removed;
+}
+
 void StationList::ListAllStations() const
 {
 
+    fmt::memory_buffer buffer;
     for (size_t i = 0; i < m_stations.size(); ++i)
     {
-        std::cout << fmt::format("{}) {}", i, m_stations.at(i)->ToString()) << std::endl;
+        buffer.clear();
+        fmt::format_to(std::back_inserter(buffer), "{}) ", i);
+        m_stations.at(i)->FormatTo(buffer);
+        buffer.push_back('\n');
+        std::cout.write(buffer.data(), buffer.size());
+    }
+    std::cout.flush();
+}
+
+vector<std::size_t> StationList::GetSortedPage(const vector<SortField>& spec, std::size_t offset,
+                                              std::size_t limit, const StationBitmap* filter)
+{
+    return this->m_order.GetPage(this->m_stations, this->m_index.GetOrbitalElements(), spec, offset, limit, filter);
+}
+
+void StationList::ListStationsFromConsole()
+{
+    if (this->GetSize() == 0)
+    {
+        std::cout << "No stations to list.\n";
+        return;
+    }
+
+    string buffer {};
+    vector<SortField> spec;
+    std::size_t page_size {};
+    std::size_t page {};
+
+    Utility::ClearInputBuffer();
+
+    bool inputValidated {false};
+    while (!inputValidated)
+    {
+        std::cout << "Sort by (name, id, capacity, free, apoapsis, body, crew; append :desc to reverse,\n";
+        std::cout << "separate multiple keys with commas; leave blank for list order): ";
+        std::getline(std::cin, buffer);
+
+        try {
+            spec = StationOrder::ParseSortSpec(buffer);
+            inputValidated = true;
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cout << fmt::format("Invalid response. {}\n", e.what());
+        }
+    }
+
+    std::cout << "Stations per page (0 for all): ";
+    while (!(std::cin >> page_size))
+    {
+        std::cout << "Invalid response. Must be an integer.\n";
+        Utility::ClearInputBuffer();
+        std::cout << "Stations per page (0 for all): ";
+    }
+    Utility::ClearInputBuffer();
+
+    if (page_size == 0)
+    {
+        page_size = this->GetSize();
+    }
+
+    std::size_t page_count = (this->GetSize() + page_size - 1) / page_size;
+    bool doneListing = false;
+
+    while (!doneListing)
+    {
+        fmt::memory_buffer render_buffer;
+        for (auto index : this->GetSortedPage(spec, page * page_size, page_size))
+        {
+            render_buffer.clear();
+            fmt::format_to(std::back_inserter(render_buffer), "{}) ", index);
+            m_stations.at(index)->FormatTo(render_buffer);
+            render_buffer.push_back('\n');
+            std::cout.write(render_buffer.data(), render_buffer.size());
+        }
+        std::cout.flush();
+
+        if (page_count <= 1)
+        {
+            break;
+        }
+
+        std::cout << fmt::format("Page {} of {}\n", page + 1, page_count);
+        std::cout << "N -> Next Page, P -> Previous Page, F -> Finish: ";
+        std::getline(std::cin, buffer);
+        if (buffer.size() == 0)
+        {
+            continue;
+        }
+
+        switch (std::tolower(buffer.at(0)))
+        {
+          case 'n':
+            if (page + 1 < page_count)
+            {
+                ++page;
+            }
+            break;
+          case 'p':
+            if (page > 0)
+            {
+                --page;
+            }
+            break;
+          case 'f':
+            doneListing = true;
+            break;
+          default:
+            break;
+        }
     }
 }
 
 std::size_t StationList::ReadStationsFromFile(const string &filename)
 {
+    if (filename.compare("-") == 0)
+    {
+        return this->ReadStations(std::cin, StationFormat::NDJSON);
+    }
+
     std::ifstream in_file(filename);
     if (!in_file)
     {
         std::cerr << fmt::format("Error: {} not found.", filename) << std::endl;
         return 0;
     }
-    json j;
-    in_file >> j;
-    in_file.close(); // close file when done!
 
-    this->Reset();                             // clear stations vector prior to loading stations from json
-    m_stations = j.get<vector<unique_station>>(); // convert json to vector of unique_ptrs to json
+    return this->ReadStations(in_file, StationIO::FormatFromFilename(filename));
+}
+
+std::size_t StationList::ReadStations(std::istream& in, StationFormat format)
+{
+    vector<unique_station> stations;
+    auto add_station = [&stations](unique_station station) {
+        stations.push_back(std::move(station));
+    };
+
+    // Every format is read one station at a time
+    std::size_t legacy_count {};
+    if (format == StationFormat::JSON)
+    {
+        StationIO::ReadJsonStations(in, add_station, &legacy_count);
+    }
+    else
+    {
+        StationIO::ReadStations(in, format, add_station);
+    }
+
+    auto count = this->LoadStations(std::move(stations));
+    this->m_legacy_count = legacy_count;
+    return count;
+}
+
+// Validates freshly read stations and replaces the list with them.
+std::size_t StationList::LoadStations(vector<unique_station> stations)
+{
+    m_validation_issues.clear();
+    if (m_validation != ValidationMode::OFF)
+    {
+        m_validation_issues = StationValidator::Validate(stations, m_validation_threads);
+    }
+
+    if (!m_validation_issues.empty())
+    {
+        StationValidator::PrintReport(std::cerr, m_validation_issues);
+        switch (m_validation)
+        {
+        case ValidationMode::STRICT:
+            throw std::runtime_error(fmt::format("{} validation problems found, nothing was loaded",
+                                                 m_validation_issues.size()));
+        case ValidationMode::LENIENT:
+            std::cerr << fmt::format("Skipped {} invalid stations.\n",
+                                     StationValidator::RemoveInvalid(stations, m_validation_issues));
+            break;
+        default:
+            std::cerr << fmt::format("{} validation problems found.\n", m_validation_issues.size());
+            break;
+        }
+    }
+
+    // Not Reset(): that would publish an extra RELOADED for the empty list
+    m_order.Invalidate();
+    m_stations = std::move(stations);
+    m_index.Rebuild(m_stations);
+    m_history.Reset(m_stations);
+    ++m_modification_count;
+    Share(StationChangeKind::RELOADED, 0);
+    Publish(StationChangeKind::RELOADED, 0, m_stations.size(), {});
     return m_stations.size();
 }
 
+void StationList::SetValidation(ValidationMode mode, std::size_t threads) noexcept
+{
+    m_validation = mode;
+    m_validation_threads = threads;
+}
+
+ValidationMode StationList::GetValidation() const noexcept
+{
+    return m_validation;
+}
+
+const vector<ValidationIssue>& StationList::GetValidationIssues() const noexcept
+{
+    return m_validation_issues;
+}
+
+std::size_t StationList::GetLegacyCount() const noexcept
+{
+    return m_legacy_count;
+}
+
 std::size_t StationList::GetSize() noexcept
 {
     return this->m_stations.size();
 }
 
+std::uint64_t StationList::GetModificationCount() const noexcept
+{
+    return this->m_modification_count;
+}
+
 void StationList::WriteStationsToFile(const string &filename)
 {
+    if (filename.compare("-") == 0)
+    {
+        this->WriteStations(std::cout, StationFormat::NDJSON);
+        return;
+    }
+
+    const StationFormat format = StationIO::FormatFromFilename(filename);
+    StationIO::ReplaceFile(filename, [&](std::ostream& out) { this->WriteStations(out, format); });
+}
+
+void StationList::WriteStations(std::ostream& out, StationFormat format) const
+{
+    if (StationIO::IsLineFormat(format))
+    {
+        vector<std::size_t> indexes(m_stations.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        this->WriteStations(out, format, indexes);
+        return;
+    }
+
     json stations_json = this->m_stations;
-    std::ofstream out_file(filename);
-    out_file << stations_json.dump(4) << std::endl;
-    out_file.close(); // close file when done!
+    out << stations_json.dump(4) << std::endl;
+}
+
+// Writes the stations at indexes in a line format, one station at a time.
+void StationList::WriteStations(std::ostream& out, StationFormat format, const vector<std::size_t>& indexes) const
+{
+    fmt::memory_buffer line;
+
+    StationIO::WriteHeader(out, format);
+    for (auto index : indexes)
+    {
+        line.clear();
+        StationIO::FormatStation(line, *m_stations.at(index), format);
+        out.write(line.data(), line.size());
+    }
+}
+
+void StationList::DumpStations(std::ostream& out, const vector<std::size_t>& indexes, std::size_t threads) const
+{
+    // Stations rendered per task, and how many tasks may be rendered ahead
+    // of the writer per thread. Together these bound the memory held in
+    // finished but unwritten chunks.
+    constexpr std::size_t chunk_size = 256;
+    constexpr std::size_t chunks_ahead_per_thread = 4;
+
+    auto render_chunk = [this, &indexes](std::size_t begin, std::size_t end, fmt::memory_buffer& buffer) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            this->m_stations.at(indexes.at(i))->FormatTo(buffer);
+        }
+    };
+
+    if (threads == 1 || indexes.size() <= chunk_size)
+    {
+        fmt::memory_buffer buffer;
+        for (std::size_t begin = 0; begin < indexes.size(); begin += chunk_size)
+        {
+            buffer.clear();
+            render_chunk(begin, std::min(begin + chunk_size, indexes.size()), buffer);
+            out.write(buffer.data(), buffer.size());
+        }
+        return;
+    }
+
+    ThreadPool pool(threads);
+    std::size_t max_in_flight = pool.GetThreadCount() * chunks_ahead_per_thread;
+    std::deque<std::future<std::unique_ptr<fmt::memory_buffer>>> in_flight;
+    std::size_t next_begin {};
+
+    auto submit_next = [&]() {
+        std::size_t begin = next_begin;
+        std::size_t end = std::min(begin + chunk_size, indexes.size());
+        next_begin = end;
+        in_flight.push_back(pool.Submit([begin, end, &render_chunk]() {
+            auto buffer = std::make_unique<fmt::memory_buffer>();
+            render_chunk(begin, end, *buffer);
+            return buffer;
+        }));
+    };
+
+    while (next_begin < indexes.size() && in_flight.size() < max_in_flight)
+    {
+        submit_next();
+    }
+
+    // Single writer: take chunks in submission order so the output order
+    // matches indexes, topping up the window as each one is written.
+    while (!in_flight.empty())
+    {
+        auto buffer = in_flight.front().get();
+        in_flight.pop_front();
+        if (next_begin < indexes.size())
+        {
+            submit_next();
+        }
+        out.write(buffer->data(), buffer->size());
+    }
 }
 
 vector<unique_station>& StationList::GetStations()
@@ -68,9 +438,445 @@ vector<unique_station>& StationList::GetStations()
     return this->m_stations;
 }
 
-void StationList::Reset() noexcept
+void StationList::Reset()
 {
     this->m_stations.clear();
+    this->m_index.Clear();
+    this->m_order.Invalidate();
+    this->m_history.Reset(this->m_stations);
+    ++this->m_modification_count;
+    this->Share(StationChangeKind::RELOADED, 0);
+    this->Publish(StationChangeKind::RELOADED, 0, 0, {});
+}
+
+void StationList::RefreshStation(const std::size_t index)
+{
+    this->StationChanged(index);
+    this->Publish(StationChangeKind::STATION_MODIFIED, index, 0, this->m_stations.at(index)->GetStationID());
+}
+
+void StationList::AddKerbal(const std::size_t index, const string& name)
+{
+    auto& station = this->m_stations.at(index);
+    station->AddKerbal(name);
+    this->StationChanged(index);
+    this->Publish(StationChangeKind::KERBAL_BOARDED, index, station->GetNumberKerbalsAboard(),
+                  station->GetStationID(), name);
+}
+
+std::size_t StationList::RemoveKerbal(const std::size_t index, const std::size_t kerbal_index)
+{
+    auto& station = this->m_stations.at(index);
+    if (kerbal_index >= station->GetNumberKerbalsAboard())
+    {
+        return 0;
+    }
+
+    string name = station->GetKerbals().at(kerbal_index);
+    std::size_t removed = station->RemoveKerbalByIndex(kerbal_index);
+    this->StationChanged(index);
+    this->Publish(StationChangeKind::KERBAL_LEFT, index, station->GetNumberKerbalsAboard(),
+                  station->GetStationID(), name);
+    return removed;
+}
+
+bool StationList::ChangeCapacity(const std::size_t index, const std::size_t capacity)
+{
+    auto& station = this->m_stations.at(index);
+    if (capacity < station->GetNumberKerbalsAboard())
+    {
+        return false;
+    }
+
+    station->ChangeCapcity(capacity);
+    this->StationChanged(index);
+    this->Publish(StationChangeKind::CAPACITY_CHANGED, index, capacity, station->GetStationID());
+    return true;
+}
+
+std::shared_ptr<ChangeFeed> StationList::EnableChangeFeed(const std::size_t capacity)
+{
+    if (!this->m_feed)
+    {
+        this->m_feed = std::make_shared<ChangeFeed>(capacity);
+    }
+    return this->m_feed;
+}
+
+std::shared_ptr<ChangeFeed> StationList::GetChangeFeed() const noexcept
+{
+    return this->m_feed;
+}
+
+std::shared_ptr<ConcurrentStationList> StationList::EnableSnapshots()
+{
+    if (!this->m_shared)
+    {
+        this->m_shared = std::make_shared<ConcurrentStationList>();
+        this->Share(StationChangeKind::RELOADED, 0);
+    }
+    return this->m_shared;
+}
+
+// Applies a change already made to m_stations to the shared snapshot list.
+// Only adds, deletes, single station changes and reloads are used.
+void StationList::Share(StationChangeKind kind, std::size_t index)
+{
+    if (!this->m_shared)
+    {
+        return;
+    }
+
+    switch (kind)
+    {
+    case StationChangeKind::STATION_ADDED:
+        this->m_shared->InsertStation(index, std::make_unique<SpaceStation>(*this->m_stations.at(index)));
+        break;
+    case StationChangeKind::STATION_DELETED:
+        this->m_shared->DeleteStation(index);
+        break;
+    case StationChangeKind::RELOADED:
+    {
+        vector<unique_station> copies;
+        copies.reserve(this->m_stations.size());
+        for (const auto& station : this->m_stations)
+        {
+            copies.push_back(std::make_unique<SpaceStation>(*station));
+        }
+        this->m_shared->Reset(std::move(copies));
+        break;
+    }
+    default:
+        this->m_shared->ReplaceStation(index, std::make_unique<SpaceStation>(*this->m_stations.at(index)));
+        break;
+    }
+}
+
+void StationList::StationChanged(const std::size_t index)
+{
+    this->m_index.Update(index, *this->m_stations.at(index));
+    this->m_order.Invalidate();
+    this->m_history.RecordModify(index, *this->m_stations.at(index));
+    ++this->m_modification_count;
+    this->Share(StationChangeKind::STATION_MODIFIED, index);
+}
+
+void StationList::Publish(StationChangeKind kind, std::size_t index, std::uint64_t value,
+                          std::string_view station_id, std::string_view kerbal) noexcept
+{
+    if (this->m_feed)
+    {
+        this->m_feed->Publish(kind, index, value, station_id, kerbal);
+    }
+}
+
+// Publishes the crew and capacity changes that turn before into after.
+void StationList::PublishDifferences(std::size_t index, const SpaceStation& before, const SpaceStation& after)
+{
+    if (!this->m_feed)
+    {
+        return;
+    }
+
+    // Crews are a handful of names, so a quadratic match is fine. Each name
+    // in after cancels one matching name in before.
+    const auto& old_crew = before.GetKerbals();
+    const auto& new_crew = after.GetKerbals();
+    vector<bool> stayed(old_crew.size(), false);
+    vector<bool> boarded(new_crew.size(), true);
+    for (std::size_t n = 0; n < new_crew.size(); ++n)
+    {
+        for (std::size_t o = 0; o < old_crew.size() && boarded.at(n); ++o)
+        {
+            if (!stayed.at(o) && old_crew.at(o) == new_crew.at(n))
+            {
+                stayed.at(o) = true;
+                boarded.at(n) = false;
+            }
+        }
+    }
+
+    // Anything besides the crew and capacity has no event of its own
+    const auto& id = after.GetStationID();
+    if (before.GetStationID() != id || before.GetName() != after.GetName() || before.isActive() != after.isActive() ||
+        !(before.GetOrbitalDetails() == after.GetOrbitalDetails()) || before.GetOrbitingBody() != after.GetOrbitingBody() ||
+        !(before.GetDockingPortQuantities() == after.GetDockingPortQuantities()) ||
+        !(before.GetCommsDevQuantities() == after.GetCommsDevQuantities()))
+    {
+        this->Publish(StationChangeKind::STATION_MODIFIED, index, 0, id);
+    }
+
+    // Leaves first and boards last so the crew never goes over capacity
+    std::size_t aboard = old_crew.size();
+    for (std::size_t o = 0; o < old_crew.size(); ++o)
+    {
+        if (!stayed.at(o))
+        {
+            this->Publish(StationChangeKind::KERBAL_LEFT, index, --aboard, id, old_crew.at(o));
+        }
+    }
+    if (before.GetCapacity() != after.GetCapacity())
+    {
+        this->Publish(StationChangeKind::CAPACITY_CHANGED, index, after.GetCapacity(), id);
+    }
+    for (std::size_t n = 0; n < new_crew.size(); ++n)
+    {
+        if (boarded.at(n))
+        {
+            this->Publish(StationChangeKind::KERBAL_BOARDED, index, ++aboard, id, new_crew.at(n));
+        }
+    }
+}
+
+// Applies a validated StationTransaction. modified holds the new version of
+// each changed station (by index before the deletes) and gets the old
+// versions back, deleted is sorted. Changed stations have their contents
+// swapped in place, so pointers and references to them stay valid; the
+// rest is done with pointer moves into space reserved up front. None of it
+// can throw, so if the save fails the list can be put back exactly as it
+// was.
+void StationList::CommitTransaction(vector<std::pair<std::size_t, unique_station>>& modified,
+                                    const vector<std::size_t>& deleted, vector<unique_station>& added,
+                                    const string& save_filename)
+{
+    const std::size_t base_size = m_stations.size();
+    vector<unique_station> removed;
+    removed.reserve(deleted.size());
+    m_stations.reserve(std::max(base_size, base_size - deleted.size() + added.size()));
+
+    vector<std::pair<std::size_t, const SpaceStation*>> modified_stations;
+    vector<const SpaceStation*> added_stations;
+    modified_stations.reserve(modified.size());
+    added_stations.reserve(added.size());
+    for (const auto& [index, station] : modified)
+    {
+        modified_stations.emplace_back(index, m_stations.at(index).get());
+    }
+    for (const auto& station : added)
+    {
+        added_stations.push_back(station.get());
+    }
+
+    for (auto& [index, station] : modified)
+    {
+        std::swap(*m_stations.at(index), *station);
+    }
+
+    std::size_t kept {};
+    for (std::size_t i = 0, next_deleted = 0; i < base_size; ++i)
+    {
+        if (next_deleted < deleted.size() && deleted.at(next_deleted) == i)
+        {
+            removed.push_back(std::move(m_stations.at(i)));
+            ++next_deleted;
+        }
+        else
+        {
+            if (kept != i)
+            {
+                m_stations.at(kept) = std::move(m_stations.at(i));
+            }
+            ++kept;
+        }
+    }
+    m_stations.resize(kept);
+
+    for (auto& station : added)
+    {
+        m_stations.push_back(std::move(station));
+    }
+
+    if (!save_filename.empty())
+    {
+        try {
+            if (save_filename.compare("-") == 0)
+            {
+                this->WriteStations(std::cout, StationFormat::NDJSON);
+            }
+            else
+            {
+                // Written beside the file and renamed over it, so a failed
+                // write leaves the old file as it was
+                StationIO::ReplaceFile(save_filename, [&](std::ostream& out) {
+                    this->WriteStations(out, StationIO::FormatFromFilename(save_filename));
+                });
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Undo the moves above in reverse order
+            for (std::size_t i = added.size(); i-- > 0;)
+            {
+                added.at(i) = std::move(m_stations.back());
+                m_stations.pop_back();
+            }
+            m_stations.resize(base_size);
+            for (std::size_t i = base_size, next_deleted = deleted.size(); i-- > 0;)
+            {
+                if (next_deleted > 0 && deleted.at(next_deleted - 1) == i)
+                {
+                    m_stations.at(i) = std::move(removed.at(--next_deleted));
+                }
+                else if (--kept != i)
+                {
+                    m_stations.at(i) = std::move(m_stations.at(kept));
+                }
+            }
+            for (auto& [index, station] : modified)
+            {
+                std::swap(*m_stations.at(index), *station);
+            }
+            throw std::runtime_error(fmt::format("couldn't save stations to {}", save_filename));
+        }
+    }
+
+    // Deletes move stations, so the index has to be rebuilt; otherwise only
+    // the changed stations need updating
+    if (deleted.empty())
+    {
+        for (const auto& [index, station] : modified_stations)
+        {
+            m_index.Update(index, *station);
+        }
+        for (const auto* station : added_stations)
+        {
+            m_index.Append(*station);
+        }
+    }
+    else
+    {
+        m_index.Rebuild(m_stations);
+    }
+    m_order.Invalidate();
+    m_history.RecordBatch(modified_stations, deleted, added_stations);
+    ++m_modification_count;
+    if (m_shared)
+    {
+        // Published as one version so readers never see half a transaction
+        m_shared->Update([&](const ConcurrentStationList::Stations& shared) {
+            auto next = shared;
+            for (const auto& [index, station] : modified_stations)
+            {
+                next = next.Set(index, std::make_shared<const SpaceStation>(*station));
+            }
+            for (std::size_t i = deleted.size(); i-- > 0;)
+            {
+                next = next.Erase(deleted.at(i));
+            }
+            for (const auto* station : added_stations)
+            {
+                next = next.PushBack(std::make_shared<const SpaceStation>(*station));
+            }
+            return next;
+        });
+    }
+
+    // Same order the history applies them in: edits, deletes from the
+    // highest index down, then adds
+    for (std::size_t i = 0; m_feed && i < modified.size(); ++i)
+    {
+        PublishDifferences(modified.at(i).first, *modified.at(i).second, *modified_stations.at(i).second);
+    }
+    for (std::size_t i = deleted.size(); m_feed && i-- > 0;)
+    {
+        Publish(StationChangeKind::STATION_DELETED, deleted.at(i), 0, removed.at(i)->GetStationID());
+    }
+    for (std::size_t i = 0; m_feed && i < added_stations.size(); ++i)
+    {
+        Publish(StationChangeKind::STATION_ADDED, kept + i, added_stations.at(i)->GetCapacity(),
+                added_stations.at(i)->GetStationID());
+    }
+}
+
+void StationList::SetHistoryDepth(const std::size_t depth)
+{
+    this->m_history.SetDepth(depth);
+    this->m_history.Reset(this->m_stations);
+}
+
+bool StationList::Undo()
+{
+    StationHistory::Change change;
+    if (!this->m_history.Undo(this->m_stations, change))
+    {
+        return false;
+    }
+
+    // Undoing an add removes the station, undoing a delete puts it back
+    switch (change.kind)
+    {
+    case StationHistory::EditKind::ADD:
+        this->m_index.Erase(change.index);
+        this->Share(StationChangeKind::STATION_DELETED, change.index);
+        this->Publish(StationChangeKind::STATION_DELETED, change.index, 0, change.station_id);
+        break;
+    case StationHistory::EditKind::DELETE:
+        this->m_index.Insert(change.index, *this->m_stations.at(change.index));
+        this->Share(StationChangeKind::STATION_ADDED, change.index);
+        this->Publish(StationChangeKind::STATION_ADDED, change.index, this->m_stations.at(change.index)->GetCapacity(),
+                      change.station_id);
+        break;
+    case StationHistory::EditKind::MODIFY:
+        this->m_index.Update(change.index, *this->m_stations.at(change.index));
+        this->Share(StationChangeKind::STATION_MODIFIED, change.index);
+        this->Publish(StationChangeKind::STATION_MODIFIED, change.index, 0, change.station_id);
+        break;
+    case StationHistory::EditKind::REPLACE_ALL:
+        this->m_index.Rebuild(this->m_stations);
+        this->Share(StationChangeKind::RELOADED, 0);
+        this->Publish(StationChangeKind::RELOADED, 0, this->m_stations.size(), {});
+        break;
+    }
+    this->m_order.Invalidate();
+    ++this->m_modification_count;
+    return true;
+}
+
+bool StationList::Redo()
+{
+    StationHistory::Change change;
+    if (!this->m_history.Redo(this->m_stations, change))
+    {
+        return false;
+    }
+
+    switch (change.kind)
+    {
+    case StationHistory::EditKind::ADD:
+        this->m_index.Insert(change.index, *this->m_stations.at(change.index));
+        this->Share(StationChangeKind::STATION_ADDED, change.index);
+        this->Publish(StationChangeKind::STATION_ADDED, change.index, this->m_stations.at(change.index)->GetCapacity(),
+                      change.station_id);
+        break;
+    case StationHistory::EditKind::DELETE:
+        this->m_index.Erase(change.index);
+        this->Share(StationChangeKind::STATION_DELETED, change.index);
+        this->Publish(StationChangeKind::STATION_DELETED, change.index, 0, change.station_id);
+        break;
+    case StationHistory::EditKind::MODIFY:
+        this->m_index.Update(change.index, *this->m_stations.at(change.index));
+        this->Share(StationChangeKind::STATION_MODIFIED, change.index);
+        this->Publish(StationChangeKind::STATION_MODIFIED, change.index, 0, change.station_id);
+        break;
+    case StationHistory::EditKind::REPLACE_ALL:
+        this->m_index.Rebuild(this->m_stations);
+        this->Share(StationChangeKind::RELOADED, 0);
+        this->Publish(StationChangeKind::RELOADED, 0, this->m_stations.size(), {});
+        break;
+    }
+    this->m_order.Invalidate();
+    ++this->m_modification_count;
+    return true;
+}
+
+const StationIndex& StationList::GetIndex() const noexcept
+{
+    return this->m_index;
+}
+
+StationBitmap StationList::Filter(const string &expression) const
+{
+    return this->m_index.Query(expression);
 }
 
 
@@ -163,6 +969,22 @@ void StationList::ManageStationsFromConsole()
             break;
           }
 
+          case 'u':
+          case 'y':
+          {
+            bool changed = selection == 'u' ? this->Undo() : this->Redo();
+            std::cout << (changed ? (selection == 'u' ? "Undid last change.\n\n" : "Redid last change.\n\n")
+                                  : "Nothing to undo/redo.\n\n");
+
+            // Undo can remove the station being managed
+            if (index >= this->GetSize())
+            {
+                std::cout << "Station no longer exists. Returning to main menu.\n";
+                doneManaging = true;
+            }
+            break;
+          }
+
           case 'f':
           {
             doneManaging = true;
@@ -193,7 +1015,7 @@ void StationList::AddKerbalsFromConsole(const std::size_t stationIndex, std::siz
         if (buffer.compare("") != 0)
         {
             // Add kerbal to the stations list
-            this->m_stations.at(stationIndex)->AddKerbal(buffer);
+            this->AddKerbal(stationIndex, buffer);
             --max_additonal;
             continue;
         }
@@ -239,7 +1061,7 @@ std::size_t StationList::RemoveKerbalFromConsole(const std::size_t &index)
 
         // If exection reaches here, valid index was received
         // Remove kerbal by index
-        num_removed = this->GetStations().at(index)->RemoveKerbalByIndex(kerbal_remove_index);
+        num_removed = this->RemoveKerbal(index, kerbal_remove_index);
         std::cout << fmt::format("Removed kerbal at index {}\n", kerbal_remove_index);
         done_removing_kerbals = true;
         
@@ -270,7 +1092,7 @@ void StationList::ChangeCapacityFromConsole(const std::size_t& index)
     }
 
     // Change station capacity
-    current_station->ChangeCapcity(new_capacity);
+    this->ChangeCapacity(index, new_capacity);
     std::cout << fmt::format("Station capacity is now {}\n\n", current_station->GetCapacity());
     Utility::PressEnterToContinue();
     return;
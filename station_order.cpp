@@ -0,0 +1,230 @@
+#include "include/station_order.hpp"
+#include "include/orbital_elements.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <fmt/core.h>
+
+using SpaceStation = KSP_SM::SpaceStationBuilder::SpaceStation;
+
+static long long FreeSeats(const SpaceStation& station)
+{
+    return static_cast<long long>(station.GetCapacity()) - static_cast<long long>(station.GetNumberKerbalsAboard());
+}
+
+// Read from the index's cached columns. Stations orbiting an unknown body
+// have NaN there and sort after every real orbit.
+static double OrbitKey(SortKey key, const OrbitalElementColumns& elements, std::size_t index)
+{
+    double value;
+    switch (key)
+    {
+    case SortKey::PERIOD:
+        value = elements.period[index];
+        break;
+    case SortKey::SEMI_MAJOR_AXIS:
+        value = elements.semi_major_axis[index];
+        break;
+    default:
+        value = elements.eccentricity[index];
+        break;
+    }
+    return std::isnan(value) ? std::numeric_limits<double>::infinity() : value;
+}
+
+// Three way comparison of the stations at a and b on a single key.
+static int CompareOn(SortKey key, const vector<std::unique_ptr<SpaceStation>>& stations,
+                     const OrbitalElementColumns& elements, std::size_t a, std::size_t b)
+{
+    auto three_way = [](auto a, auto b) { return a < b ? -1 : (b < a ? 1 : 0); };
+    const SpaceStation& lhs = *stations[a];
+    const SpaceStation& rhs = *stations[b];
+
+    switch (key)
+    {
+    case SortKey::NAME:
+        return lhs.GetName().compare(rhs.GetName());
+    case SortKey::ID:
+        return lhs.GetStationID().compare(rhs.GetStationID());
+    case SortKey::CAPACITY:
+        return three_way(lhs.GetCapacity(), rhs.GetCapacity());
+    case SortKey::FREE_SEATS:
+        return three_way(FreeSeats(lhs), FreeSeats(rhs));
+    case SortKey::APOAPSIS:
+        return three_way(lhs.GetOrbitalDetails().apoapsis, rhs.GetOrbitalDetails().apoapsis);
+    case SortKey::BODY:
+        return three_way(static_cast<int>(lhs.GetOrbitingBody()), static_cast<int>(rhs.GetOrbitingBody()));
+    case SortKey::CREW:
+        return three_way(lhs.GetNumberKerbalsAboard(), rhs.GetNumberKerbalsAboard());
+    case SortKey::PERIOD:
+    case SortKey::SEMI_MAJOR_AXIS:
+    case SortKey::ECCENTRICITY:
+        return three_way(OrbitKey(key, elements, a), OrbitKey(key, elements, b));
+    case SortKey::INSERTION:
+    default:
+        return 0;
+    }
+}
+
+vector<SortField> StationOrder::ParseSortSpec(const string& spec)
+{
+    vector<SortField> fields;
+    std::size_t start = 0;
+
+    while (start <= spec.size())
+    {
+        auto comma = spec.find(',', start);
+        if (comma == string::npos)
+        {
+            comma = spec.size();
+        }
+
+        string item = spec.substr(start, comma - start);
+        start = comma + 1;
+        if (item.empty())
+        {
+            continue;
+        }
+
+        SortField field;
+        auto colon = item.find(':');
+        string name = item.substr(0, colon);
+        if (colon != string::npos)
+        {
+            string direction = item.substr(colon + 1);
+            if (direction.compare("desc") == 0)
+            {
+                field.descending = true;
+            }
+            else if (direction.compare("asc") != 0)
+            {
+                throw std::invalid_argument(fmt::format("Unknown sort direction '{}'", direction));
+            }
+        }
+
+        if (name.compare("name") == 0)
+            field.key = SortKey::NAME;
+        else if (name.compare("id") == 0)
+            field.key = SortKey::ID;
+        else if (name.compare("capacity") == 0)
+            field.key = SortKey::CAPACITY;
+        else if (name.compare("free") == 0)
+            field.key = SortKey::FREE_SEATS;
+        else if (name.compare("apoapsis") == 0)
+            field.key = SortKey::APOAPSIS;
+        else if (name.compare("body") == 0)
+            field.key = SortKey::BODY;
+        else if (name.compare("crew") == 0)
+            field.key = SortKey::CREW;
+        else if (name.compare("period") == 0)
+            field.key = SortKey::PERIOD;
+        else if (name.compare("sma") == 0)
+            field.key = SortKey::SEMI_MAJOR_AXIS;
+        else if (name.compare("ecc") == 0)
+            field.key = SortKey::ECCENTRICITY;
+        else
+            throw std::invalid_argument(fmt::format("Unknown sort key '{}'", name));
+
+        fields.push_back(field);
+    }
+
+    return fields;
+}
+
+void StationOrder::Invalidate() noexcept
+{
+    m_valid = false;
+}
+
+vector<std::size_t> StationOrder::GetPage(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                          const OrbitalElementColumns& elements, const vector<SortField>& spec,
+                                          std::size_t offset, std::size_t limit, const StationBitmap* filter)
+{
+    // A different sort spec means the cached permutation is no use
+    bool same_spec = m_spec.size() == spec.size() &&
+        std::equal(spec.begin(), spec.end(), m_spec.begin(), [](const SortField& a, const SortField& b) {
+            return a.key == b.key && a.descending == b.descending;
+        });
+
+    if (!m_valid || !same_spec || m_permutation.size() != stations.size())
+    {
+        m_permutation.resize(stations.size());
+        std::iota(m_permutation.begin(), m_permutation.end(), 0);
+        m_spec = spec;
+        m_sorted_count = 0;
+        m_valid = true;
+    }
+
+    vector<std::size_t> page;
+    if (offset >= stations.size())
+    {
+        return page;
+    }
+
+    std::size_t wanted = limit > stations.size() ? stations.size() : limit;
+    std::size_t skipped {};
+    std::size_t position {};
+
+    // Sort just enough of the permutation to fill the page. With a filter we
+    // don't know how far down the matches are, so grow the sorted prefix in
+    // doubling steps.
+    std::size_t target = offset + wanted;
+    while (page.size() < wanted && position < stations.size())
+    {
+        if (target > stations.size())
+        {
+            target = stations.size();
+        }
+        EnsureSorted(stations, elements, target);
+
+        for (; position < target && page.size() < wanted; ++position)
+        {
+            std::size_t index = m_permutation.at(position);
+            if (filter != nullptr && !filter->Test(index))
+            {
+                continue;
+            }
+            if (skipped < offset)
+            {
+                ++skipped;
+                continue;
+            }
+            page.push_back(index);
+        }
+
+        target = target * 2 + 1;
+    }
+
+    return page;
+}
+
+void StationOrder::EnsureSorted(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                const OrbitalElementColumns& elements, std::size_t count)
+{
+    if (count <= m_sorted_count)
+    {
+        return;
+    }
+
+    auto less = [&](std::size_t a, std::size_t b) {
+        for (const auto& field : m_spec)
+        {
+            int result = CompareOn(field.key, stations, elements, a, b);
+            if (result != 0)
+            {
+                return field.descending ? result > 0 : result < 0;
+            }
+        }
+        // Fall back to insertion order so the listing is stable
+        return a < b;
+    };
+
+    // Everything in the sorted prefix is already no larger than the rest, so
+    // only the unsorted tail needs to be partially sorted.
+    std::partial_sort(m_permutation.begin() + m_sorted_count, m_permutation.begin() + count,
+                      m_permutation.end(), less);
+    m_sorted_count = count;
+}
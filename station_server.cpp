@@ -0,0 +1,551 @@
+#include "include/station_server.hpp"
+#include "include/station_io.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+StationServer::StationServer(StationList& stations, string filename, string socket_path, int save_interval_seconds)
+    : m_stations(stations), m_script(stations), m_filename(std::move(filename)),
+      m_socket_path(std::move(socket_path)), m_save_interval_seconds(save_interval_seconds),
+      m_snapshots(stations.EnableSnapshots()), m_transfer_changes(stations.EnableChangeFeed()->Subscribe())
+{
+}
+
+void StationServer::UpdateTransferCosts()
+{
+    vector<StationChange> changes;
+    bool changed = !m_transfer_costs_ready;
+    while (m_transfer_changes.Poll(changes) > 0)
+    {
+        changed = true;
+    }
+    if (changed)
+    {
+        m_transfer_costs.Update(m_stations.GetStations());
+        m_transfer_costs_ready = true;
+    }
+}
+
+bool StationServer::Save()
+{
+    if (!m_dirty)
+    {
+        return true;
+    }
+    // Stay dirty on failure so the next interval tries again
+    try {
+        m_stations.WriteStationsToFile(m_filename);
+        m_dirty = false;
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << fmt::format("Error: couldn't save stations: {}\n", e.what());
+        return false;
+    }
+}
+
+void StationServer::StartDump(const string& filename)
+{
+    // Forget dumps that have finished
+    m_dumps.erase(std::remove_if(m_dumps.begin(), m_dumps.end(),
+                                 [](const std::future<void>& dump) {
+                                     return dump.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                 }),
+                  m_dumps.end());
+
+    auto snapshot = m_snapshots->GetSnapshot();
+    m_dumps.push_back(std::async(std::launch::async, [snapshot, filename]() {
+        try {
+            std::ofstream out_file;
+            out_file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out_file.open(filename);
+            snapshot->DumpStations(out_file);
+            out_file.close();
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << fmt::format("Error: couldn't write the station dump to {}.\n", filename);
+        }
+    }));
+}
+
+bool StationServer::HandleInput(Connection& connection)
+{
+    // Answer every complete request line
+    std::size_t start = 0;
+    std::size_t newline;
+    while ((newline = connection.input.find('\n', start)) != string::npos)
+    {
+        // The client isn't reading its responses
+        if (connection.output.size() > max_pending_output)
+        {
+            connection.input.clear();
+            return false;
+        }
+        if (newline - start > max_request_length)
+        {
+            break;
+        }
+
+        string request = connection.input.substr(start, newline - start);
+        if (!request.empty() && request.back() == '\r')
+        {
+            request.pop_back();
+        }
+        HandleRequest(request, connection.output);
+        start = newline + 1;
+    }
+    connection.input.erase(0, start);
+
+    if (connection.input.size() > max_request_length)
+    {
+        connection.input.clear();
+        connection.output += "ERR request too long\n";
+        return false;
+    }
+    return true;
+}
+
+void StationServer::HandleRequest(const string& request, string& response)
+{
+    std::string_view text(request);
+    auto space = text.find(' ');
+    std::string_view command = text.substr(0, space);
+    std::string_view argument = space == std::string_view::npos ? std::string_view {} : text.substr(space + 1);
+
+    try {
+        if (command == "ping")
+        {
+        }
+        else if (command == "count")
+        {
+            response += fmt::format("{}\n", m_stations.GetSize());
+        }
+        else if (command == "get")
+        {
+            std::size_t index;
+            if (!m_script.LookupStation(string(argument), index))
+            {
+                throw std::runtime_error(fmt::format("station '{}' not found", argument));
+            }
+            fmt::memory_buffer line;
+            StationIO::FormatStation(line, *m_stations.GetStations().at(index), StationFormat::NDJSON);
+            response.append(line.data(), line.size());
+        }
+        else if (command == "filter")
+        {
+            auto selected = m_stations.Filter(string(argument));
+            for (auto index : selected.GetSetPositions())
+            {
+                response += fmt::format("{} {}\n", index, m_stations.GetStations().at(index)->GetStationID());
+            }
+        }
+        else if (command == "nearest")
+        {
+            std::size_t from;
+            if (!m_script.LookupStation(string(argument), from))
+            {
+                throw std::runtime_error(fmt::format("station '{}' not found", argument));
+            }
+            UpdateTransferCosts();
+            const auto& list = m_stations.GetStations();
+            for (const auto& transfer : m_transfer_costs.Nearest(from, 10))
+            {
+                response += fmt::format("{:.1f} {}\n", transfer.delta_v, list.at(transfer.index)->GetStationID());
+            }
+        }
+        else if (command == "route")
+        {
+            auto comma = argument.find(',');
+            std::size_t from;
+            std::size_t to;
+            if (comma == std::string_view::npos)
+            {
+                throw std::runtime_error("route takes FROM,TO station IDs");
+            }
+            if (!m_script.LookupStation(string(argument.substr(0, comma)), from) ||
+                !m_script.LookupStation(string(argument.substr(comma + 1)), to))
+            {
+                throw std::runtime_error(fmt::format("station in '{}' not found", argument));
+            }
+            UpdateTransferCosts();
+            auto route = m_transfer_costs.CheapestRoute(from, to);
+            if (route.empty())
+            {
+                throw std::runtime_error(fmt::format("no route for '{}'", argument));
+            }
+            const auto& list = m_stations.GetStations();
+            std::size_t previous = from;
+            for (const auto& leg : route)
+            {
+                response += fmt::format("{} {} {:.1f}\n", list.at(previous)->GetStationID(),
+                                        list.at(leg.index)->GetStationID(), leg.delta_v);
+                previous = leg.index;
+            }
+        }
+        else if (command == "dump")
+        {
+            if (argument.empty())
+            {
+                throw std::runtime_error("missing output filename");
+            }
+            StartDump(string(argument));
+        }
+        else if (command == "save")
+        {
+            m_dirty = true;
+            if (!Save())
+            {
+                throw std::runtime_error(fmt::format("couldn't save {}", m_filename));
+            }
+        }
+        else if (command == "shutdown")
+        {
+            m_stopping = true;
+        }
+        else
+        {
+            if (m_script.Apply(text))
+            {
+                // Apply deletes right away so later queries don't see them
+                m_script.Flush();
+                m_dirty = true;
+            }
+        }
+        response += "OK\n";
+    }
+    catch (const std::exception& e)
+    {
+        response += fmt::format("ERR {}\n", e.what());
+    }
+}
+
+#ifdef __linux__
+
+static bool SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+static bool MakeAddress(const string& socket_path, sockaddr_un& address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << fmt::format("Error: socket path {} is too long.\n", socket_path);
+        return false;
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+// Removes a socket left behind by a server that is no longer running. Anything
+// else at the path, including the socket of a live server, is left alone and
+// reported.
+static bool RemoveStaleSocket(const string& socket_path, const sockaddr_un& address)
+{
+    struct stat status;
+    if (lstat(socket_path.c_str(), &status) == -1)
+    {
+        if (errno == ENOENT)
+        {
+            return true;
+        }
+        std::cerr << fmt::format("Error: unable to check {}: {}\n", socket_path, std::strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(status.st_mode))
+    {
+        std::cerr << fmt::format("Error: {} exists and is not a socket.\n", socket_path);
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool connected = fd != -1 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    int connect_error = errno;
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    if (connected)
+    {
+        std::cerr << fmt::format("Error: a server is already running on {}.\n", socket_path);
+        return false;
+    }
+    if (connect_error != ECONNREFUSED)
+    {
+        std::cerr << fmt::format("Error: unable to check {}: {}\n", socket_path, std::strerror(connect_error));
+        return false;
+    }
+    return unlink(socket_path.c_str()) == 0 || errno == ENOENT;
+}
+
+int StationServer::Run()
+{
+    sockaddr_un address;
+    if (!MakeAddress(m_socket_path, address) || !RemoveStaleSocket(m_socket_path, address))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1 || bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+        listen(listen_fd, SOMAXCONN) == -1 || !SetNonBlocking(listen_fd))
+    {
+        std::cerr << fmt::format("Error: unable to listen on {}: {}\n", m_socket_path, std::strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Handle SIGINT/SIGTERM through the event loop so we get to save
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+
+    int epoll_fd = epoll_create1(0);
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.fd = signal_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &event);
+
+    std::cout << fmt::format("Serving {} stations on {}\n", m_stations.GetSize(), m_socket_path);
+
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+    char read_buffer[64 * 1024];
+    auto last_save = std::chrono::steady_clock::now();
+
+    auto close_connection = [&](int fd) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        m_connections.erase(fd);
+    };
+
+    while (!m_stopping)
+    {
+        int timeout = m_dirty ? m_save_interval_seconds * 1000 : -1;
+        int ready = epoll_wait(epoll_fd, events, max_events, timeout);
+        if (ready == -1 && errno != EINTR)
+        {
+            std::cerr << fmt::format("Error: epoll_wait failed: {}\n", std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i)
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == signal_fd)
+            {
+                m_stopping = true;
+                continue;
+            }
+
+            if (fd == listen_fd)
+            {
+                int client_fd;
+                while ((client_fd = accept(listen_fd, nullptr, nullptr)) != -1)
+                {
+                    SetNonBlocking(client_fd);
+                    epoll_event client_event {};
+                    client_event.events = EPOLLIN | EPOLLRDHUP;
+                    client_event.data.fd = client_fd;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event);
+                    m_connections[client_fd];
+                }
+                continue;
+            }
+
+            auto found = m_connections.find(fd);
+            if (found == m_connections.end())
+            {
+                continue;
+            }
+            Connection& connection = found->second;
+            bool closed = false;
+
+            if (events[i].events & EPOLLIN)
+            {
+                ssize_t count = 0;
+                while (!closed && (count = read(fd, read_buffer, sizeof(read_buffer))) > 0)
+                {
+                    connection.input.append(read_buffer, count);
+                    closed = !HandleInput(connection);
+                }
+                closed = closed || count == 0 || (count == -1 && errno != EAGAIN && errno != EWOULDBLOCK);
+            }
+
+            // Send as much of the pending output as the socket will take
+            while (!connection.output.empty())
+            {
+                ssize_t sent = send(fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+                if (sent <= 0)
+                {
+                    break;
+                }
+                connection.output.erase(0, sent);
+            }
+
+            if (closed || (events[i].events & (EPOLLERR | EPOLLHUP)))
+            {
+                close_connection(fd);
+                continue;
+            }
+
+            // Only wait for EPOLLOUT while there is output left to send
+            epoll_event client_event {};
+            client_event.events = EPOLLIN | EPOLLRDHUP | (connection.output.empty() ? 0u : static_cast<unsigned>(EPOLLOUT));
+            client_event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &client_event);
+        }
+
+        // Batch writes to disk: at most one save per interval
+        auto now = std::chrono::steady_clock::now();
+        if (m_dirty && now - last_save >= std::chrono::seconds(m_save_interval_seconds))
+        {
+            Save();
+            last_save = now;
+        }
+    }
+
+    while (!m_connections.empty())
+    {
+        close_connection(m_connections.begin()->first);
+    }
+    close(epoll_fd);
+    close(signal_fd);
+    close(listen_fd);
+    unlink(m_socket_path.c_str());
+
+    for (auto& dump : m_dumps)
+    {
+        dump.wait();
+    }
+    if (!Save())
+    {
+        std::cerr << "Server stopped with unsaved changes.\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Server stopped.\n";
+    return EXIT_SUCCESS;
+}
+
+int StationServer::RunClient(const string& socket_path, std::istream& commands)
+{
+    sockaddr_un address;
+    if (!MakeAddress(socket_path, address))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+    {
+        std::cerr << fmt::format("Error: unable to connect to {}: {}\n", socket_path, std::strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    string command;
+    string received;
+    char buffer[64 * 1024];
+    int exit_code = EXIT_SUCCESS;
+
+    while (std::getline(commands, command))
+    {
+        command += '\n';
+        std::size_t sent_total = 0;
+        while (sent_total < command.size())
+        {
+            ssize_t sent = send(fd, command.data() + sent_total, command.size() - sent_total, MSG_NOSIGNAL);
+            if (sent <= 0)
+            {
+                std::cerr << "Error: lost connection to server.\n";
+                close(fd);
+                return EXIT_FAILURE;
+            }
+            sent_total += sent;
+        }
+
+        // Print lines until the OK/ERR line that ends the response
+        bool done = false;
+        while (!done)
+        {
+            std::size_t newline;
+            while (!done && (newline = received.find('\n')) != string::npos)
+            {
+                string line = received.substr(0, newline);
+                received.erase(0, newline + 1);
+                if (line.compare("OK") == 0)
+                {
+                    done = true;
+                }
+                else if (line.compare(0, 4, "ERR ") == 0)
+                {
+                    std::cerr << fmt::format("Error: {}\n", line.substr(4));
+                    exit_code = EXIT_FAILURE;
+                    done = true;
+                }
+                else
+                {
+                    std::cout << line << '\n';
+                }
+            }
+            if (done)
+            {
+                break;
+            }
+
+            ssize_t count = read(fd, buffer, sizeof(buffer));
+            if (count <= 0)
+            {
+                std::cerr << "Error: lost connection to server.\n";
+                close(fd);
+                return EXIT_FAILURE;
+            }
+            received.append(buffer, count);
+        }
+    }
+
+    close(fd);
+    return exit_code;
+}
+
+#else
+
+int StationServer::Run()
+{
+    std::cerr << "Error: server mode is only supported on Linux.\n";
+    return EXIT_FAILURE;
+}
+
+int StationServer::RunClient(const string&, std::istream&)
+{
+    std::cerr << "Error: client mode is only supported on Linux.\n";
+    return EXIT_FAILURE;
+}
+
+#endif
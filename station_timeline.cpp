@@ -0,0 +1,595 @@
+#include "include/station_timeline.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fmt/format.h>
+#include <limits>
+#include <stdexcept>
+
+// A keyframe is taken once this many events have been added since the last
+// one, or 32 per station ever recorded if that's more. A keyframe copies the
+// state of every one of those stations, about 100 bytes each plus 4 per
+// kerbal aboard, while an event takes around 5 bytes in the columns, so the
+// keyframes stay smaller than the events between them. A point-in-time
+// query replays at most that many events after copying its keyframe.
+static constexpr std::size_t min_keyframe_interval = 1024;
+static constexpr std::size_t keyframe_events_per_station = 32;
+
+static constexpr char file_magic[] = {'K', 'S', 'M', 'T', 'L'};
+static constexpr std::uint8_t file_version = 1;
+
+namespace
+{
+void PutVarint(vector<std::uint8_t>& column, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        column.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    column.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t GetVarint(const vector<std::uint8_t>& column, std::size_t& offset)
+{
+    std::uint64_t value {};
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (offset >= column.size())
+        {
+            break;
+        }
+        std::uint8_t byte = column[offset++];
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("station history is truncated");
+}
+
+// Small differences either way become small numbers
+std::uint64_t ZigZag(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t UnZigZag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// Angles that change tend to keep their sign and exponent, so the bits that
+// differ are at the low end of the mantissa; reversing the bytes puts those
+// at the top and leaves the varint short.
+std::uint64_t ReverseBytes(std::uint64_t value)
+{
+    std::uint64_t reversed {};
+    for (int i = 0; i < 8; ++i)
+    {
+        reversed = (reversed << 8) | (value & 0xff);
+        value >>= 8;
+    }
+    return reversed;
+}
+
+std::int64_t ToMilliseconds(double time)
+{
+    double ms = std::round(time * 1000);
+    if (!(ms < 9.2e18))
+    {
+        return std::numeric_limits<std::int64_t>::max();
+    }
+    if (ms < -9.2e18)
+    {
+        return std::numeric_limits<std::int64_t>::min();
+    }
+    return static_cast<std::int64_t>(ms);
+}
+
+void WriteVarint(std::ostream& out, std::uint64_t value)
+{
+    vector<std::uint8_t> bytes;
+    PutVarint(bytes, value);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+std::uint64_t ReadVarint(std::istream& in)
+{
+    std::uint64_t value {};
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof())
+        {
+            break;
+        }
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("station history is truncated");
+}
+
+vector<std::uint8_t> ReadBytes(std::istream& in)
+{
+    auto size = ReadVarint(in);
+    vector<std::uint8_t> bytes;
+    // Read in pieces so a bad size fails at the end of the file rather
+    // than on allocating it
+    constexpr std::size_t piece = 1 << 16;
+    while (bytes.size() < size)
+    {
+        std::size_t offset = bytes.size();
+        std::size_t count = std::min<std::uint64_t>(piece, size - offset);
+        bytes.resize(offset + count);
+        if (!in.read(reinterpret_cast<char*>(bytes.data() + offset), static_cast<std::streamsize>(count)))
+        {
+            throw std::runtime_error("station history is truncated");
+        }
+    }
+    return bytes;
+}
+
+void WriteNames(std::ostream& out, const vector<string>& names)
+{
+    WriteVarint(out, names.size());
+    for (const auto& name : names)
+    {
+        WriteVarint(out, name.size());
+        out.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+}
+
+vector<string> ReadNames(std::istream& in)
+{
+    auto count = ReadVarint(in);
+    vector<string> names;
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        auto bytes = ReadBytes(in);
+        names.emplace_back(bytes.begin(), bytes.end());
+    }
+    return names;
+}
+} // namespace
+
+void StationTimeline::Record(double time, const vector<std::unique_ptr<SpaceStation>>& stations)
+{
+    if (!(time >= 0) || std::isinf(time))
+    {
+        throw std::invalid_argument(fmt::format("bad history time {}", time));
+    }
+    std::int64_t ms = ToMilliseconds(time);
+    if (m_end.event > 0 && ms < m_end.time)
+    {
+        throw std::invalid_argument(
+            fmt::format("history time {} is before the last change at {}", time, GetLastTime()));
+    }
+
+    vector<bool> seen(m_current.size());
+    vector<std::uint32_t> crew;
+    vector<std::uint32_t> aboard;
+    for (const auto& station : stations)
+    {
+        std::uint32_t number = StationNumber(station->GetStationID());
+        if (number >= m_current.size())
+        {
+            m_current.resize(number + 1);
+            seen.resize(number + 1);
+        }
+        if (seen[number])
+        {
+            continue; // the first station with an ID wins
+        }
+        seen[number] = true;
+
+        // Append() updates m_current, so each difference is taken just
+        // before it's recorded
+        const StationState& state = m_current[number];
+        if (!state.alive)
+        {
+            Append(ms, number, Field::ADDED, 0);
+        }
+        if (state.active != station->isActive())
+        {
+            Append(ms, number, Field::ACTIVE, station->isActive());
+        }
+        auto difference = [](std::uint64_t to, std::uint64_t from) {
+            return ZigZag(static_cast<std::int64_t>(to - from));
+        };
+        if (state.capacity != station->GetCapacity())
+        {
+            Append(ms, number, Field::CAPACITY, difference(station->GetCapacity(), state.capacity));
+        }
+        auto body = static_cast<std::uint64_t>(station->GetOrbitingBody());
+        if (state.body != body)
+        {
+            Append(ms, number, Field::BODY, body);
+        }
+        auto orbit = station->GetOrbitalDetails();
+        if (state.apoapsis != orbit.apoapsis)
+        {
+            Append(ms, number, Field::APOAPSIS, difference(orbit.apoapsis, state.apoapsis));
+        }
+        if (state.periapsis != orbit.periapsis)
+        {
+            Append(ms, number, Field::PERIAPSIS, difference(orbit.periapsis, state.periapsis));
+        }
+        const std::array<double, num_angles> angles {orbit.inclination, orbit.ascending_node,
+                                                     orbit.argument_of_periapsis, orbit.mean_anomaly};
+        for (std::size_t a = 0; a < num_angles; ++a)
+        {
+            auto bits = std::bit_cast<std::uint64_t>(angles[a]);
+            if (state.angles[a] != bits)
+            {
+                Append(ms, number, static_cast<Field>(static_cast<std::size_t>(Field::INCLINATION) + a),
+                       ReverseBytes(bits ^ state.angles[a]));
+            }
+        }
+
+        crew.clear();
+        for (const auto& kerbal : station->GetKerbals())
+        {
+            crew.push_back(KerbalNumber(kerbal));
+        }
+        vector<std::uint32_t> sorted_crew = crew;
+        std::sort(sorted_crew.begin(), sorted_crew.end());
+        aboard = state.crew;
+        for (auto kerbal : aboard)
+        {
+            if (!std::binary_search(sorted_crew.begin(), sorted_crew.end(), kerbal))
+            {
+                Append(ms, number, Field::LEFT, kerbal);
+            }
+        }
+        std::sort(aboard.begin(), aboard.end());
+        for (auto kerbal : crew)
+        {
+            auto it = std::lower_bound(aboard.begin(), aboard.end(), kerbal);
+            if (it == aboard.end() || *it != kerbal)
+            {
+                Append(ms, number, Field::BOARDED, kerbal);
+                aboard.insert(it, kerbal); // once for a kerbal listed twice
+            }
+        }
+    }
+
+    // Whatever wasn't in the list has been removed; its crew leave first so
+    // their own histories end there too
+    for (std::uint32_t number = 0; number < m_current.size(); ++number)
+    {
+        if (m_current[number].alive && !seen[number])
+        {
+            aboard = m_current[number].crew;
+            for (auto kerbal : aboard)
+            {
+                Append(ms, number, Field::LEFT, kerbal);
+            }
+            Append(ms, number, Field::REMOVED, 0);
+        }
+    }
+}
+
+vector<StationSnapshot> StationTimeline::FleetAt(double time) const
+{
+    std::int64_t ms = ToMilliseconds(time);
+    vector<StationState> stations;
+    Cursor cursor;
+
+    // The last keyframe taken at or before time
+    auto keyframe = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), ms,
+                                     [](std::int64_t t, const Keyframe& k) { return t < k.cursor.time; });
+    if (keyframe != m_keyframes.begin())
+    {
+        --keyframe;
+        stations = keyframe->stations;
+        cursor = keyframe->cursor;
+    }
+
+    Event event;
+    while (Decode(cursor, event) && event.time <= ms)
+    {
+        Apply(event, stations);
+    }
+
+    vector<StationSnapshot> fleet;
+    for (std::uint32_t number = 0; number < stations.size(); ++number)
+    {
+        if (stations[number].alive)
+        {
+            fleet.push_back(Snapshot(number, stations[number]));
+        }
+    }
+    return fleet;
+}
+
+vector<CrewRecord> StationTimeline::StationCrewHistory(const string& station_id, double from, double to) const
+{
+    auto it = m_station_numbers.find(station_id);
+    if (it == m_station_numbers.end())
+    {
+        return {};
+    }
+    return CrewHistory(m_station_crew[it->second], it->second, true, from, to);
+}
+
+vector<CrewRecord> StationTimeline::KerbalHistory(const string& kerbal, double from, double to) const
+{
+    auto it = m_kerbal_numbers.find(kerbal);
+    if (it == m_kerbal_numbers.end())
+    {
+        return {};
+    }
+    return CrewHistory(m_kerbal_crew[it->second], it->second, false, from, to);
+}
+
+bool StationTimeline::HasStation(const string& station_id) const
+{
+    return m_station_numbers.contains(station_id);
+}
+
+std::size_t StationTimeline::GetEventCount() const noexcept
+{
+    return m_end.event;
+}
+
+std::size_t StationTimeline::GetEncodedSize() const noexcept
+{
+    return m_times.size() + m_stations.size() + m_fields.size() + m_values.size();
+}
+
+double StationTimeline::GetLastTime() const noexcept
+{
+    if (m_end.event == 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return static_cast<double>(m_end.time) / 1000;
+}
+
+void StationTimeline::Write(std::ostream& out) const
+{
+    out.write(file_magic, sizeof(file_magic));
+    out.put(static_cast<char>(file_version));
+    WriteNames(out, m_station_ids);
+    WriteNames(out, m_kerbals);
+    WriteVarint(out, m_end.event);
+    for (const auto* column : {&m_times, &m_stations, &m_fields, &m_values})
+    {
+        WriteVarint(out, column->size());
+        out.write(reinterpret_cast<const char*>(column->data()), static_cast<std::streamsize>(column->size()));
+    }
+}
+
+void StationTimeline::Read(std::istream& in)
+{
+    char magic[sizeof(file_magic)] {};
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(magic), file_magic))
+    {
+        throw std::runtime_error("not a station history file");
+    }
+    if (in.get() != file_version)
+    {
+        throw std::runtime_error("unsupported station history version");
+    }
+
+    StationTimeline timeline;
+    timeline.m_station_ids = ReadNames(in);
+    timeline.m_kerbals = ReadNames(in);
+    auto event_count = ReadVarint(in);
+    timeline.m_times = ReadBytes(in);
+    timeline.m_stations = ReadBytes(in);
+    timeline.m_fields = ReadBytes(in);
+    timeline.m_values = ReadBytes(in);
+    if (timeline.m_fields.size() != event_count)
+    {
+        throw std::runtime_error("station history is corrupt");
+    }
+    for (std::uint32_t i = 0; i < timeline.m_station_ids.size(); ++i)
+    {
+        timeline.m_station_numbers.emplace(timeline.m_station_ids[i], i);
+    }
+    for (std::uint32_t i = 0; i < timeline.m_kerbals.size(); ++i)
+    {
+        timeline.m_kerbal_numbers.emplace(timeline.m_kerbals[i], i);
+    }
+    timeline.m_current.resize(timeline.m_station_ids.size());
+    timeline.m_station_crew.resize(timeline.m_station_ids.size());
+    timeline.m_kerbal_crew.resize(timeline.m_kerbals.size());
+
+    // Replay the events to rebuild the current state, keyframes and crew
+    // indexes, checking each as it goes
+    timeline.m_end.event = event_count;
+    Cursor cursor;
+    Event event;
+    std::int64_t last_time = 0;
+    while (timeline.Decode(cursor, event))
+    {
+        bool crew_event = event.field == Field::BOARDED || event.field == Field::LEFT;
+        if (event.station >= timeline.m_station_ids.size() || event.field > Field::LEFT || event.time < last_time ||
+            (crew_event && event.value >= timeline.m_kerbals.size()))
+        {
+            throw std::runtime_error("station history is corrupt");
+        }
+        last_time = event.time;
+        timeline.Index(event, cursor);
+    }
+    if (cursor.time_offset != timeline.m_times.size() || cursor.station_offset != timeline.m_stations.size() ||
+        cursor.value_offset != timeline.m_values.size())
+    {
+        throw std::runtime_error("station history is corrupt");
+    }
+    timeline.m_end = cursor;
+    *this = std::move(timeline);
+}
+
+std::uint32_t StationTimeline::StationNumber(const string& id)
+{
+    auto [it, added] = m_station_numbers.try_emplace(id, static_cast<std::uint32_t>(m_station_ids.size()));
+    if (added)
+    {
+        m_station_ids.push_back(id);
+        m_station_crew.emplace_back();
+    }
+    return it->second;
+}
+
+std::uint32_t StationTimeline::KerbalNumber(const string& name)
+{
+    auto [it, added] = m_kerbal_numbers.try_emplace(name, static_cast<std::uint32_t>(m_kerbals.size()));
+    if (added)
+    {
+        m_kerbals.push_back(name);
+        m_kerbal_crew.emplace_back();
+    }
+    return it->second;
+}
+
+void StationTimeline::Append(std::int64_t time, std::uint32_t station, Field field, std::uint64_t value)
+{
+    PutVarint(m_times, static_cast<std::uint64_t>(time - m_end.time));
+    PutVarint(m_stations, station);
+    m_fields.push_back(static_cast<std::uint8_t>(field));
+    if (field != Field::ADDED && field != Field::REMOVED)
+    {
+        PutVarint(m_values, value);
+    }
+
+    m_end.event++;
+    m_end.time = time;
+    m_end.time_offset = m_times.size();
+    m_end.station_offset = m_stations.size();
+    m_end.value_offset = m_values.size();
+    Index({time, station, field, value}, m_end);
+}
+
+void StationTimeline::Index(const Event& event, const Cursor& after)
+{
+    Apply(event, m_current);
+
+    if (event.field == Field::BOARDED || event.field == Field::LEFT)
+    {
+        auto kerbal = static_cast<std::uint32_t>(event.value);
+        bool boarded = event.field == Field::BOARDED;
+        m_station_crew[event.station].push_back({event.time, kerbal, boarded});
+        m_kerbal_crew[kerbal].push_back({event.time, event.station, boarded});
+    }
+
+    std::size_t since = after.event - (m_keyframes.empty() ? 0 : m_keyframes.back().cursor.event);
+    if (since >= std::max(min_keyframe_interval, keyframe_events_per_station * m_current.size()))
+    {
+        m_keyframes.push_back({after, m_current});
+    }
+}
+
+bool StationTimeline::Decode(Cursor& cursor, Event& event) const
+{
+    if (cursor.event >= m_end.event)
+    {
+        return false;
+    }
+    cursor.time += static_cast<std::int64_t>(GetVarint(m_times, cursor.time_offset));
+    event.time = cursor.time;
+    event.station = static_cast<std::uint32_t>(GetVarint(m_stations, cursor.station_offset));
+    event.field = static_cast<Field>(m_fields[cursor.event]);
+    event.value = event.field != Field::ADDED && event.field != Field::REMOVED
+                      ? GetVarint(m_values, cursor.value_offset)
+                      : 0;
+    cursor.event++;
+    return true;
+}
+
+void StationTimeline::Apply(const Event& event, vector<StationState>& stations)
+{
+    if (event.station >= stations.size())
+    {
+        stations.resize(event.station + 1);
+    }
+    StationState& state = stations[event.station];
+    switch (event.field)
+    {
+    case Field::ADDED:
+        state = StationState {};
+        state.alive = true;
+        break;
+    case Field::REMOVED:
+        state = StationState {};
+        break;
+    case Field::ACTIVE:
+        state.active = event.value != 0;
+        break;
+    case Field::CAPACITY:
+        state.capacity += static_cast<std::uint64_t>(UnZigZag(event.value));
+        break;
+    case Field::BODY:
+        state.body = event.value;
+        break;
+    case Field::APOAPSIS:
+        state.apoapsis += static_cast<std::uint64_t>(UnZigZag(event.value));
+        break;
+    case Field::PERIAPSIS:
+        state.periapsis += static_cast<std::uint64_t>(UnZigZag(event.value));
+        break;
+    case Field::INCLINATION:
+    case Field::ASCENDING_NODE:
+    case Field::ARG_PERIAPSIS:
+    case Field::MEAN_ANOMALY:
+        state.angles[static_cast<std::size_t>(event.field) - static_cast<std::size_t>(Field::INCLINATION)] ^=
+            ReverseBytes(event.value);
+        break;
+    case Field::BOARDED:
+        state.crew.push_back(static_cast<std::uint32_t>(event.value));
+        break;
+    case Field::LEFT:
+        if (auto it = std::find(state.crew.begin(), state.crew.end(), event.value); it != state.crew.end())
+        {
+            state.crew.erase(it);
+        }
+        break;
+    }
+}
+
+StationSnapshot StationTimeline::Snapshot(std::uint32_t station, const StationState& state) const
+{
+    StationSnapshot snapshot;
+    snapshot.id = m_station_ids[station];
+    snapshot.active = state.active;
+    snapshot.capacity = state.capacity;
+    snapshot.body = static_cast<CelestialBody>(state.body);
+    snapshot.orbit.apoapsis = state.apoapsis;
+    snapshot.orbit.periapsis = state.periapsis;
+    snapshot.orbit.inclination = std::bit_cast<double>(state.angles[0]);
+    snapshot.orbit.ascending_node = std::bit_cast<double>(state.angles[1]);
+    snapshot.orbit.argument_of_periapsis = std::bit_cast<double>(state.angles[2]);
+    snapshot.orbit.mean_anomaly = std::bit_cast<double>(state.angles[3]);
+    for (auto kerbal : state.crew)
+    {
+        snapshot.crew.push_back(m_kerbals[kerbal]);
+    }
+    return snapshot;
+}
+
+vector<CrewRecord> StationTimeline::CrewHistory(const vector<CrewPosting>& postings, std::uint32_t number,
+                                                bool by_station, double from, double to) const
+{
+    std::int64_t from_ms = ToMilliseconds(from);
+    std::int64_t to_ms = ToMilliseconds(to);
+    auto it = std::lower_bound(postings.begin(), postings.end(), from_ms,
+                               [](const CrewPosting& p, std::int64_t t) { return p.time < t; });
+
+    vector<CrewRecord> records;
+    for (; it != postings.end() && it->time <= to_ms; ++it)
+    {
+        std::uint32_t station = by_station ? number : it->other;
+        std::uint32_t kerbal = by_station ? it->other : number;
+        records.push_back({static_cast<double>(it->time) / 1000, m_station_ids[station], m_kerbals[kerbal],
+                           it->boarded});
+    }
+    return records;
+}
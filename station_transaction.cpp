@@ -0,0 +1,189 @@
+#include "include/station_transaction.hpp"
+#include "include/station_list.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/core.h>
+
+StationTransaction::StationTransaction(StationList& stations)
+    : m_stations(stations), m_base_size(stations.GetSize()),
+      m_base_modification_count(stations.GetModificationCount())
+{
+}
+
+void StationTransaction::AddStation(unique_station station)
+{
+    if (!station)
+    {
+        throw std::invalid_argument("can't add a null station");
+    }
+    m_added.push_back(std::move(station));
+}
+
+void StationTransaction::AddKerbal(std::size_t index, const string& name)
+{
+    Stage(index).station->AddKerbal(name);
+}
+
+bool StationTransaction::RemoveKerbal(std::size_t index, const string& name)
+{
+    CheckIndex(index);
+    const auto& kerbals = this->GetStation(index).GetKerbals();
+    auto found = std::find(kerbals.begin(), kerbals.end(), name);
+    if (found == kerbals.end())
+    {
+        return false;
+    }
+
+    std::size_t position = found - kerbals.begin();
+    Stage(index).station->RemoveKerbalByIndex(position);
+    return true;
+}
+
+void StationTransaction::SetCapacity(std::size_t index, std::size_t capacity)
+{
+    Stage(index).capacity = capacity;
+}
+
+void StationTransaction::DeleteStation(std::size_t index)
+{
+    CheckIndex(index);
+    m_modified.erase(index);
+    m_deleted.insert(std::upper_bound(m_deleted.begin(), m_deleted.end(), index), index);
+}
+
+void StationTransaction::ReplaceStation(std::size_t index, unique_station station)
+{
+    if (!station)
+    {
+        throw std::invalid_argument("can't replace a station with null");
+    }
+    CheckIndex(index);
+    m_modified.insert_or_assign(index, StagedStation {std::move(station), std::nullopt});
+}
+
+const StationTransaction::SpaceStation& StationTransaction::GetStation(std::size_t index) const
+{
+    CheckIndex(index);
+    auto staged = m_modified.find(index);
+    if (staged != m_modified.end())
+    {
+        return *staged->second.station;
+    }
+    return *m_stations.GetStations().at(index);
+}
+
+bool StationTransaction::IsDeleted(std::size_t index) const
+{
+    return std::binary_search(m_deleted.begin(), m_deleted.end(), index);
+}
+
+bool StationTransaction::Empty() const noexcept
+{
+    return m_modified.empty() && m_deleted.empty() && m_added.empty();
+}
+
+void StationTransaction::Commit(const string& save_filename)
+{
+    if (m_stations.GetModificationCount() != m_base_modification_count)
+    {
+        throw std::runtime_error("the station list changed while the transaction was open");
+    }
+    Validate();
+
+    vector<std::pair<std::size_t, unique_station>> modified;
+    modified.reserve(m_modified.size());
+    for (auto& [index, staged] : m_modified)
+    {
+        // Validate() has checked the capacity holds the crew
+        if (staged.capacity)
+        {
+            staged.station->ChangeCapcity(*staged.capacity);
+        }
+        modified.emplace_back(index, std::move(staged.station));
+    }
+
+    try {
+        m_stations.CommitTransaction(modified, m_deleted, m_added, save_filename);
+    }
+    catch (...)
+    {
+        // The list has put everything back; so does the transaction
+        for (auto& [index, station] : modified)
+        {
+            m_modified.at(index).station = std::move(station);
+        }
+        throw;
+    }
+
+    // The list now owns the new stations and modified holds the old ones
+    m_modified.clear();
+    m_deleted.clear();
+    m_added.clear();
+    m_base_size = m_stations.GetSize();
+    m_base_modification_count = m_stations.GetModificationCount();
+}
+
+void StationTransaction::Rollback() noexcept
+{
+    m_modified.clear();
+    m_deleted.clear();
+    m_added.clear();
+    m_base_size = m_stations.GetSize();
+    m_base_modification_count = m_stations.GetModificationCount();
+}
+
+// Returns the transaction's copy of the station at index, copying it from
+// the list the first time it is changed.
+StationTransaction::StagedStation& StationTransaction::Stage(std::size_t index)
+{
+    CheckIndex(index);
+    auto staged = m_modified.find(index);
+    if (staged == m_modified.end())
+    {
+        auto copy = std::make_unique<SpaceStation>(*m_stations.GetStations().at(index));
+        staged = m_modified.emplace(index, StagedStation {std::move(copy), std::nullopt}).first;
+    }
+    return staged->second;
+}
+
+void StationTransaction::CheckIndex(std::size_t index) const
+{
+    if (index >= m_base_size)
+    {
+        throw std::out_of_range(fmt::format("no station at index {}", index));
+    }
+    if (IsDeleted(index))
+    {
+        throw std::runtime_error(fmt::format("station at index {} is being deleted", index));
+    }
+}
+
+// Checks the capacity of every station the transaction touches, reporting
+// all of the problems at once.
+void StationTransaction::Validate() const
+{
+    string problems;
+    auto check = [&problems](const SpaceStation& station, std::size_t capacity) {
+        if (station.GetNumberKerbalsAboard() > capacity)
+        {
+            problems += fmt::format("{}station '{}' would have {} kerbals aboard but a capacity of {}",
+                                    problems.empty() ? "" : "; ", station.GetStationID(),
+                                    station.GetNumberKerbalsAboard(), capacity);
+        }
+    };
+
+    for (const auto& [index, staged] : m_modified)
+    {
+        check(*staged.station, staged.capacity.value_or(staged.station->GetCapacity()));
+    }
+    for (const auto& station : m_added)
+    {
+        check(*station, station->GetCapacity());
+    }
+
+    if (!problems.empty())
+    {
+        throw std::runtime_error(problems);
+    }
+}
@@ -0,0 +1,186 @@
+#include "include/station_validator.hpp"
+#include "include/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_set>
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+ValidationMode StationValidator::ParseMode(const string& mode)
+{
+    if (mode == "off")
+    {
+        return ValidationMode::OFF;
+    }
+    if (mode == "strict")
+    {
+        return ValidationMode::STRICT;
+    }
+    if (mode == "lenient")
+    {
+        return ValidationMode::LENIENT;
+    }
+    if (mode == "report")
+    {
+        return ValidationMode::REPORT;
+    }
+    throw std::invalid_argument(fmt::format("unknown validation mode '{}'", mode));
+}
+
+string StationValidator::CodeToString(ValidationCode code)
+{
+    return fmt::format("V{:03}", static_cast<int>(code));
+}
+
+void StationValidator::ValidateStation(const SpaceStation& station, std::size_t index, vector<ValidationIssue>& issues)
+{
+    const auto& id = station.GetStationID();
+    auto add = [&](ValidationCode code, string message) {
+        issues.push_back(ValidationIssue {index, code, id, std::move(message)});
+    };
+
+    if (id.empty())
+    {
+        add(ValidationCode::MISSING_ID, "station has no ID");
+    }
+    if (station.GetNumberKerbalsAboard() > station.GetCapacity())
+    {
+        add(ValidationCode::CAPACITY_BELOW_CREW, fmt::format("{} kerbals aboard but a capacity of {}",
+                                                             station.GetNumberKerbalsAboard(), station.GetCapacity()));
+    }
+
+    auto orbit = station.GetOrbitalDetails();
+    if (orbit.periapsis > orbit.apoapsis)
+    {
+        add(ValidationCode::PERIAPSIS_ABOVE_APOAPSIS,
+            fmt::format("periapsis {} is above apoapsis {}", orbit.periapsis, orbit.apoapsis));
+    }
+
+    auto body = static_cast<std::size_t>(station.GetOrbitingBody());
+    if (body >= NUM_CELESTIAL_BODIES)
+    {
+        add(ValidationCode::UNKNOWN_BODY, fmt::format("orbiting body {} doesn't exist", body));
+    }
+
+    if (!std::isfinite(station.GetSupplies()) || station.GetSupplies() < 0)
+    {
+        add(ValidationCode::BAD_SUPPLIES, fmt::format("supplies {} must be a number of at least 0",
+                                                      station.GetSupplies()));
+    }
+
+    for (std::size_t i = 0; i < NUM_DOCKING_PORTS; ++i)
+    {
+        auto port = static_cast<KSP_SM::DockingPort>(i);
+        auto count = station.GetDockingPortQuantities().GetCount(port);
+        if (count > max_device_count)
+        {
+            add(ValidationCode::TOO_MANY_DEVICES, fmt::format("{} count {} is over {}",
+                                                              SpaceStation::DockingPortToString(port), count, max_device_count));
+        }
+    }
+    for (std::size_t i = 0; i < NUM_COMM_DEVICES; ++i)
+    {
+        auto dev = static_cast<KSP_SM::CommunicationDevice>(i);
+        auto count = station.GetCommsDevQuantities().GetCount(dev);
+        if (count > max_device_count)
+        {
+            add(ValidationCode::TOO_MANY_DEVICES, fmt::format("{} count {} is over {}",
+                                                              SpaceStation::CommsDeviceToString(dev), count, max_device_count));
+        }
+    }
+}
+
+vector<ValidationIssue> StationValidator::Validate(const vector<std::unique_ptr<SpaceStation>>& stations,
+                                                   std::size_t threads)
+{
+    // Stations checked per task. Lists of one chunk or less are checked on
+    // this thread, since starting a pool would cost more than it saves.
+    constexpr std::size_t chunk_size = 4096;
+
+    const std::size_t chunks = (stations.size() + chunk_size - 1) / chunk_size;
+    vector<vector<ValidationIssue>> chunk_issues(chunks);
+    auto validate_chunk = [&](std::size_t begin, std::size_t end) {
+        auto& issues = chunk_issues.at(begin / chunk_size);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            ValidateStation(*stations.at(i), i, issues);
+        }
+    };
+
+    if (chunks <= 1 || threads == 1)
+    {
+        for (std::size_t begin = 0; begin < stations.size(); begin += chunk_size)
+        {
+            validate_chunk(begin, std::min(begin + chunk_size, stations.size()));
+        }
+    }
+    else
+    {
+        ThreadPool pool(std::min(threads == 0 ? ThreadPool::HardwareThreads() : threads, chunks));
+        pool.ParallelFor(stations.size(), chunk_size, validate_chunk);
+    }
+
+    vector<ValidationIssue> issues;
+    for (auto& chunk : chunk_issues)
+    {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(issues));
+    }
+
+    std::unordered_set<string> ids;
+    ids.reserve(stations.size());
+    bool duplicates = false;
+    for (std::size_t i = 0; i < stations.size(); ++i)
+    {
+        const auto& id = stations.at(i)->GetStationID();
+        if (!id.empty() && !ids.insert(id).second)
+        {
+            issues.push_back(ValidationIssue {i, ValidationCode::DUPLICATE_ID, id, "ID is already used by an earlier station"});
+            duplicates = true;
+        }
+    }
+
+    // Chunks are already in station order; only duplicates need merging in
+    if (duplicates)
+    {
+        std::stable_sort(issues.begin(), issues.end(), [](const ValidationIssue& a, const ValidationIssue& b) {
+            return a.index < b.index;
+        });
+    }
+    return issues;
+}
+
+std::size_t StationValidator::RemoveInvalid(vector<std::unique_ptr<SpaceStation>>& stations,
+                                            const vector<ValidationIssue>& issues)
+{
+    vector<bool> invalid(stations.size(), false);
+    for (const auto& issue : issues)
+    {
+        invalid.at(issue.index) = true;
+    }
+    std::size_t kept {};
+    for (std::size_t i = 0; i < stations.size(); ++i)
+    {
+        if (!invalid.at(i))
+        {
+            stations.at(kept++) = std::move(stations.at(i));
+        }
+    }
+    const std::size_t removed = stations.size() - kept;
+    stations.resize(kept);
+    return removed;
+}
+
+void StationValidator::PrintReport(std::ostream& out, const vector<ValidationIssue>& issues)
+{
+    fmt::memory_buffer buffer;
+    auto it = std::back_inserter(buffer);
+    for (const auto& issue : issues)
+    {
+        fmt::format_to(it, "{} station {} ({}): {}\n", CodeToString(issue.code), issue.index, issue.station_id,
+                       issue.message);
+    }
+    out.write(buffer.data(), buffer.size());
+}
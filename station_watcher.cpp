@@ -0,0 +1,367 @@
+#include "include/station_watcher.hpp"
+#include "include/station_io.hpp"
+#include "include/station_transaction.hpp"
+#include "include/station_hash.hpp"
+#include "include/station_validator.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+StationWatcher::StationWatcher(string filename) : m_filename(std::move(filename))
+{
+}
+
+StationWatcher::~StationWatcher()
+{
+    Stop();
+}
+
+const string& StationWatcher::GetFilename() const noexcept
+{
+    return m_filename;
+}
+
+bool StationWatcher::HasChanges() const noexcept
+{
+    return m_has_changes.load(std::memory_order_acquire);
+}
+
+void StationWatcher::Queue(FileChange change)
+{
+    // A later change to the same station replaces an earlier one that
+    // hasn't been applied yet
+    auto found = m_pending_by_id.find(change.id);
+    if (found != m_pending_by_id.end())
+    {
+        m_pending.at(found->second) = std::move(change);
+        return;
+    }
+    m_pending_by_id.emplace(change.id, m_pending.size());
+    m_pending.push_back(std::move(change));
+}
+
+// Parses the file and queues the differences from the last version.
+void StationWatcher::Reload()
+{
+    vector<unique_station> stations;
+    try {
+        std::ifstream in_file(m_filename);
+        if (!in_file)
+        {
+            throw std::runtime_error(fmt::format("{} not found", m_filename));
+        }
+
+        StationIO::ReadStations(in_file, StationIO::FormatFromFilename(m_filename),
+                                [&stations](unique_station station) { stations.push_back(std::move(station)); });
+
+        // Same rules as the list's own loads. Reloads run in the
+        // background, so problems are only reported when they stop one.
+        if (m_validation == ValidationMode::STRICT || m_validation == ValidationMode::LENIENT)
+        {
+            auto issues = StationValidator::Validate(stations, 1);
+            if (!issues.empty() && m_validation == ValidationMode::STRICT)
+            {
+                throw std::runtime_error(fmt::format("{} validation problems found, reload ignored", issues.size()));
+            }
+            StationValidator::RemoveInvalid(stations, issues);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        // Most likely caught part way through being written. The next
+        // write will trigger another reload.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = e.what();
+        m_has_changes.store(true, std::memory_order_release);
+        return;
+    }
+
+    decltype(m_baseline) baseline;
+    baseline.reserve(stations.size());
+    vector<FileChange> changes;
+    for (std::size_t i = 0; i < stations.size(); ++i)
+    {
+        auto id = stations.at(i)->GetStationID();
+        // First station wins if the file has duplicate IDs
+        if (baseline.count(id))
+        {
+            continue;
+        }
+
+        auto hash = StationHash::Hash(*stations.at(i));
+        auto previous = m_baseline.find(id);
+        if (previous == m_baseline.end() || previous->second.second != hash)
+        {
+            changes.push_back(FileChange {id, i, std::move(stations.at(i))});
+        }
+        baseline.emplace(std::move(id), std::make_pair(i, hash));
+    }
+    for (const auto& [id, previous] : m_baseline)
+    {
+        if (!baseline.count(id))
+        {
+            changes.push_back(FileChange {id, previous.first, nullptr});
+        }
+    }
+    m_baseline = std::move(baseline);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error.clear();
+    for (auto& change : changes)
+    {
+        Queue(std::move(change));
+    }
+    if (!m_pending.empty())
+    {
+        m_has_changes.store(true, std::memory_order_release);
+    }
+}
+
+std::size_t StationWatcher::ApplyChanges(StationList& stations)
+{
+    vector<FileChange> changes;
+    string error;
+    {
+        // A read error is reported once; changes queued before it stay
+        // queued for the next call
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error.empty())
+        {
+            error.swap(m_error);
+        }
+        else
+        {
+            changes.swap(m_pending);
+            m_pending_by_id.clear();
+        }
+        m_has_changes.store(!m_pending.empty(), std::memory_order_release);
+    }
+    if (!error.empty())
+    {
+        throw std::runtime_error(fmt::format("couldn't reload {}: {}", m_filename, error));
+    }
+    if (changes.empty())
+    {
+        return 0;
+    }
+
+    // Each station is usually still where it was in the file. Only if the
+    // list has been edited since does it need looking up by ID.
+    const auto& list = stations.GetStations();
+    std::unordered_map<string, std::size_t> ids;
+    auto find_station = [&](const FileChange& change, std::size_t& index) {
+        if (change.hint < list.size() && list.at(change.hint)->GetStationID() == change.id)
+        {
+            index = change.hint;
+            return true;
+        }
+        if (ids.empty())
+        {
+            ids.reserve(list.size());
+            for (std::size_t i = 0; i < list.size(); ++i)
+            {
+                ids.emplace(list.at(i)->GetStationID(), i);
+            }
+        }
+        auto found = ids.find(change.id);
+        if (found == ids.end())
+        {
+            return false;
+        }
+        index = found->second;
+        return true;
+    };
+
+    // The transaction gets copies so the changes can be queued again if
+    // the commit fails
+    StationTransaction transaction(stations);
+    std::size_t applied {};
+    for (const auto& change : changes)
+    {
+        std::size_t index;
+        bool exists = find_station(change, index);
+        if (!change.station)
+        {
+            if (exists)
+            {
+                transaction.DeleteStation(index);
+                ++applied;
+            }
+        }
+        else if (!exists)
+        {
+            transaction.AddStation(std::make_unique<SpaceStation>(*change.station));
+            ++applied;
+        }
+        // Saving the list from this program also triggers a reload; those
+        // stations are already up to date
+        else if (!(transaction.GetStation(index) == *change.station))
+        {
+            transaction.ReplaceStation(index, std::make_unique<SpaceStation>(*change.station));
+            ++applied;
+        }
+    }
+
+    try {
+        transaction.Commit();
+    }
+    catch (const std::runtime_error& e)
+    {
+        // Keep the changes for the next try, unless the file has changed
+        // the same station again since
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& change : changes)
+        {
+            if (!m_pending_by_id.count(change.id))
+            {
+                Queue(std::move(change));
+            }
+        }
+        m_has_changes.store(true, std::memory_order_release);
+        throw std::runtime_error(fmt::format("couldn't reload {}: {}", m_filename, e.what()));
+    }
+    return applied;
+}
+
+#ifdef __linux__
+
+bool StationWatcher::Start(StationList& stations)
+{
+    if (m_thread.joinable())
+    {
+        return true;
+    }
+
+    // Watch the directory rather than the file, since editors and tools
+    // often replace the file by renaming a new one over it
+    auto slash = m_filename.find_last_of('/');
+    string directory = slash == string::npos ? "." : m_filename.substr(0, slash == 0 ? 1 : slash);
+
+    m_inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    m_stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_inotify_fd < 0 || m_stop_fd < 0 ||
+        inotify_add_watch(m_inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cerr << fmt::format("Error: can't watch {}: {}\n", directory, std::strerror(errno));
+        Stop();
+        return false;
+    }
+
+    // The watch is in place before the file is read, so no change can be
+    // missed between the two
+    m_validation = stations.GetValidation();
+    stations.ReadStationsFromFile(m_filename);
+    m_baseline.clear();
+    const auto& list = stations.GetStations();
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        m_baseline.try_emplace(list.at(i)->GetStationID(), i, StationHash::Hash(*list.at(i)));
+    }
+
+    m_thread = std::thread(&StationWatcher::Run, this);
+    return true;
+}
+
+void StationWatcher::Stop()
+{
+    if (m_thread.joinable())
+    {
+        std::uint64_t one = 1;
+        if (write(m_stop_fd, &one, sizeof(one)) < 0)
+        {
+            std::cerr << fmt::format("Error stopping file watcher: {}\n", std::strerror(errno));
+        }
+        m_thread.join();
+    }
+    if (m_inotify_fd >= 0)
+    {
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+    }
+    if (m_stop_fd >= 0)
+    {
+        close(m_stop_fd);
+        m_stop_fd = -1;
+    }
+}
+
+void StationWatcher::Run()
+{
+    // A rewrite often arrives as several events; wait for them to settle
+    // before re-parsing
+    constexpr int settle_ms = 50;
+
+    auto slash = m_filename.find_last_of('/');
+    string name = slash == string::npos ? m_filename : m_filename.substr(slash + 1);
+    alignas(inotify_event) char events[sizeof(inotify_event) + NAME_MAX + 1];
+    bool changed = false;
+
+    while (true)
+    {
+        pollfd fds[2] = {{m_inotify_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}};
+        int ready = poll(fds, 2, changed ? settle_ms : -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << fmt::format("Error watching {}: {}\n", m_filename, std::strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+        if (ready == 0)
+        {
+            changed = false;
+            Reload();
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(m_inotify_fd, events, sizeof(events))) > 0)
+        {
+            for (char* next = events; next < events + length;)
+            {
+                auto* event = reinterpret_cast<inotify_event*>(next);
+                if (event->len && name == event->name)
+                {
+                    changed = true;
+                }
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+}
+
+#else
+
+bool StationWatcher::Start(StationList&)
+{
+    std::cerr << "Error: watch mode is only supported on Linux.\n";
+    return false;
+}
+
+void StationWatcher::Stop()
+{
+}
+
+void StationWatcher::Run()
+{
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "include/thread_pool.hpp"
+
+ThreadPool::ThreadPool(std::size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = HardwareThreads();
+    }
+
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+std::size_t ThreadPool::GetThreadCount() const noexcept
+{
+    return m_workers.size();
+}
+
+std::size_t ThreadPool::HardwareThreads() noexcept
+{
+    auto count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+void ThreadPool::ParallelFor(std::size_t count, std::size_t chunk_size,
+                             const std::function<void(std::size_t, std::size_t)>& task)
+{
+    if (chunk_size == 0)
+    {
+        chunk_size = 1;
+    }
+
+    std::vector<std::future<void>> pending;
+    pending.reserve(count / chunk_size + 1);
+
+    for (std::size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        std::size_t end = begin + chunk_size < count ? begin + chunk_size : count;
+        pending.push_back(Submit([&task, begin, end]() { task(begin, end); }));
+    }
+
+    // Every chunk refers to task, so wait for all of them before get()
+    // rethrows anything a chunk threw
+    for (auto& result : pending)
+    {
+        result.wait();
+    }
+    for (auto& result : pending)
+    {
+        result.get();
+    }
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
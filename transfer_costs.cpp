@@ -0,0 +1,310 @@
+#include "include/transfer_costs.hpp"
+#include "include/orbital_elements.hpp"
+#include "include/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+// Stations per side of a tile when filling a whole matrix; a 64 x 64 tile
+// of floats is 16 KB and its two radius runs stay in L1.
+static constexpr std::size_t tile_size = 64;
+
+double TransferCostEngine::HohmannDeltaV(double mu, double r1, double r2) noexcept
+{
+    double transfer_axis = 0.5 * (r1 + r2);
+    double departure = std::sqrt(mu / r1) * (std::sqrt(r2 / transfer_axis) - 1.0);
+    double arrival = std::sqrt(mu / r2) * (1.0 - std::sqrt(r1 / transfer_axis));
+    return std::abs(departure) + std::abs(arrival);
+}
+
+void TransferCostEngine::Update(const vector<std::unique_ptr<SpaceStation>>& stations, std::size_t threads)
+{
+    std::array<vector<std::size_t>, NUM_CELESTIAL_BODIES> members;
+    std::array<vector<string>, NUM_CELESTIAL_BODIES> ids;
+    std::array<vector<double>, NUM_CELESTIAL_BODIES> radius;
+
+    m_recomputed_rows = 0;
+    m_locations.assign(stations.size(), Location {NUM_CELESTIAL_BODIES, 0});
+    for (std::size_t i = 0; i < stations.size(); ++i)
+    {
+        auto body = static_cast<std::size_t>(stations[i]->GetOrbitingBody());
+        if (body >= NUM_CELESTIAL_BODIES)
+        {
+            continue;
+        }
+        m_locations[i] = Location {body, members[body].size()};
+        members[body].push_back(i);
+        ids[body].push_back(stations[i]->GetStationID());
+        radius[body].push_back(OrbitalElementsEngine::Compute(*stations[i]).semi_major_axis);
+    }
+
+    for (std::size_t body = 0; body < NUM_CELESTIAL_BODIES; ++body)
+    {
+        auto& matrix = m_bodies[body];
+        double mu = OrbitalElementsEngine::GetBodyConstants(static_cast<CelestialBody>(body)).gravitational_parameter;
+        const std::size_t size = members[body].size();
+        const std::size_t old_size = matrix.ids.size();
+        matrix.members = std::move(members[body]);
+
+        // Where each member was in the old matrix, or old_size if its row
+        // has to be worked out again
+        vector<std::size_t> old_position(size, old_size);
+        std::size_t moved {};
+        if (ids[body] == matrix.ids)
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                old_position[i] = i;
+            }
+        }
+        else
+        {
+            std::unordered_map<string, std::size_t> old_ids;
+            old_ids.reserve(old_size);
+            for (std::size_t i = 0; i < old_size; ++i)
+            {
+                old_ids.emplace(matrix.ids[i], i);
+            }
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                auto found = old_ids.find(ids[body][i]);
+                if (found != old_ids.end())
+                {
+                    old_position[i] = found->second;
+                }
+            }
+        }
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (old_position[i] < old_size && radius[body][i] != matrix.radius[old_position[i]])
+            {
+                old_position[i] = old_size;
+            }
+            moved += old_position[i] == old_size;
+        }
+
+        // Past an eighth of the rows the tiled fill is cheaper
+        if (moved * 8 > size)
+        {
+            matrix.ids = std::move(ids[body]);
+            matrix.radius = std::move(radius[body]);
+            FillMatrix(matrix, mu, threads);
+            m_recomputed_rows += size;
+            continue;
+        }
+        if (moved == 0 && size == old_size && std::is_sorted(old_position.begin(), old_position.end()))
+        {
+            continue; // nothing changed
+        }
+
+        // Copy the costs between members that kept their orbit, then fill
+        // in the rows (and columns) of the rest
+        vector<float> costs(size * size, 0.0f);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (old_position[i] == old_size)
+            {
+                continue;
+            }
+            const float* old_row = matrix.costs.data() + old_position[i] * old_size;
+            for (std::size_t j = 0; j < size; ++j)
+            {
+                if (old_position[j] != old_size)
+                {
+                    costs[i * size + j] = old_row[old_position[j]];
+                }
+            }
+        }
+        matrix.ids = std::move(ids[body]);
+        matrix.radius = std::move(radius[body]);
+        matrix.costs = std::move(costs);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (old_position[i] == old_size)
+            {
+                FillRow(matrix, mu, i);
+            }
+        }
+        m_recomputed_rows += moved;
+    }
+}
+
+void TransferCostEngine::Clear() noexcept
+{
+    for (auto& matrix : m_bodies)
+    {
+        matrix.members.clear();
+        matrix.ids.clear();
+        matrix.radius.clear();
+        matrix.costs.clear();
+    }
+    m_locations.clear();
+    m_recomputed_rows = 0;
+}
+
+std::size_t TransferCostEngine::GetRecomputedRows() const noexcept
+{
+    return m_recomputed_rows;
+}
+
+void TransferCostEngine::FillMatrix(BodyMatrix& matrix, double mu, std::size_t threads)
+{
+    const std::size_t size = matrix.members.size();
+    matrix.costs.assign(size * size, 0.0f);
+    const std::size_t tiles = (size + tile_size - 1) / tile_size;
+
+    // Each task fills the tiles on and right of the diagonal in its tile
+    // rows and mirrors them, so every cell is written by exactly one task
+    auto fill_tile_rows = [&matrix, mu, size, tiles](std::size_t begin, std::size_t end) {
+        const double* radius = matrix.radius.data();
+        float* costs = matrix.costs.data();
+        for (std::size_t tile_row = begin; tile_row < end; ++tile_row)
+        {
+            std::size_t row_end = std::min(size, (tile_row + 1) * tile_size);
+            for (std::size_t tile_column = tile_row; tile_column < tiles; ++tile_column)
+            {
+                std::size_t column_end = std::min(size, (tile_column + 1) * tile_size);
+                for (std::size_t i = tile_row * tile_size; i < row_end; ++i)
+                {
+                    std::size_t j = tile_column == tile_row ? i + 1 : tile_column * tile_size;
+                    for (; j < column_end; ++j)
+                    {
+                        auto cost = static_cast<float>(HohmannDeltaV(mu, radius[i], radius[j]));
+                        costs[i * size + j] = cost;
+                        costs[j * size + i] = cost;
+                    }
+                }
+            }
+        }
+    };
+
+    if (tiles <= 1 || threads == 1)
+    {
+        fill_tile_rows(0, tiles);
+        return;
+    }
+
+    ThreadPool pool(std::min(threads == 0 ? ThreadPool::HardwareThreads() : threads, tiles));
+    pool.ParallelFor(tiles, 1, fill_tile_rows);
+}
+
+void TransferCostEngine::FillRow(BodyMatrix& matrix, double mu, std::size_t row)
+{
+    const std::size_t size = matrix.members.size();
+    for (std::size_t j = 0; j < size; ++j)
+    {
+        float cost = j == row ? 0.0f : static_cast<float>(HohmannDeltaV(mu, matrix.radius[row], matrix.radius[j]));
+        matrix.costs[row * size + j] = cost;
+        matrix.costs[j * size + row] = cost;
+    }
+}
+
+double TransferCostEngine::Cost(std::size_t from, std::size_t to) const
+{
+    const auto& a = m_locations.at(from);
+    const auto& b = m_locations.at(to);
+    if (a.body != b.body || a.body >= NUM_CELESTIAL_BODIES)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const auto& matrix = m_bodies[a.body];
+    return matrix.costs[a.position * matrix.members.size() + b.position];
+}
+
+vector<TransferCostEngine::Transfer> TransferCostEngine::Nearest(std::size_t from, std::size_t count,
+                                                                  const StationBitmap* filter) const
+{
+    vector<Transfer> transfers;
+    const auto& location = m_locations.at(from);
+    if (location.body >= NUM_CELESTIAL_BODIES)
+    {
+        return transfers;
+    }
+
+    const auto& matrix = m_bodies[location.body];
+    const float* row = matrix.costs.data() + location.position * matrix.members.size();
+    for (std::size_t j = 0; j < matrix.members.size(); ++j)
+    {
+        std::size_t index = matrix.members[j];
+        if (j != location.position && (filter == nullptr || filter->Test(index)))
+        {
+            transfers.push_back(Transfer {index, row[j]});
+        }
+    }
+
+    count = std::min(count, transfers.size());
+    std::partial_sort(transfers.begin(), transfers.begin() + count, transfers.end(),
+                      [](const Transfer& a, const Transfer& b) {
+                          return a.delta_v < b.delta_v || (a.delta_v == b.delta_v && a.index < b.index);
+                      });
+    transfers.resize(count);
+    return transfers;
+}
+
+vector<TransferCostEngine::Transfer> TransferCostEngine::CheapestRoute(std::size_t from, std::size_t to,
+                                                                        double max_leg,
+                                                                        const StationBitmap* filter) const
+{
+    vector<Transfer> route;
+    const auto& start = m_locations.at(from);
+    const auto& goal = m_locations.at(to);
+    if (start.body != goal.body || start.body >= NUM_CELESTIAL_BODIES || from == to)
+    {
+        return route;
+    }
+
+    // Dijkstra without a heap: the graph is complete, so scanning for the
+    // closest unvisited station each round is as fast as any queue
+    const auto& matrix = m_bodies[start.body];
+    const std::size_t size = matrix.members.size();
+    const double infinity = std::numeric_limits<double>::infinity();
+    vector<double> distance(size, infinity);
+    vector<std::size_t> previous(size, size);
+    vector<bool> done(size, false);
+    distance[start.position] = 0.0;
+
+    while (true)
+    {
+        std::size_t current = size;
+        for (std::size_t j = 0; j < size; ++j)
+        {
+            if (!done[j] && distance[j] < infinity && (current == size || distance[j] < distance[current]))
+            {
+                current = j;
+            }
+        }
+        if (current == size || current == goal.position)
+        {
+            break;
+        }
+        done[current] = true;
+
+        const float* row = matrix.costs.data() + current * size;
+        for (std::size_t j = 0; j < size; ++j)
+        {
+            bool allowed = j == goal.position || filter == nullptr || filter->Test(matrix.members[j]);
+            if (done[j] || !allowed || (max_leg > 0 && row[j] > max_leg))
+            {
+                continue;
+            }
+            if (distance[current] + row[j] < distance[j])
+            {
+                distance[j] = distance[current] + row[j];
+                previous[j] = current;
+            }
+        }
+    }
+
+    if (distance[goal.position] == infinity)
+    {
+        return route;
+    }
+    for (std::size_t j = goal.position; j != start.position; j = previous[j])
+    {
+        route.push_back(Transfer {matrix.members[j], matrix.costs[previous[j] * size + j]});
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+}
@@ -1,6 +1,9 @@
 #include "include/utils.hpp"
 #include <sstream>
 #include <iostream>
+#include <cctype>
+#include <limits>
+#include <charconv>
 
 using namespace KSP_SM;
 
@@ -11,15 +14,26 @@ string Utility::BoolToYesNo(bool input)
 
 string Utility::numberWithCommas(size_t input)
 {
-    string result = std::to_string(input);
-    if (result.size() < 3)
-        return result;
-    for (auto i = result.size() - 3; i > 0; i -=3)
+    fmt::memory_buffer buffer;
+    FormatWithCommas(buffer, input);
+    return fmt::to_string(buffer);
+}
+
+// Appends input to out with a comma between each group of three digits.
+void Utility::FormatWithCommas(fmt::memory_buffer& out, size_t input)
+{
+    char digits[24];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), input);
+    size_t length = end - digits;
+
+    for (size_t i = 0; i < length; ++i)
     {
-        result.insert(i, ",");
+        if (i > 0 && (length - i) % 3 == 0)
+        {
+            out.push_back(',');
+        }
+        out.push_back(digits[i]);
     }
-
-    return result;
 }
 
 string Utility::PlanetToString(CelestialBody planet)
@@ -70,6 +84,33 @@ string Utility::PlanetToString(CelestialBody planet)
     }
 }
 
+// Case insensitive lookup of a planet or moon by name. Returns false if the
+// name doesn't match any celestial body.
+bool Utility::StringToPlanet(const string& name, CelestialBody& planet)
+{
+    static const char* names[NUM_CELESTIAL_BODIES] = {
+        "kerbol", "moho", "eve", "gilly", "kerbin", "mun", "minmus", "duna", "ike",
+        "dres", "jool", "laythe", "vall", "tylo", "bop", "pol", "eloo"
+    };
+
+    string lowered = name;
+    for (auto& c : lowered)
+    {
+        c = std::tolower(c);
+    }
+
+    for (std::size_t i = 0; i < NUM_CELESTIAL_BODIES; ++i)
+    {
+        if (lowered.compare(names[i]) == 0)
+        {
+            planet = static_cast<CelestialBody>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 string Utility::PrettyFormatList(const vector<KSP_SM::CommunicationDevice>& list)
 {
     size_t i = 0;